@@ -0,0 +1,27 @@
+; Echo Program
+; Copies console input to console output until the input ends
+; Demonstrates polling the CONSOLE_STATUS register (0xFF04)
+
+start:
+poll:
+    ; Read the console status
+    ; Bit 0 = input byte ready, bit 1 = end of input
+    LOAD R0, [0xFF04]
+
+    ; Is a byte ready?
+    LOADI R1, 1
+    AND R2, R0, R1
+    CMPI R2, 0
+    JNZ echo
+
+    ; No byte yet - has the input ended?
+    LOADI R1, 2
+    AND R2, R0, R1
+    CMPI R2, 0
+    JZ poll
+    HALT
+
+echo:
+    LOAD R0, [0xFF02]       ; Take the next input byte
+    STORE R0, [0xFF01]      ; and print it
+    JMP poll
@@ -1,6 +1,6 @@
 ; Fibonacci Sequence Program
 ; Calculates and displays the first 10 Fibonacci numbers
-; Due to 8-bit limitations, we output a marker for numbers >= 10
+; Two-digit numbers are split into digits with DIV and MOD
 
 start:
     ; Initialize Fibonacci sequence
@@ -40,10 +40,13 @@ fib_loop:
     CMPI R1, 10
     JC single_digit     ; If R1 < 10, output single digit
     
-    ; For numbers >= 10, output "##"
-    LOADI R5, 35        ; '#'
+    ; For numbers >= 10, output the tens digit, then the ones digit
+    LOADI R6, 10
+    DIV R5, R1, R6      ; R5 = R1 / 10
+    ADDI R5, 48         ; ASCII tens digit
     STORE R5, [0xFF01]
-    LOADI R5, 35        ; '#'
+    MOD R5, R1, R6      ; R5 = R1 % 10
+    ADDI R5, 48         ; ASCII ones digit
     STORE R5, [0xFF01]
     JMP output_done
 
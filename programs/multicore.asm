@@ -0,0 +1,78 @@
+; Multicore Counter Program
+; Every core adds 60 to a shared counter one CAS at a time, then checks
+; in. Core 0 waits for all cores and prints OK if no increment was lost.
+; Run with: ./bin/emulator --cores 4 programs/multicore.bin
+
+; Shared data
+;   0x1000  counter
+;   0x1001  cores finished
+
+start:
+    LOADI R3, 1         ; R3 = 1 (increment)
+    LOADI R4, 60        ; R4 = increments left
+
+    ; Atomic increment: CAS R2, [addr] stores R2 only if the byte still
+    ; holds R0; otherwise it loads the current value into R0
+add_loop:
+    LOAD R0, [0x1000]   ; R0 = counter as last seen
+retry:
+    ADD R2, R0, R3      ; R2 = counter + 1
+    CAS R2, [0x1000]    ; Swap it in if nobody got there first
+    JNZ retry           ; Lost the race: R0 holds the new counter
+    DEC R4
+    JNZ add_loop
+
+    ; Print this core's number, then check in
+    LOAD R1, [0xFF08]   ; R1 = CORE_ID
+    LOADI R2, 48
+    ADD R2, R2, R1
+    STORE R2, [0xFF01]  ; Output '0' + CORE_ID
+
+    LOAD R0, [0x1001]
+done_retry:
+    ADD R2, R0, R3
+    CAS R2, [0x1001]
+    JNZ done_retry
+
+    ; Only core 0 goes on
+    CMPI R1, 0
+    JNZ finish
+
+    ; Wait until every core has checked in
+    LOAD R5, [0xFF09]   ; R5 = CORE_COUNT
+wait:
+    LOAD R0, [0x1001]
+    CMP R0, R5
+    JNZ wait
+
+    ; Expect 60 * CORE_COUNT (modulo 256)
+    LOADI R6, 60
+    MUL R6, R6, R5
+    LOAD R0, [0x1000]
+    CMP R0, R6
+    JNZ bad
+
+    LOADI R2, 10
+    STORE R2, [0xFF01]  ; Newline
+    LOADI R2, 79
+    STORE R2, [0xFF01]  ; 'O'
+    LOADI R2, 75
+    STORE R2, [0xFF01]  ; 'K'
+    LOADI R2, 10
+    STORE R2, [0xFF01]
+    JMP finish
+
+bad:
+    LOADI R2, 10
+    STORE R2, [0xFF01]
+    LOADI R2, 66
+    STORE R2, [0xFF01]  ; 'B'
+    LOADI R2, 65
+    STORE R2, [0xFF01]  ; 'A'
+    LOADI R2, 68
+    STORE R2, [0xFF01]  ; 'D'
+    LOADI R2, 10
+    STORE R2, [0xFF01]
+
+finish:
+    HALT
@@ -1,13 +1,51 @@
 ; Timer Example Program
-; Demonstrates memory-mapped I/O timer and Fetch/Compute/Store cycles
+; Demonstrates memory-mapped I/O timer, interrupts and Fetch/Compute/Store cycles
 ; This program counts from 1 to 5 with delays between each count
 
+; Skip over the interrupt handler
+; FETCH: Read JMP instruction from memory at PC (0x0100)
+; DECODE: Opcode=JMP, Address=main
+; COMPUTE: No computation needed
+; STORE: Update PC to 'main'
+start:
+    JMP main            ; 3 bytes, so the handler starts at 0x0103
+
+; Timer interrupt handler (0x0103)
+; The CPU pushed PC and the flags before jumping here; acknowledging
+; the interrupt already cleared the timer's pending bit
+; FETCH: Read RETI instruction
+; DECODE: Opcode=0x1F, low bits=1 (RETI)
+; COMPUTE: No computation needed
+; STORE: Pop flags and PC, end the interrupt
+timer_isr:
+    RETI                ; Back to the instruction after WAIT
+
+main:
+; Install the handler in timer vector 0 (little-endian word at 0x0000)
+; FETCH: Read LOADI / STORE instructions
+; DECODE: Opcode=LOADI, Rd=R2 / Opcode=STORE, Address=0x0000-0x0001
+; COMPUTE: No computation needed
+; STORE: Write the handler address 0x0103 to the vector table
+    LOADI R2, 0x03
+    STORE R2, [0x0000]  ; Vector 0, low byte
+    LOADI R2, 0x01
+    STORE R2, [0x0001]  ; Vector 0, high byte
+
+; Unmask the timer source and enable interrupts
+; FETCH: Read LOADI / STORE instructions
+; DECODE: Opcode=STORE, Address=0xFF21 (INT_MASK) / 0xFF20 (INT_ENABLE)
+; COMPUTE: No computation needed
+; STORE: Write the interrupt controller registers
+    LOADI R2, 0xFE      ; Mask every source but the timer (bit 0)
+    STORE R2, [0xFF21]
+    LOADI R2, 1
+    STORE R2, [0xFF20]  ; Interrupts on
+
 ; Initialize counter
 ; FETCH: Read instruction from memory at PC (0x0100)
 ; DECODE: Opcode=LOADI, Rd=R0, Immediate=0
 ; COMPUTE: No computation needed
 ; STORE: Write 0 to R0
-start:
     LOADI R0, 0         ; R0 = 0 (counter)
 
 ; Initialize limit
@@ -73,23 +111,12 @@ loop:
 
 ; Wait for timer to expire
 wait:
-    ; FETCH: Read LOAD instruction from timer value register
-    ; DECODE: Opcode=LOAD, Rd=R5, Address=0xFF03
-    ; COMPUTE: Calculate address
-    ; STORE: Read timer value from 0xFF03, write to R5
-    LOAD R5, [0xFF03]   ; R5 = current timer value
-    
-    ; FETCH: Read CMPI instruction
-    ; DECODE: Opcode=CMPI, Rs=R5, Immediate=0
-    ; COMPUTE: ALU performs R5 - 0, updates flags (Z flag if zero)
-    ; STORE: Update FLAGS register only
-    CMPI R5, 0          ; Compare R5 with 0
-    
-    ; FETCH: Read JNZ instruction
-    ; DECODE: Opcode=JNZ, Address=wait
-    ; COMPUTE: Check Z flag, calculate target address if not zero
-    ; STORE: Update PC to 'wait' if Z flag is clear, else continue
-    JNZ wait            ; Loop while timer > 0
+    ; FETCH: Read WAIT instruction
+    ; DECODE: Opcode=0x1F, low bits=2 (WAIT)
+    ; COMPUTE: The emulator skips ahead to the timer's expiry instead of
+    ;          executing a polling loop; the interrupt runs timer_isr
+    ; STORE: Nothing (PC continues after WAIT once the handler returns)
+    WAIT                ; Sleep until the timer interrupt
 
     ; Check if counter reached limit
     ; FETCH: Read CMP instruction
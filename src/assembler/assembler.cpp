@@ -54,8 +54,21 @@ bool Assembler::assemble(const std::string& source_file, const std::string& outp
     output.write(reinterpret_cast<const char*>(machine_code.data()), machine_code.size());
     output.close();
     
+    // Symbol map next to the binary, for the emulator's profiler
+    std::string map_file = output_file;
+    size_t dot = map_file.find_last_of('.');
+    size_t slash = map_file.find_last_of('/');
+    if (dot != std::string::npos && (slash == std::string::npos || dot > slash)) {
+        map_file.erase(dot);
+    }
+    map_file += ".sym";
+    if (!symbols.writeMap(map_file)) {
+        return false;
+    }
+    
     std::cout << "\n[4] Assembly Complete!" << std::endl;
     std::cout << "Output: " << output_file << " (" << machine_code.size() << " bytes)" << std::endl;
+    std::cout << "Symbols: " << map_file << std::endl;
     
     return true;
 }
@@ -96,6 +109,12 @@ void Assembler::encodeInstruction(const Instruction& instr) {
     else if (instr.mnemonic == "RET") {
         machine_code.push_back((0x1E << 3) | 0);
     }
+    else if (instr.mnemonic == "RETI") {
+        machine_code.push_back((0x1F << 3) | 1);
+    }
+    else if (instr.mnemonic == "WAIT") {
+        machine_code.push_back((0x1F << 3) | 2);
+    }
     else if (instr.mnemonic == "INC" || instr.mnemonic == "DEC") {
         uint8_t rd = parseRegister(instr.operands[0]);
         machine_code.push_back((opcode << 3) | rd);
@@ -110,7 +129,11 @@ void Assembler::encodeInstruction(const Instruction& instr) {
         machine_code.push_back((opcode << 3) | rd);
         machine_code.push_back(imm);
     }
-    else if (instr.mnemonic == "LOAD" || instr.mnemonic == "STORE") {
+    else if ((instr.mnemonic == "LOAD" || instr.mnemonic == "STORE") &&
+             instr.operands.size() > 1 && isIndirect(instr.operands[1])) {
+        encodeIndirect(instr);
+    }
+    else if (instr.mnemonic == "LOAD" || instr.mnemonic == "STORE" || instr.mnemonic == "CAS") {
         uint8_t rd = parseRegister(instr.operands[0]);
         uint16_t addr = parseAddress(instr.operands[1]);
         machine_code.push_back((opcode << 3) | rd);
@@ -138,6 +161,16 @@ void Assembler::encodeInstruction(const Instruction& instr) {
         machine_code.push_back((opcode << 3) | rd);
         machine_code.push_back(imm);
     }
+    else if (instr.mnemonic == "MULH" || instr.mnemonic == "DIV" || instr.mnemonic == "MOD") {
+        // MUL's encoding with byte 1 bits 1-0 selecting the operation
+        uint8_t variant = instr.mnemonic == "MULH" ? 1 : instr.mnemonic == "DIV" ? 2 : 3;
+        uint8_t rd = parseRegister(instr.operands[0]);
+        uint8_t rs1 = parseRegister(instr.operands[1]);
+        uint8_t rs2 = (instr.operands.size() > 2) ? parseRegister(instr.operands[2]) : 0;
+        
+        machine_code.push_back((opcode << 3) | rd);
+        machine_code.push_back((rs1 << 5) | (rs2 << 2) | variant);
+    }
     else if (instr.mnemonic == "ADD" || instr.mnemonic == "SUB" || instr.mnemonic == "MUL" ||
              instr.mnemonic == "AND" || instr.mnemonic == "OR" || instr.mnemonic == "XOR" ||
              instr.mnemonic == "SHL" || instr.mnemonic == "SHR" || instr.mnemonic == "CMP") {
@@ -199,6 +232,54 @@ uint16_t Assembler::parseAddress(const std::string& addr) {
     return parseImmediate(cleaned);
 }
 
+bool Assembler::isIndirect(const std::string& operand) const {
+    // [Rn...] names a register pair; [0x1000] is an absolute address
+    size_t start = operand.find_first_not_of("[ \t");
+    return !operand.empty() && operand.front() == '[' && start != std::string::npos &&
+           operand[start] == 'R' && start + 1 < operand.length() &&
+           operand[start + 1] >= '0' && operand[start + 1] <= '7';
+}
+
+void Assembler::encodeIndirect(const Instruction& instr) {
+    // [Rp], [Rp+N], [Rp-N] or [Rp+], whitespace allowed anywhere inside
+    std::string inner;
+    for (size_t i = 1; i + 1 < instr.operands[1].length(); i++) {
+        char c = instr.operands[1][i];
+        if (c != ' ' && c != '\t') {
+            inner += c;
+        }
+    }
+
+    uint8_t rd = parseRegister(instr.operands[0]);
+    uint8_t pair = inner[1] - '0';
+    std::string rest = inner.substr(2);
+    bool post_increment = rest == "+";
+    int offset = 0;
+    if (!rest.empty() && !post_increment) {
+        if (rest[0] != '+' && rest[0] != '-') {
+            error("Invalid register operand: " + instr.operands[1], instr.line);
+            return;
+        }
+        offset = parseImmediate(rest.substr(1));
+        if (rest[0] == '-') {
+            offset = -offset;
+        }
+    }
+    if (pair & 1) {
+        error("Register pair base must be R0, R2, R4 or R6: " + instr.operands[1], instr.line);
+        return;
+    }
+    if (offset < -128 || offset > 127) {
+        error("Offset out of range (-128 to 127): " + instr.operands[1], instr.line);
+        return;
+    }
+
+    bool store = instr.mnemonic == "STORE";
+    machine_code.push_back((0x0F << 3) | rd);
+    machine_code.push_back((pair << 5) | (store ? 0x10 : 0) | (post_increment ? 0x08 : 0));
+    machine_code.push_back(static_cast<uint8_t>(offset));
+}
+
 uint8_t Assembler::getOpcode(const std::string& mnemonic) {
     if (mnemonic == "NOP") return 0x00;
     if (mnemonic == "ADD") return 0x00;
@@ -206,6 +287,9 @@ uint8_t Assembler::getOpcode(const std::string& mnemonic) {
     if (mnemonic == "SUB") return 0x02;
     if (mnemonic == "SUBI") return 0x03;
     if (mnemonic == "MUL") return 0x04;
+    if (mnemonic == "MULH") return 0x04;
+    if (mnemonic == "DIV") return 0x04;
+    if (mnemonic == "MOD") return 0x04;
     if (mnemonic == "INC") return 0x05;
     if (mnemonic == "DEC") return 0x06;
     if (mnemonic == "AND") return 0x07;
@@ -223,6 +307,7 @@ uint8_t Assembler::getOpcode(const std::string& mnemonic) {
     if (mnemonic == "CMPI") return 0x14;
     if (mnemonic == "PUSH") return 0x15;
     if (mnemonic == "POP") return 0x16;
+    if (mnemonic == "CAS") return 0x17;
     if (mnemonic == "JMP") return 0x18;
     if (mnemonic == "JZ") return 0x19;
     if (mnemonic == "JNZ") return 0x1A;
@@ -231,6 +316,8 @@ uint8_t Assembler::getOpcode(const std::string& mnemonic) {
     if (mnemonic == "CALL") return 0x1D;
     if (mnemonic == "RET") return 0x1E;
     if (mnemonic == "HALT") return 0x1F;
+    if (mnemonic == "RETI") return 0x1F;
+    if (mnemonic == "WAIT") return 0x1F;
     
     return 0xFF; // Unknown
 }
@@ -33,6 +33,8 @@ private:
     uint8_t parseRegister(const std::string& reg);
     uint16_t parseImmediate(const std::string& imm);
     uint16_t parseAddress(const std::string& addr);
+    bool isIndirect(const std::string& operand) const;
+    void encodeIndirect(const Instruction& instr);
     
     // Opcode mapping
     uint8_t getOpcode(const std::string& mnemonic);
@@ -147,13 +147,13 @@ Token Lexer::readIdentifier() {
     
     // List of known instructions
     const char* instructions[] = {
-        "ADD", "ADDI", "SUB", "SUBI", "MUL", "INC", "DEC",
+        "ADD", "ADDI", "SUB", "SUBI", "MUL", "MULH", "DIV", "MOD", "INC", "DEC",
         "AND", "ANDI", "OR", "ORI", "XOR", "NOT", "SHL", "SHR",
-        "LOAD", "STORE", "LOADI",
+        "LOAD", "STORE", "LOADI", "CAS",
         "CMP", "CMPI",
         "PUSH", "POP",
-        "JMP", "JZ", "JNZ", "JC", "JNC", "CALL", "RET",
-        "NOP", "HALT"
+        "JMP", "JZ", "JNZ", "JC", "JNC", "CALL", "RET", "RETI",
+        "NOP", "HALT", "WAIT"
     };
     
     // Check if it's an instruction
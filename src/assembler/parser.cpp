@@ -79,11 +79,12 @@ Instruction Parser::parseInstruction(uint16_t& address) {
     // Calculate instruction size and update address
     if (mnemonic == "NOP") {
         address += 1;
-    } else if (mnemonic == "HALT" || mnemonic == "RET" || 
+    } else if (mnemonic == "HALT" || mnemonic == "RET" || mnemonic == "RETI" ||
+               mnemonic == "WAIT" ||
                mnemonic == "INC" || mnemonic == "DEC" ||
                mnemonic == "PUSH" || mnemonic == "POP") {
         address += 1;
-    } else if (mnemonic == "LOAD" || mnemonic == "STORE" ||
+    } else if (mnemonic == "LOAD" || mnemonic == "STORE" || mnemonic == "CAS" ||
                mnemonic == "JMP" || mnemonic == "JZ" || mnemonic == "JNZ" ||
                mnemonic == "JC" || mnemonic == "JNC" || mnemonic == "CALL") {
         address += 3;
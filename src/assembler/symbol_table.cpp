@@ -1,6 +1,10 @@
 #include "symbol_table.h"
+#include <algorithm>
+#include <fstream>
 #include <iostream>
 #include <iomanip>
+#include <utility>
+#include <vector>
 
 SymbolTable::SymbolTable() {
 }
@@ -39,3 +43,21 @@ void SymbolTable::print() const {
     std::cout << std::endl;
 }
 
+bool SymbolTable::writeMap(const std::string& path) const {
+    std::vector<std::pair<uint16_t, std::string>> by_address;
+    for (const auto& pair : symbols) {
+        by_address.push_back(std::make_pair(pair.second, pair.first));
+    }
+    std::sort(by_address.begin(), by_address.end());
+    
+    std::ofstream out(path);
+    if (!out) {
+        std::cerr << "Error: Cannot create symbol map '" << path << "'" << std::endl;
+        return false;
+    }
+    for (const auto& entry : by_address) {
+        out << std::hex << std::setw(4) << std::setfill('0') << entry.first
+            << " " << entry.second << "\n";
+    }
+    return static_cast<bool>(out);
+}
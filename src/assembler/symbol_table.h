@@ -29,6 +29,10 @@ public:
     
     // Print all symbols (for debugging)
     void print() const;
+    
+    // Write a symbol map for the emulator's profiler: one
+    // "<hex address> <name>" line per label, in address order
+    bool writeMap(const std::string& path) const;
 };
 
 #endif // SYMBOL_TABLE_H
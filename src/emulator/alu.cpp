@@ -37,6 +37,41 @@ uint8_t ALU::multiply(uint8_t a, uint8_t b, uint8_t& flags) {
     return result8;
 }
 
+uint8_t ALU::multiplyHigh(uint8_t a, uint8_t b, uint8_t& flags) {
+    uint16_t result = static_cast<uint16_t>(a) * static_cast<uint16_t>(b);
+    uint8_t result8 = static_cast<uint8_t>(result >> 8);  // Upper 8 bits
+    
+    updateZeroFlag(result8, flags);
+    updateNegativeFlag(result8, flags);
+    clearFlags(flags, FLAG_C | FLAG_V);
+    
+    return result8;
+}
+
+uint8_t ALU::divide(uint8_t a, uint8_t b, uint8_t& flags) {
+    // Unsigned; dividing by zero gives 0xFF and sets carry
+    uint8_t result = (b != 0) ? a / b : 0xFF;
+    
+    updateZeroFlag(result, flags);
+    updateNegativeFlag(result, flags);
+    updateCarryFlag(b == 0, flags);
+    clearFlags(flags, FLAG_V);
+    
+    return result;
+}
+
+uint8_t ALU::modulo(uint8_t a, uint8_t b, uint8_t& flags) {
+    // Unsigned; dividing by zero leaves the dividend and sets carry
+    uint8_t result = (b != 0) ? a % b : a;
+    
+    updateZeroFlag(result, flags);
+    updateNegativeFlag(result, flags);
+    updateCarryFlag(b == 0, flags);
+    clearFlags(flags, FLAG_V);
+    
+    return result;
+}
+
 uint8_t ALU::increment(uint8_t a, uint8_t& flags) {
     return add(a, 1, flags);
 }
@@ -124,6 +159,35 @@ void ALU::compare(uint8_t a, uint8_t b, uint8_t& flags) {
     subtract(a, b, flags);
 }
 
+uint8_t ALU::resolveFlags(const PendingFlags& pending, uint8_t flags) {
+    if (pending.op == FLAGOP_NONE) {
+        return flags;
+    }
+    
+    uint8_t a = pending.a;
+    uint8_t b = pending.b;
+    uint8_t result = pending.result;
+    
+    uint8_t resolved = flags & ~(FLAG_N | FLAG_Z | FLAG_C | FLAG_V);
+    if (result & 0x80) resolved |= FLAG_N;
+    if (result == 0) resolved |= FLAG_Z;
+    
+    switch (pending.op) {
+        case FLAGOP_ADD:
+            if (a + b > 0xFF) resolved |= FLAG_C;
+            if ((a ^ result) & (b ^ result) & 0x80) resolved |= FLAG_V;
+            break;
+        case FLAGOP_SUB:
+            if (a < b) resolved |= FLAG_C;
+            if ((a ^ b) & (a ^ result) & 0x80) resolved |= FLAG_V;
+            break;
+        default:
+            break;
+    }
+    
+    return resolved;
+}
+
 // Helper functions
 
 void ALU::updateZeroFlag(uint8_t result, uint8_t& flags) {
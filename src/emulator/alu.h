@@ -3,6 +3,29 @@
 
 #include <cstdint>
 
+/**
+ * Kinds of flag-producing operations recorded for lazy evaluation
+ */
+enum FlagOp : uint8_t {
+    FLAGOP_NONE,    // Flags register is current
+    FLAGOP_ADD,     // N,Z,C,V from a + b
+    FLAGOP_SUB,     // N,Z,C,V from a - b (C = borrow)
+    FLAGOP_LOGIC    // N,Z from result; C,V cleared
+};
+
+/**
+ * PendingFlags - The last flag-producing operation and its operands
+ * 
+ * In lazy-flags mode the CPU records this instead of updating the
+ * flags register, and only computes N/Z/C/V when something reads them.
+ */
+struct PendingFlags {
+    uint8_t op;
+    uint8_t a;
+    uint8_t b;
+    uint8_t result;
+};
+
 /**
  * ALU class - Arithmetic Logic Unit
  * Performs arithmetic and logical operations
@@ -22,6 +45,9 @@ public:
     uint8_t add(uint8_t a, uint8_t b, uint8_t& flags);
     uint8_t subtract(uint8_t a, uint8_t b, uint8_t& flags);
     uint8_t multiply(uint8_t a, uint8_t b, uint8_t& flags);
+    uint8_t multiplyHigh(uint8_t a, uint8_t b, uint8_t& flags);
+    uint8_t divide(uint8_t a, uint8_t b, uint8_t& flags);
+    uint8_t modulo(uint8_t a, uint8_t b, uint8_t& flags);
     uint8_t increment(uint8_t a, uint8_t& flags);
     uint8_t decrement(uint8_t a, uint8_t& flags);
     
@@ -38,6 +64,32 @@ public:
     // Comparison (updates flags only, returns 0)
     void compare(uint8_t a, uint8_t b, uint8_t& flags);
     
+    // Lazy flag operations: compute the result and record the operation
+    static uint8_t addLazy(uint8_t a, uint8_t b, PendingFlags& pending) {
+        return record(FLAGOP_ADD, a, b, static_cast<uint8_t>(a + b), pending);
+    }
+    static uint8_t subtractLazy(uint8_t a, uint8_t b, PendingFlags& pending) {
+        return record(FLAGOP_SUB, a, b, static_cast<uint8_t>(a - b), pending);
+    }
+    static uint8_t logicLazy(uint8_t result, PendingFlags& pending) {
+        return record(FLAGOP_LOGIC, 0, 0, result, pending);
+    }
+    
+    // Lazy flag evaluation
+    static uint8_t resolveFlags(const PendingFlags& pending, uint8_t flags);
+    static bool pendingZero(const PendingFlags& pending, uint8_t flags) {
+        if (pending.op == FLAGOP_NONE) return (flags & FLAG_Z) != 0;
+        return pending.result == 0;
+    }
+    static bool pendingCarry(const PendingFlags& pending, uint8_t flags) {
+        switch (pending.op) {
+            case FLAGOP_ADD: return pending.a + pending.b > 0xFF;
+            case FLAGOP_SUB: return pending.a < pending.b;
+            case FLAGOP_LOGIC: return false;
+            default: return (flags & FLAG_C) != 0;
+        }
+    }
+    
 private:
     // Helper functions for flag updates
     void updateZeroFlag(uint8_t result, uint8_t& flags);
@@ -45,6 +97,14 @@ private:
     void updateCarryFlag(bool carry, uint8_t& flags);
     void updateOverflowFlag(uint8_t a, uint8_t b, uint8_t result, bool isSubtraction, uint8_t& flags);
     void clearFlags(uint8_t& flags, uint8_t mask);
+    
+    static uint8_t record(uint8_t op, uint8_t a, uint8_t b, uint8_t result, PendingFlags& pending) {
+        pending.op = op;
+        pending.a = a;
+        pending.b = b;
+        pending.result = result;
+        return result;
+    }
 };
 
 #endif // ALU_H
@@ -0,0 +1,306 @@
+#include "batch.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+namespace {
+
+bool readFile(const std::string& path, std::string& contents) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    std::ostringstream buffer;
+    buffer << file.rdbuf();
+    contents = buffer.str();
+    return true;
+}
+
+std::string jsonEscape(const std::string& text) {
+    std::ostringstream out;
+    for (size_t i = 0; i < text.size(); i++) {
+        unsigned char c = text[i];
+        switch (c) {
+            case '"':  out << "\\\""; break;
+            case '\\': out << "\\\\"; break;
+            case '\n': out << "\\n"; break;
+            case '\r': out << "\\r"; break;
+            case '\t': out << "\\t"; break;
+            default:
+                if (c < 0x20 || c >= 0x7F) {
+                    out << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+                        << static_cast<int>(c) << std::dec;
+                } else {
+                    out << c;
+                }
+                break;
+        }
+    }
+    return out.str();
+}
+
+} // namespace
+
+BatchRunner::BatchRunner(ExecutionEngine eng, bool lazy)
+    : engine(eng), lazy_flags(lazy), timing(nullptr), total_seconds(0), thread_count(0) {
+}
+
+bool BatchRunner::loadManifest(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Error: Cannot open manifest '" << path << "'" << std::endl;
+        return false;
+    }
+
+    std::string line;
+    int line_number = 0;
+    while (std::getline(file, line)) {
+        line_number++;
+        size_t comment = line.find('#');
+        if (comment != std::string::npos) {
+            line.erase(comment);
+        }
+
+        std::istringstream fields(line);
+        BatchJob job;
+        job.cycle_budget = CPU::MAX_CYCLES;
+        if (!(fields >> job.binary)) {
+            continue;  // Blank line
+        }
+
+        std::string input;
+        if (fields >> input && input != "-") {
+            job.input = input;
+        }
+
+        std::string budget;
+        if (fields >> budget) {
+            std::istringstream value(budget);
+            if (!(value >> job.cycle_budget) || !value.eof()) {
+                std::cerr << "Error: " << path << ":" << line_number
+                          << ": invalid cycle budget '" << budget << "'" << std::endl;
+                return false;
+            }
+        }
+
+        jobs.push_back(job);
+    }
+    return true;
+}
+
+void BatchRunner::run(unsigned threads) {
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    if (threads > jobs.size()) {
+        threads = std::max<size_t>(jobs.size(), 1);
+    }
+    thread_count = threads;
+
+    results.assign(jobs.size(), BatchResult());
+
+    // Deal the jobs round-robin onto the worker queues
+    std::vector<WorkQueue> queues(threads);
+    for (size_t i = 0; i < jobs.size(); i++) {
+        queues[i % threads].jobs.push_back(i);
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> workers;
+    for (unsigned i = 1; i < threads; i++) {
+        workers.push_back(std::thread(&BatchRunner::worker, this, &queues, i));
+    }
+    worker(&queues, 0);
+    for (size_t i = 0; i < workers.size(); i++) {
+        workers[i].join();
+    }
+
+    total_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void BatchRunner::worker(std::vector<WorkQueue>* queues, unsigned index) {
+    Machine machine;
+    size_t job;
+    while (takeJob(*queues, index, job)) {
+        runJob(job, index, machine);
+    }
+}
+
+bool BatchRunner::takeJob(std::vector<WorkQueue>& queues, unsigned index, size_t& job) {
+    // Own queue first, newest job at the back
+    {
+        WorkQueue& own = queues[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.jobs.empty()) {
+            job = own.jobs.back();
+            own.jobs.pop_back();
+            return true;
+        }
+    }
+
+    // Then steal the oldest job from another worker
+    for (size_t i = 1; i < queues.size(); i++) {
+        WorkQueue& victim = queues[(index + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.jobs.empty()) {
+            job = victim.jobs.front();
+            victim.jobs.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void BatchRunner::runJob(size_t index, int worker_index, Machine& machine) {
+    const BatchJob& job = jobs[index];
+    BatchResult& result = results[index];
+    result.cycles = 0;
+    result.pc = 0;
+    for (int i = 0; i < 8; i++) {
+        result.registers[i] = 0;
+    }
+    result.seconds = 0;
+    result.worker = worker_index;
+
+    std::string input;
+    if (!job.input.empty() && !readFile(job.input, input)) {
+        result.status = "error";
+        result.error = "cannot read input '" + job.input + "'";
+        return;
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    if (machine.memory && machine.binary == job.binary) {
+        // Same program again: undo the previous run
+        machine.memory->reset();
+        machine.cpu->reset();
+    } else {
+        machine.binary.clear();
+        machine.cpu.reset();
+        machine.memory.reset();
+
+        std::string image;
+        if (!readFile(job.binary, image) || image.empty()) {
+            result.status = "error";
+            result.error = "cannot read binary '" + job.binary + "'";
+            return;
+        }
+
+        machine.memory.reset(new Memory());
+        machine.cpu.reset(new CPU(machine.memory.get(), engine));
+        machine.cpu->enableLazyFlags(lazy_flags);
+        machine.cpu->setTimingModel(timing);
+        machine.memory->getConsole().getOutput().open(ConsoleTarget::Capture, FlushPolicy::Immediate);
+
+        if (!machine.memory->loadProgram(std::vector<uint8_t>(image.begin(), image.end()))) {
+            result.status = "error";
+            result.error = "program too large";
+            machine.cpu.reset();
+            machine.memory.reset();
+            return;
+        }
+        machine.memory->setBaseline();
+        machine.binary = job.binary;
+    }
+
+    Memory& memory = *machine.memory;
+    CPU& cpu = *machine.cpu;
+    cpu.setCycleLimit(job.cycle_budget);
+
+    Console& console = memory.getConsole();
+    if (job.input.empty()) {
+        console.getInput().close();
+    } else {
+        console.getInput().openBuffer(input);
+    }
+
+    result.status = cpu.runUntilHalt() ? "halted" : "runaway";
+    memory.sync();
+
+    result.output = console.getOutput().getCapture();
+    result.cycles = cpu.getCycleCount();
+    result.pc = cpu.getPC();
+    for (int i = 0; i < 8; i++) {
+        result.registers[i] = cpu.getRegister(i);
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool BatchRunner::allHalted() const {
+    for (size_t i = 0; i < results.size(); i++) {
+        if (results[i].status != "halted") {
+            return false;
+        }
+    }
+    return true;
+}
+
+void BatchRunner::printSummary(std::ostream& out) const {
+    int halted = 0;
+    int runaway = 0;
+    int errors = 0;
+
+    out << "\n=== Batch Results ===" << std::endl;
+    out << "  Job  Status     Cycles  Time(ms)  Output  Program" << std::endl;
+    for (size_t i = 0; i < results.size(); i++) {
+        const BatchResult& result = results[i];
+        if (result.status == "halted") {
+            halted++;
+        } else if (result.status == "runaway") {
+            runaway++;
+        } else {
+            errors++;
+        }
+
+        out << std::setfill(' ') << std::right << std::setw(5) << i << "  "
+            << std::left << std::setw(8) << result.status << std::right
+            << std::setw(9) << result.cycles
+            << std::setw(10) << std::fixed << std::setprecision(2) << result.seconds * 1000.0
+            << std::setw(8) << result.output.size() << "  " << jobs[i].binary;
+        if (!result.error.empty()) {
+            out << " (" << result.error << ")";
+        }
+        out << std::endl;
+    }
+
+    out << "Total: " << results.size() << " jobs (" << halted << " halted, "
+        << runaway << " runaway, " << errors << " error) in "
+        << std::fixed << std::setprecision(2) << total_seconds * 1000.0 << " ms on "
+        << thread_count << " threads" << std::endl;
+    out.unsetf(std::ios::floatfield);
+}
+
+bool BatchRunner::writeResults(const std::string& path) const {
+    std::ofstream out(path);
+    if (!out) {
+        std::cerr << "Error: Cannot open results file '" << path << "'" << std::endl;
+        return false;
+    }
+
+    for (size_t i = 0; i < results.size(); i++) {
+        const BatchResult& result = results[i];
+        out << "{\"job\":" << i
+            << ",\"binary\":\"" << jsonEscape(jobs[i].binary) << "\""
+            << ",\"input\":\"" << jsonEscape(jobs[i].input) << "\""
+            << ",\"status\":\"" << result.status << "\"";
+        if (!result.error.empty()) {
+            out << ",\"error\":\"" << jsonEscape(result.error) << "\"";
+        }
+        out << ",\"cycles\":" << result.cycles
+            << ",\"pc\":" << result.pc
+            << ",\"regs\":[";
+        for (int r = 0; r < 8; r++) {
+            out << (r ? "," : "") << static_cast<int>(result.registers[r]);
+        }
+        out << "],\"seconds\":" << result.seconds
+            << ",\"worker\":" << result.worker
+            << ",\"output\":\"" << jsonEscape(result.output) << "\"}\n";
+    }
+    return true;
+}
@@ -0,0 +1,100 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "cpu.h"
+
+/**
+ * BatchJob - One program run in a batch
+ */
+struct BatchJob {
+    std::string binary;       // Program image, loaded at 0x0100
+    std::string input;        // File fed to CONSOLE_IN (empty: none)
+    uint64_t cycle_budget;    // Runaway limit for this job
+};
+
+/**
+ * BatchResult - Outcome of a BatchJob
+ */
+struct BatchResult {
+    std::string status;       // "halted", "runaway" or "error"
+    std::string error;        // Reason for "error"
+    std::string output;       // Captured console output
+    uint64_t cycles;
+    uint16_t pc;
+    uint8_t registers[8];
+    double seconds;           // Host time for the job
+    int worker;               // Thread that ran it
+};
+
+/**
+ * BatchRunner class - Runs many independent programs in parallel
+ *
+ * Each job runs on its own Memory and CPU, with console output captured
+ * in memory and console input read from the job's input file. Jobs are
+ * dealt round-robin onto one queue per worker thread; a worker takes
+ * jobs from the back of its own queue and, once that is empty, steals
+ * from the front of the others, so long and short jobs balance out.
+ *
+ * A worker keeps its machine between jobs. When the next job runs the
+ * same binary, the machine is reset instead of rebuilt: Memory restores
+ * only the pages the previous run dirtied, and the decode cache and JIT
+ * translations for untouched code stay valid.
+ *
+ * Manifest format, one job per line ('#' starts a comment):
+ *   <binary> [<input file> | -] [<cycle budget>]
+ */
+class BatchRunner {
+private:
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<size_t> jobs;
+    };
+
+    // A worker's machine, kept while consecutive jobs share a binary
+    struct Machine {
+        std::string binary;
+        std::unique_ptr<Memory> memory;
+        std::unique_ptr<CPU> cpu;
+    };
+
+    std::vector<BatchJob> jobs;
+    std::vector<BatchResult> results;
+    ExecutionEngine engine;
+    bool lazy_flags;
+    const TimingModel* timing;
+    double total_seconds;
+    unsigned thread_count;
+
+    void worker(std::vector<WorkQueue>* queues, unsigned index);
+    bool takeJob(std::vector<WorkQueue>& queues, unsigned index, size_t& job);
+    void runJob(size_t job, int worker_index, Machine& machine);
+
+public:
+    BatchRunner(ExecutionEngine eng = ExecutionEngine::Switch, bool lazy = false);
+
+    // Job list
+    bool loadManifest(const std::string& path);
+    void addJob(const BatchJob& job) { jobs.push_back(job); }
+    const std::vector<BatchJob>& getJobs() const { return jobs; }
+
+    // Cycle costs for every job (shared read-only by the workers)
+    void setTimingModel(const TimingModel* model) { timing = model; }
+
+    // Run every job on `threads` worker threads (0: one per host core)
+    void run(unsigned threads);
+
+    // Results, in job order
+    const std::vector<BatchResult>& getResults() const { return results; }
+    bool allHalted() const;
+    void printSummary(std::ostream& out) const;
+    bool writeResults(const std::string& path) const;   // JSON lines
+};
+
+#endif // BATCH_H
@@ -0,0 +1,93 @@
+#include "branch_predictor.h"
+
+namespace {
+
+bool isConditional(const DecodedOp& op) {
+    return op.handler >= 0x19 && op.handler <= 0x1C;
+}
+
+// Saturating 2-bit counter step
+uint8_t train(uint8_t counter, bool taken) {
+    if (taken) {
+        return counter < 3 ? counter + 1 : 3;
+    }
+    return counter > 0 ? counter - 1 : 0;
+}
+
+} // namespace
+
+std::unique_ptr<BranchPredictor> BranchPredictor::create(const std::string& name) {
+    if (name == "static") {
+        return std::unique_ptr<BranchPredictor>(new StaticPredictor());
+    } else if (name == "bimodal") {
+        return std::unique_ptr<BranchPredictor>(new BimodalPredictor());
+    } else if (name == "btb") {
+        return std::unique_ptr<BranchPredictor>(new BtbPredictor());
+    }
+    return nullptr;
+}
+
+BranchPrediction StaticPredictor::predict(uint16_t pc, const DecodedOp& op) {
+    BranchPrediction prediction;
+    prediction.taken = !isConditional(op) || op.target <= pc;
+    prediction.target_known = false;
+    prediction.target = 0;
+    return prediction;
+}
+
+BimodalPredictor::BimodalPredictor(size_t entries) : counters(entries, 1) {
+}
+
+BranchPrediction BimodalPredictor::predict(uint16_t pc, const DecodedOp& op) {
+    BranchPrediction prediction;
+    prediction.taken = !isConditional(op) || counters[pc % counters.size()] >= 2;
+    prediction.target_known = false;
+    prediction.target = 0;
+    return prediction;
+}
+
+void BimodalPredictor::update(uint16_t pc, const DecodedOp& op, bool taken, uint16_t) {
+    if (isConditional(op)) {
+        uint8_t& counter = counters[pc % counters.size()];
+        counter = train(counter, taken);
+    }
+}
+
+BtbPredictor::BtbPredictor(size_t size) : entries(size) {
+    for (size_t i = 0; i < entries.size(); i++) {
+        entries[i].valid = false;
+    }
+}
+
+BranchPrediction BtbPredictor::predict(uint16_t pc, const DecodedOp& op) {
+    BranchPrediction prediction;
+    const Entry* entry = find(pc);
+    if (entry) {
+        prediction.taken = !isConditional(op) || entry->counter >= 2;
+        prediction.target_known = true;
+        prediction.target = entry->target;
+    } else {
+        prediction.taken = !isConditional(op);
+        prediction.target_known = false;
+        prediction.target = 0;
+    }
+    return prediction;
+}
+
+void BtbPredictor::update(uint16_t pc, const DecodedOp& op, bool taken, uint16_t target) {
+    Entry* entry = find(pc);
+    if (!entry) {
+        if (!taken) {
+            return;
+        }
+        entry = &entries[pc % entries.size()];
+        entry->valid = true;
+        entry->pc = pc;
+        entry->counter = 2;   // Weakly taken
+    } else if (isConditional(op)) {
+        entry->counter = train(entry->counter, taken);
+    }
+    if (taken) {
+        entry->target = target;
+    }
+}
@@ -0,0 +1,97 @@
+#ifndef BRANCH_PREDICTOR_H
+#define BRANCH_PREDICTOR_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "decode_cache.h"
+
+/**
+ * BranchPrediction - What the fetch stage guesses for a control transfer
+ */
+struct BranchPrediction {
+    bool taken;
+    bool target_known;    // Target available at fetch, not only after decode
+    uint16_t target;
+};
+
+/**
+ * BranchPredictor - Interface for the pipeline model's predictors
+ *
+ * predict() is asked at fetch for every JMP, Jcc, CALL and RET, and
+ * update() is told the outcome once the instruction has executed.
+ * Without a known target a predicted-taken transfer can only redirect
+ * fetch from decode; a RET's address comes from the stack.
+ */
+class BranchPredictor {
+public:
+    virtual ~BranchPredictor() {}
+
+    virtual const char* name() const = 0;
+    virtual BranchPrediction predict(uint16_t pc, const DecodedOp& op) = 0;
+    virtual void update(uint16_t pc, const DecodedOp& op, bool taken, uint16_t target) = 0;
+
+    // "static", "bimodal" or "btb"; nullptr for any other name
+    static std::unique_ptr<BranchPredictor> create(const std::string& name);
+};
+
+/**
+ * StaticPredictor - Backward taken, forward not taken
+ */
+class StaticPredictor : public BranchPredictor {
+public:
+    const char* name() const { return "static"; }
+    BranchPrediction predict(uint16_t pc, const DecodedOp& op);
+    void update(uint16_t, const DecodedOp&, bool, uint16_t) {}
+};
+
+/**
+ * BimodalPredictor - 2-bit saturating counters indexed by PC
+ */
+class BimodalPredictor : public BranchPredictor {
+private:
+    std::vector<uint8_t> counters;   // 0-1 predict not taken, 2-3 taken
+
+public:
+    explicit BimodalPredictor(size_t entries = 1024);
+
+    const char* name() const { return "bimodal"; }
+    BranchPrediction predict(uint16_t pc, const DecodedOp& op);
+    void update(uint16_t pc, const DecodedOp& op, bool taken, uint16_t target);
+};
+
+/**
+ * BtbPredictor - Direct-mapped branch target buffer
+ *
+ * Each entry holds a branch's address, its last target and a 2-bit
+ * counter. A hit supplies the target at fetch, so correctly predicted
+ * transfers (RET included, when it returns where it did last time)
+ * cost no bubble. Entries are allocated when a transfer is taken; a
+ * miss predicts a conditional branch not taken.
+ */
+class BtbPredictor : public BranchPredictor {
+private:
+    struct Entry {
+        bool valid;
+        uint16_t pc;
+        uint16_t target;
+        uint8_t counter;
+    };
+
+    std::vector<Entry> entries;
+
+    Entry* find(uint16_t pc) {
+        Entry& entry = entries[pc % entries.size()];
+        return entry.valid && entry.pc == pc ? &entry : nullptr;
+    }
+
+public:
+    explicit BtbPredictor(size_t size = 64);
+
+    const char* name() const { return "btb"; }
+    BranchPrediction predict(uint16_t pc, const DecodedOp& op);
+    void update(uint16_t pc, const DecodedOp& op, bool taken, uint16_t target);
+};
+
+#endif // BRANCH_PREDICTOR_H
@@ -1,26 +1,223 @@
 #include "bus.h"
+#include <cstring>
 
-Bus::Bus() : address_bus(0), data_bus(0) {
+Bus::Bus(uint8_t* backing) : ram(backing), tracked(1 << DIRTY_RESET), interceptor(nullptr), lock(nullptr) {
+    for (int page = 0; page < 256; page++) {
+        watched[page] = false;
+        dirty[page] = 0;
+        updatePage(page);
+    }
 }
 
-void Bus::setAddress(uint16_t address) {
-    address_bus = address;
+void Bus::attach(Device* device, uint16_t address) {
+    uint8_t page = address >> 8;
+    if (handlers[page].empty()) {
+        handlers[page].resize(256, nullptr);
+    }
+    handlers[page][address & 0xFF] = device;
+    updatePage(page);
+    
+    for (size_t i = 0; i < devices.size(); i++) {
+        if (devices[i] == device) {
+            return;
+        }
+    }
+    devices.push_back(device);
 }
 
-uint16_t Bus::getAddress() const {
-    return address_bus;
+bool Bus::copyBlock(uint16_t destination, uint16_t source, uint16_t count) {
+    if (!lock) {
+        std::memmove(&ram[destination], &ram[source], count);
+        return markWritten(destination, count);
+    }
+
+    // Other cores touch these bytes without the lock, so move them one
+    // relaxed atomic at a time, in memmove's order for overlaps
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t offset = destination <= source ? i : count - 1 - i;
+        uint8_t value = __atomic_load_n(&ram[source + offset], __ATOMIC_RELAXED);
+        __atomic_store_n(&ram[destination + offset], value, __ATOMIC_RELAXED);
+    }
+    return markWritten(destination, count);
+}
+
+bool Bus::fillBlock(uint16_t destination, uint8_t value, uint16_t count) {
+    if (!lock) {
+        std::memset(&ram[destination], value, count);
+        return markWritten(destination, count);
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        __atomic_store_n(&ram[destination + i], value, __ATOMIC_RELAXED);
+    }
+    return markWritten(destination, count);
+}
+
+bool Bus::markWritten(uint16_t start, uint16_t count) {
+    if (count == 0) {
+        return false;
+    }
+    bool code = false;
+    for (uint32_t page = start >> 8; page <= static_cast<uint32_t>(start + count - 1) >> 8; page++) {
+        markDirty(page);
+        code |= watched[page];
+    }
+    return code;
+}
+
+void Bus::resetDevices() {
+    for (size_t i = 0; i < devices.size(); i++) {
+        devices[i]->reset();
+    }
+}
+
+void Bus::syncDevices() {
+    for (size_t i = 0; i < devices.size(); i++) {
+        devices[i]->sync();
+    }
+}
+
+void Bus::saveDevices(SnapshotWriter& snapshot) const {
+    for (size_t i = 0; i < devices.size(); i++) {
+        devices[i]->save(snapshot);
+    }
+}
+
+bool Bus::restoreDevices(SnapshotReader& snapshot) {
+    bool restored = true;
+    for (size_t i = 0; i < devices.size(); i++) {
+        restored = devices[i]->restore(snapshot) && restored;
+    }
+    return restored;
+}
+
+void Bus::setBacking(uint8_t* backing) {
+    ram = backing;
+    for (int page = 0; page < 256; page++) {
+        updatePage(page);
+    }
+}
+
+void Bus::watchPage(uint8_t page) {
+    std::unique_lock<std::recursive_mutex> guard = lockShared();
+    watched[page] = true;
+    updatePage(page);
 }
 
-void Bus::setData(uint8_t data) {
-    data_bus = data;
+void Bus::clearWatches() {
+    for (int page = 0; page < 256; page++) {
+        if (watched[page]) {
+            watched[page] = false;
+            updatePage(page);
+        }
+    }
 }
 
-uint8_t Bus::getData() const {
-    return data_bus;
+void Bus::markDirty(uint8_t page) {
+    uint8_t missing = tracked & ~dirty[page];
+    if (!missing) {
+        return;
+    }
+    for (int channel = 0; channel < DIRTY_CHANNELS; channel++) {
+        if (missing & (1 << channel)) {
+            dirty_pages[channel].push_back(page);
+        }
+    }
+    dirty[page] |= missing;
+    updatePage(page);
 }
 
-void Bus::reset() {
-    address_bus = 0;
-    data_bus = 0;
+void Bus::clearDirty(DirtyChannel channel) {
+    std::vector<uint8_t>& pages = dirty_pages[channel];
+    for (size_t i = 0; i < pages.size(); i++) {
+        dirty[pages[i]] &= ~(1 << channel);
+        updatePage(pages[i]);
+    }
+    pages.clear();
 }
 
+void Bus::trackDirty(DirtyChannel channel, bool enable) {
+    clearDirty(channel);
+    if (enable) {
+        tracked |= 1 << channel;
+    } else {
+        tracked &= ~(1 << channel);
+    }
+    for (int page = 0; page < 256; page++) {
+        updatePage(page);
+    }
+}
+
+void Bus::updatePage(uint8_t page) {
+    uint8_t* base = ram + (page << 8);
+    bool has_devices = !handlers[page].empty();
+    bool clean = (dirty[page] & tracked) != tracked;
+    __atomic_store_n(&read_pages[page], has_devices ? nullptr : base, __ATOMIC_RELAXED);
+    __atomic_store_n(&write_pages[page], (has_devices || watched[page] || clean) ? nullptr : base,
+                     __ATOMIC_RELAXED);
+}
+
+Device* Bus::deviceAt(uint16_t address) const {
+    const std::vector<Device*>& page = handlers[address >> 8];
+    return page.empty() ? nullptr : page[address & 0xFF];
+}
+
+std::unique_lock<std::recursive_mutex> Bus::lockShared() {
+    return lock ? std::unique_lock<std::recursive_mutex>(*lock) : std::unique_lock<std::recursive_mutex>();
+}
+
+uint8_t Bus::readSlow(uint16_t address) {
+    std::unique_lock<std::recursive_mutex> guard = lockShared();
+    return readLocked(address);
+}
+
+bool Bus::writeSlow(uint16_t address, uint8_t value) {
+    std::unique_lock<std::recursive_mutex> guard = lockShared();
+    return writeLocked(address, value);
+}
+
+bool Bus::compareExchangeSlow(uint16_t address, uint8_t& value, uint8_t desired) {
+    std::unique_lock<std::recursive_mutex> guard = lockShared();
+    if (deviceAt(address)) {
+        uint8_t old = readLocked(address);
+        if (old == value) {
+            writeLocked(address, desired);
+        }
+        value = old;
+        return false;
+    }
+    
+    // Another core may reach this byte through the direct path
+    if (!__atomic_compare_exchange_n(&ram[address], &value, desired, false,
+                                     __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+        return false;
+    }
+    markDirty(address >> 8);
+    return watched[address >> 8];
+}
+
+uint8_t Bus::readLocked(uint16_t address) {
+    Device* device = deviceAt(address);
+    if (!device) {
+        return __atomic_load_n(&ram[address], __ATOMIC_RELAXED);
+    }
+    if (interceptor && device->isHostInput(address)) {
+        return interceptor->read(device, address);
+    }
+    return device->read(address);
+}
+
+bool Bus::writeLocked(uint16_t address, uint8_t value) {
+    Device* device = deviceAt(address);
+    if (device) {
+        if (interceptor && (device->isLoggedWrite(address) || device->isHostOutput(address)) &&
+            !interceptor->write(device, address, value)) {
+            return false;
+        }
+        device->write(address, value);
+        return false;
+    }
+    __atomic_store_n(&ram[address], value, __ATOMIC_RELAXED);
+    markDirty(address >> 8);
+    return watched[address >> 8];
+}
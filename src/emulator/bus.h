@@ -1,37 +1,149 @@
 #ifndef BUS_H
 #define BUS_H
 
+#include <cstddef>
 #include <cstdint>
+#include <mutex>
+#include <vector>
+#include "device.h"
 
 /**
- * Bus class - Simulates the system bus connecting CPU and Memory
+ * Bus class - Routes memory accesses to RAM or to I/O devices
  * 
- * The bus provides a simple interface for data transfer between
- * the CPU and memory subsystem.
+ * The 64KB address space is split into 256 pages of 256 bytes. Each
+ * page has a read and a write entry in the page table: a pointer to
+ * the page's RAM when accesses can go straight to memory, or nullptr
+ * when they must take the slow path. A page goes through the slow path
+ * when a device is attached to any of its addresses (writes and reads),
+ * when it is watched for modification, or while it is still clean
+ * (writes only).
+ * 
+ * Dirty tracking has independent channels: DIRTY_RESET (always on, for
+ * Memory::reset) and DIRTY_CHECKPOINT (on while time travel records
+ * checkpoints). The first write to a page that is clean in any tracked
+ * channel marks it dirty in all of them and, once no channel needs to
+ * see it, installs its direct write pointer, so tracking costs one
+ * slow-path write per page between calls to clearDirty().
+ * 
+ * Host I/O registers are routed through an IoInterceptor while one is
+ * installed (see device.h).
+ * 
+ * RAM accesses therefore cost one table lookup and no address compares.
+ * Inside a device page, addresses without a device still read and
+ * write RAM.
+ * 
+ * When several cores share the bus (setLock), the slow path runs under
+ * the shared lock, so devices, dirty tracking and watches only ever
+ * see one core at a time. Direct RAM accesses take no lock: they are
+ * relaxed atomic byte accesses (plain loads and stores on the host),
+ * and compareExchange() is a sequentially consistent host atomic.
  */
 class Bus {
+public:
+    enum DirtyChannel {
+        DIRTY_RESET = 0,        // Written since the last Memory::reset
+        DIRTY_CHECKPOINT = 1,   // Written since the last time-travel checkpoint
+        DIRTY_CHANNELS = 2
+    };
+    
 private:
-    uint16_t address_bus;  // 16-bit address bus
-    uint8_t data_bus;      // 8-bit data bus
+    uint8_t* ram;                          // Backing store (64KB)
+    uint8_t* read_pages[256];              // Direct page pointer or nullptr
+    uint8_t* write_pages[256];
+    std::vector<Device*> handlers[256];    // Per-address devices (empty for RAM pages)
+    bool watched[256];                     // Writes must be reported
+    uint8_t dirty[256];                    // Bit per channel: written since clearDirty()
+    uint8_t tracked;                       // Bit per channel in use
+    std::vector<uint8_t> dirty_pages[DIRTY_CHANNELS];  // In first-write order
+    std::vector<Device*> devices;          // Every attached device, once
+    IoInterceptor* interceptor;            // Host I/O hook, or nullptr
+    std::recursive_mutex* lock;            // Serializes the slow path, or nullptr
+    
+    void updatePage(uint8_t page);
+    Device* deviceAt(uint16_t address) const;
+    std::unique_lock<std::recursive_mutex> lockShared();
+    uint8_t readSlow(uint16_t address);
+    bool writeSlow(uint16_t address, uint8_t value);
+    bool compareExchangeSlow(uint16_t address, uint8_t& value, uint8_t desired);
+    uint8_t readLocked(uint16_t address);
+    bool writeLocked(uint16_t address, uint8_t value);
+    bool markWritten(uint16_t start, uint16_t count);
+    
+    Bus(const Bus&);
+    Bus& operator=(const Bus&);
     
 public:
-    Bus();
+    Bus(uint8_t* backing);
     
-    // Set address on address bus
-    void setAddress(uint16_t address);
+    // Read a byte from RAM or the device mapped at address
+    uint8_t read(uint16_t address) {
+        uint8_t* page = __atomic_load_n(&read_pages[address >> 8], __ATOMIC_RELAXED);
+        if (page) {
+            return __atomic_load_n(&page[address & 0xFF], __ATOMIC_RELAXED);
+        }
+        return readSlow(address);
+    }
     
-    // Get current address
-    uint16_t getAddress() const;
+    // Write a byte; returns true if the address is in a watched page
+    bool write(uint16_t address, uint8_t value) {
+        uint8_t* page = __atomic_load_n(&write_pages[address >> 8], __ATOMIC_RELAXED);
+        if (page) {
+            __atomic_store_n(&page[address & 0xFF], value, __ATOMIC_RELAXED);
+            return false;
+        }
+        return writeSlow(address, value);
+    }
     
-    // Set data on data bus
-    void setData(uint8_t data);
+    // Atomically replace the byte with `desired` if it equals `value`;
+    // `value` receives the old byte either way. Returns true if the
+    // replacement was written to a watched page.
+    bool compareExchange(uint16_t address, uint8_t& value, uint8_t desired) {
+        uint8_t* page = __atomic_load_n(&write_pages[address >> 8], __ATOMIC_RELAXED);
+        if (page) {
+            __atomic_compare_exchange_n(&page[address & 0xFF], &value, desired, false,
+                                        __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+            return false;
+        }
+        return compareExchangeSlow(address, value, desired);
+    }
     
-    // Get data from data bus
-    uint8_t getData() const;
+    // Block transfers within RAM (the caller keeps them below the I/O
+    // region), byte by byte with relaxed atomics while a lock is
+    // installed. Return true if a watched page was written.
+    bool copyBlock(uint16_t destination, uint16_t source, uint16_t count);
+    bool fillBlock(uint16_t destination, uint8_t value, uint16_t count);
     
-    // Reset bus
-    void reset();
+    // Device routing
+    void attach(Device* device, uint16_t address);
+    void resetDevices();
+    void syncDevices();
+    void saveDevices(SnapshotWriter& snapshot) const;
+    bool restoreDevices(SnapshotReader& snapshot);
+    
+    // Switch to another 64KB backing store
+    void setBacking(uint8_t* backing);
+    
+    // Pass host I/O registers through an interceptor (nullptr: none)
+    void setInterceptor(IoInterceptor* hook) { interceptor = hook; }
+    
+    // Share the bus between threads: slow-path accesses hold `mutex`
+    // (nullptr: single-threaded, no locking)
+    void setLock(std::recursive_mutex* mutex) { lock = mutex; }
+    
+    // True if reads of the page go straight to RAM
+    bool isRamPage(uint8_t page) const { return read_pages[page] != nullptr; }
+    
+    // Write watching
+    void watchPage(uint8_t page);
+    void clearWatches();
+    
+    // Dirty page tracking
+    void markDirty(uint8_t page);
+    void clearDirty(DirtyChannel channel = DIRTY_RESET);
+    void trackDirty(DirtyChannel channel, bool enable);
+    const std::vector<uint8_t>& getDirtyPages(DirtyChannel channel = DIRTY_RESET) const {
+        return dirty_pages[channel];
+    }
 };
 
 #endif // BUS_H
-
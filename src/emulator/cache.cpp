@@ -0,0 +1,308 @@
+#include "cache.h"
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include "cpu.h"
+
+namespace {
+
+const char* const REGION_NAMES[] = { "code", "stack", "data", "writeback" };
+
+const char* policyName(ReplacementPolicy policy) {
+    switch (policy) {
+        case ReplacementPolicy::Fifo:
+            return "FIFO";
+        case ReplacementPolicy::Random:
+            return "random";
+        default:
+            return "LRU";
+    }
+}
+
+bool isPowerOfTwo(uint32_t value) {
+    return value != 0 && (value & (value - 1)) == 0;
+}
+
+CacheConfig makeConfig(uint32_t size, uint32_t ways, uint32_t line) {
+    CacheConfig config;
+    config.enabled = true;
+    config.size = size;
+    config.ways = ways;
+    config.line = line;
+    config.policy = ReplacementPolicy::Lru;
+    return config;
+}
+
+CacheRegion regionOf(uint16_t address) {
+    return (address >> 8) == (CPU::STACK_PAGE >> 8) ? REGION_STACK : REGION_DATA;
+}
+
+} // namespace
+
+Cache::Cache(const std::string& cache_name, const CacheConfig& cache_config)
+    : name(cache_name), config(cache_config), sets(config.size / (config.ways * config.line)),
+      line_shift(0), lines(config.size / config.line), clock(0), random_state(0x2545F491) {
+    while ((1u << line_shift) < config.line) {
+        line_shift++;
+    }
+    for (size_t i = 0; i < lines.size(); i++) {
+        lines[i].valid = false;
+        lines[i].dirty = false;
+        lines[i].block = 0;
+        lines[i].used = 0;
+        lines[i].filled = 0;
+    }
+    for (int i = 0; i < REGION_COUNT; i++) {
+        accesses[i] = 0;
+        misses[i] = 0;
+    }
+}
+
+uint32_t Cache::victim(uint32_t set) {
+    Line* ways = &lines[set * config.ways];
+    for (uint32_t way = 0; way < config.ways; way++) {
+        if (!ways[way].valid) {
+            return way;
+        }
+    }
+    if (config.policy == ReplacementPolicy::Random) {
+        // xorshift32: repeatable from run to run
+        random_state ^= random_state << 13;
+        random_state ^= random_state >> 17;
+        random_state ^= random_state << 5;
+        return random_state % config.ways;
+    }
+
+    uint32_t oldest = 0;
+    for (uint32_t way = 1; way < config.ways; way++) {
+        uint64_t age = config.policy == ReplacementPolicy::Fifo ? ways[way].filled : ways[way].used;
+        uint64_t oldest_age = config.policy == ReplacementPolicy::Fifo ? ways[oldest].filled : ways[oldest].used;
+        if (age < oldest_age) {
+            oldest = way;
+        }
+    }
+    return oldest;
+}
+
+bool Cache::access(uint16_t address, bool write, CacheRegion region, bool& evicted, uint16_t& evicted_address) {
+    uint16_t block = address >> line_shift;
+    uint32_t set = block & (sets - 1);
+    Line* ways = &lines[set * config.ways];
+    clock++;
+    accesses[region]++;
+    evicted = false;
+
+    for (uint32_t way = 0; way < config.ways; way++) {
+        if (ways[way].valid && ways[way].block == block) {
+            ways[way].used = clock;
+            ways[way].dirty |= write;
+            return true;
+        }
+    }
+
+    misses[region]++;
+    Line& line = ways[victim(set)];
+    if (line.valid && line.dirty) {
+        evicted = true;
+        evicted_address = line.block << line_shift;
+    }
+    line.valid = true;
+    line.dirty = write;
+    line.block = block;
+    line.used = clock;
+    line.filled = clock;
+    return false;
+}
+
+void Cache::report(std::ostream& stream) const {
+    stream << name << ": " << config.size << " B, " << config.ways << "-way, " << config.line
+           << " B lines, " << policyName(config.policy) << std::endl;
+    stream << "  Region        Accesses        Hits      Misses  Hit rate" << std::endl;
+    uint64_t total_accesses = 0;
+    uint64_t total_misses = 0;
+    for (int i = 0; i <= REGION_COUNT; i++) {
+        uint64_t count = i < REGION_COUNT ? accesses[i] : total_accesses;
+        uint64_t missed = i < REGION_COUNT ? misses[i] : total_misses;
+        if (i < REGION_COUNT) {
+            if (count == 0) {
+                continue;
+            }
+            total_accesses += count;
+            total_misses += missed;
+        }
+        stream << "  " << std::left << std::setw(10) << (i < REGION_COUNT ? REGION_NAMES[i] : "total")
+               << std::right << std::setw(12) << count << std::setw(12) << (count - missed)
+               << std::setw(12) << missed << std::setw(9) << std::fixed << std::setprecision(2)
+               << (count ? 100.0 * (count - missed) / count : 0.0) << "%" << std::endl;
+    }
+}
+
+CacheHierarchy::Config::Config()
+    : l1i(makeConfig(1024, 2, 16)), l1d(makeConfig(1024, 4, 16)), l2(makeConfig(8192, 8, 32)),
+      l2_latency(8), memory_latency(40) {
+}
+
+bool CacheHierarchy::Config::load(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "Error: Cannot open cache configuration '" << path << "'" << std::endl;
+        return false;
+    }
+
+    std::string line;
+    int number = 0;
+    while (std::getline(in, line)) {
+        number++;
+        std::istringstream fields(line.substr(0, line.find('#')));
+        std::string key;
+        if (!(fields >> key)) {
+            continue;
+        }
+
+        if (key == "l1i" || key == "l1d" || key == "l2") {
+            CacheConfig& cache = key == "l1i" ? l1i : key == "l1d" ? l1d : l2;
+            std::string first;
+            fields >> first;
+            if (key == "l2" && first == "off") {
+                l2.enabled = false;
+                continue;
+            }
+
+            std::istringstream size_field(first);
+            uint32_t size = 0;
+            uint32_t ways = 0;
+            uint32_t line_size = 0;
+            std::string policy;
+            size_field >> size;
+            fields >> ways >> line_size >> policy;
+            if (!fields || !size_field) {
+                std::cerr << "Error: " << path << ":" << number << ": expected '" << key
+                          << " size ways line policy'" << std::endl;
+                return false;
+            }
+            if (!isPowerOfTwo(size) || !isPowerOfTwo(ways) || !isPowerOfTwo(line_size) ||
+                size > 65536 || static_cast<uint64_t>(ways) * line_size > size) {
+                std::cerr << "Error: " << path << ":" << number << ": " << key
+                          << " sizes must be powers of two with ways * line <= size <= 65536" << std::endl;
+                return false;
+            }
+            cache = makeConfig(size, ways, line_size);
+            if (policy == "fifo") {
+                cache.policy = ReplacementPolicy::Fifo;
+            } else if (policy == "random") {
+                cache.policy = ReplacementPolicy::Random;
+            } else if (policy != "lru") {
+                std::cerr << "Error: " << path << ":" << number << ": unknown replacement policy '"
+                          << policy << "'" << std::endl;
+                return false;
+            }
+        } else if (key == "l2_latency" || key == "memory_latency") {
+            uint32_t cycles;
+            if (!(fields >> cycles)) {
+                std::cerr << "Error: " << path << ":" << number << ": bad cycle count for '"
+                          << key << "'" << std::endl;
+                return false;
+            }
+            (key == "l2_latency" ? l2_latency : memory_latency) = cycles;
+        } else {
+            std::cerr << "Error: " << path << ":" << number << ": unknown entry '" << key << "'" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+CacheHierarchy::CacheHierarchy(const Config& config)
+    : l1i("L1I", config.l1i), l1d("L1D", config.l1d),
+      l2(config.l2.enabled ? new Cache("L2", config.l2) : nullptr),
+      l2_latency(config.l2_latency), memory_latency(config.memory_latency),
+      uncached(0), stall_cycles(0) {
+}
+
+uint32_t CacheHierarchy::access(Cache& l1, uint16_t address, bool write, CacheRegion region) {
+    if (address >= 0xFF00) {
+        uncached++;
+        return 0;
+    }
+
+    bool evicted = false;
+    uint16_t evicted_address = 0;
+    if (l1.access(address, write, region, evicted, evicted_address)) {
+        return 0;
+    }
+
+    uint32_t cycles = memory_latency;
+    if (l2) {
+        // L2's own dirty victims go to memory through a write buffer
+        bool l2_evicted = false;
+        uint16_t l2_evicted_address = 0;
+        cycles = l2->access(address, false, region, l2_evicted, l2_evicted_address)
+            ? l2_latency : l2_latency + memory_latency;
+        if (evicted) {
+            l2->access(evicted_address, true, REGION_WRITEBACK, l2_evicted, l2_evicted_address);
+        }
+    }
+    stall_cycles += cycles;
+    return cycles;
+}
+
+uint32_t CacheHierarchy::instruction(const DecodedOp& op, uint16_t pc, uint8_t sp, uint16_t address) {
+    // Fetch every line the instruction's bytes span
+    uint32_t cycles = access(l1i, pc, false, REGION_CODE);
+    uint16_t last = pc + op.length - 1;
+    if ((last ^ pc) & ~(l1i.lineSize() - 1)) {
+        cycles += access(l1i, last, false, REGION_CODE);
+    }
+
+    switch (op.handler) {
+        case 0x10: // LOAD
+        case HANDLER_LOAD_INDIRECT:
+            cycles += access(l1d, address, false, regionOf(address));
+            break;
+        case 0x11: // STORE
+        case HANDLER_STORE_INDIRECT:
+        case 0x17: // CAS: one read-for-ownership
+            cycles += access(l1d, address, true, regionOf(address));
+            break;
+        case 0x15: // PUSH
+            cycles += access(l1d, CPU::pushAddress(sp), true, REGION_STACK);
+            break;
+        case 0x16: // POP
+            cycles += access(l1d, CPU::popAddress(sp), false, REGION_STACK);
+            break;
+        case 0x1D: // CALL
+            cycles += access(l1d, CPU::pushAddress(sp), true, REGION_STACK);
+            cycles += access(l1d, CPU::pushAddress(CPU::afterPush(sp)), true, REGION_STACK);
+            break;
+        case 0x1E: // RET
+            cycles += access(l1d, CPU::popAddress(sp), false, REGION_STACK);
+            cycles += access(l1d, CPU::popAddress(CPU::afterPop(sp)), false, REGION_STACK);
+            break;
+        case HANDLER_RETI:
+            for (int i = 0; i < 3; i++) {
+                cycles += access(l1d, CPU::popAddress(sp), false, REGION_STACK);
+                sp = CPU::afterPop(sp);
+            }
+            break;
+    }
+    return cycles;
+}
+
+void CacheHierarchy::report(std::ostream& stream, uint64_t cycles) const {
+    std::ios::fmtflags saved = stream.flags();
+    stream << std::setfill(' ') << "\n=== Caches ===" << std::endl;
+    l1i.report(stream);
+    l1d.report(stream);
+    if (l2) {
+        l2->report(stream);
+    }
+    stream << "Uncached I/O accesses: " << uncached << std::endl;
+    stream << "Miss stall cycles: " << stall_cycles;
+    if (cycles > 0) {
+        stream << " (" << std::fixed << std::setprecision(2) << (100.0 * stall_cycles / cycles)
+               << "% of " << cycles << ")";
+    }
+    stream << std::endl;
+    stream.flags(saved);
+}
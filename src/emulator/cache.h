@@ -0,0 +1,145 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "decode_cache.h"
+
+/**
+ * What an access is for, as reported per cache
+ */
+enum CacheRegion {
+    REGION_CODE,        // Instruction fetches
+    REGION_STACK,       // Data accesses to the stack page (0xFE00-0xFEFF)
+    REGION_DATA,        // Other data accesses
+    REGION_WRITEBACK,   // Dirty lines written back from the level above
+    REGION_COUNT
+};
+
+enum class ReplacementPolicy {
+    Lru,
+    Fifo,
+    Random
+};
+
+/**
+ * CacheConfig - Geometry of one cache (sizes in bytes, powers of two)
+ */
+struct CacheConfig {
+    bool enabled;
+    uint32_t size;
+    uint32_t ways;
+    uint32_t line;
+    ReplacementPolicy policy;
+};
+
+/**
+ * Cache class - One set-associative, write-back, write-allocate cache
+ *
+ * Only tags are kept; data always comes from Memory, so the cache
+ * affects timing and statistics but never what the program sees.
+ */
+class Cache {
+private:
+    struct Line {
+        bool valid;
+        bool dirty;
+        uint16_t block;     // Address / line size
+        uint64_t used;      // Last access (LRU)
+        uint64_t filled;    // Fill time (FIFO)
+    };
+
+    std::string name;
+    CacheConfig config;
+    uint32_t sets;
+    int line_shift;
+    std::vector<Line> lines;
+    uint64_t clock;
+    uint32_t random_state;
+    uint64_t accesses[REGION_COUNT];
+    uint64_t misses[REGION_COUNT];
+
+    uint32_t victim(uint32_t set);
+
+public:
+    Cache(const std::string& cache_name, const CacheConfig& cache_config);
+
+    // Look up `address`, filling its line on a miss. Returns true on a
+    // hit; a dirty line evicted by the fill is reported in `evicted`.
+    bool access(uint16_t address, bool write, CacheRegion region, bool& evicted, uint16_t& evicted_address);
+
+    uint32_t lineSize() const { return config.line; }
+    void report(std::ostream& stream) const;
+};
+
+/**
+ * CacheHierarchy class - Split L1 I/D caches and an optional unified L2
+ *
+ * Sits between the CPU and Memory for timing only: CPU::step() hands
+ * it each executed instruction, and it returns the stall cycles the
+ * instruction's fetch and data accesses cost. An instruction fetch
+ * touches each line its bytes span; LOAD/STORE (direct or
+ * register-indirect) and CAS access their data address, PUSH/POP one
+ * stack byte, CALL/RET two and RETI three. Interrupt entry is not an
+ * instruction and is not modeled. An L1 miss costs the L2 latency,
+ * plus the memory latency if L2 misses too (or the memory latency
+ * alone without an L2). Dirty L1 lines are written back into L2
+ * without stalling. Accesses to the I/O region (0xFF00-0xFFFF)
+ * bypass the caches.
+ *
+ * Configuration file, one entry per line ('#' starts a comment):
+ *
+ *   l1i  1024  2  16  lru        Size, ways, line size, policy
+ *   l1d  1024  4  16  lru        (lru, fifo or random)
+ *   l2   8192  8  32  lru        "l2 off" for no L2
+ *   l2_latency      8
+ *   memory_latency  40
+ *
+ * Entries left out keep the defaults shown above.
+ */
+class CacheHierarchy {
+public:
+    struct Config {
+        CacheConfig l1i;
+        CacheConfig l1d;
+        CacheConfig l2;
+        uint32_t l2_latency;
+        uint32_t memory_latency;
+
+        Config();
+
+        // Read overrides from a file; false (with a message) on error
+        bool load(const std::string& path);
+    };
+
+private:
+    Cache l1i;
+    Cache l1d;
+    std::unique_ptr<Cache> l2;
+    uint32_t l2_latency;
+    uint32_t memory_latency;
+    uint64_t uncached;          // I/O accesses that bypassed the caches
+    uint64_t stall_cycles;
+
+    uint32_t access(Cache& l1, uint16_t address, bool write, CacheRegion region);
+
+    CacheHierarchy(const CacheHierarchy&);
+    CacheHierarchy& operator=(const CacheHierarchy&);
+
+public:
+    explicit CacheHierarchy(const Config& config);
+
+    // Stall cycles for an instruction fetched at `pc` that ran with R7
+    // equal to `sp` and accessed data at `address` (see CPU::dataAddress)
+    uint32_t instruction(const DecodedOp& op, uint16_t pc, uint8_t sp, uint16_t address);
+
+    uint64_t getStallCycles() const { return stall_cycles; }
+
+    // Hit rates per cache and region; `cycles` is the run's total
+    void report(std::ostream& stream, uint64_t cycles) const;
+};
+
+#endif // CACHE_H
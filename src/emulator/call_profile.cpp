@@ -0,0 +1,204 @@
+#include "call_profile.h"
+#include <algorithm>
+#include <iomanip>
+#include <string>
+#include "cpu.h"
+
+CallProfile::CallProfile()
+    : executions(65536, 0), cycles(65536, 0), current(0), started(false),
+      last_pc(0), last_node(0), last_cycle(0) {
+    Node root;
+    root.entry = 0;
+    root.parent = 0;
+    root.depth = 0;
+    root.calls = 0;
+    root.self = 0;
+    nodes.push_back(root);
+}
+
+void CallProfile::fetch(const CPU& cpu, const DecodedOp&) {
+    uint64_t cycle = cpu.getCycleCount();
+    uint16_t pc = cpu.getPC();
+    if (started) {
+        charge(cycle);
+    } else {
+        nodes[0].entry = pc;
+        started = true;
+    }
+    last_pc = pc;
+    last_node = current;
+    last_cycle = cycle;
+    executions[pc]++;
+}
+
+void CallProfile::retire(const CPU& cpu, const DecodedOp& op) {
+    if (op.handler == 0x1D) { // CALL
+        if (stack.size() == MAX_DEPTH) {
+            stack.erase(stack.begin());
+        }
+        Frame frame;
+        frame.node = current;
+        frame.return_pc = last_pc + op.length;
+        stack.push_back(frame);
+        if (nodes[current].depth < MAX_DEPTH) {
+            current = child(current, op.target);
+        }
+        nodes[current].calls++;
+    } else if (op.handler == 0x1E) { // RET
+        if (stack.empty()) {
+            return;
+        }
+        // Unwind to the frame being returned to, or one frame if the
+        // return address matches none
+        uint16_t target = cpu.getPC();
+        size_t depth = stack.size();
+        while (depth > 0 && stack[depth - 1].return_pc != target) {
+            depth--;
+        }
+        if (depth == 0) {
+            depth = stack.size();
+        }
+        current = stack[depth - 1].node;
+        stack.resize(depth - 1);
+    }
+}
+
+void CallProfile::finish(const CPU& cpu) {
+    if (started) {
+        charge(cpu.getCycleCount());
+    }
+}
+
+void CallProfile::charge(uint64_t cycle) {
+    uint64_t cost = cycle - last_cycle;
+    cycles[last_pc] += cost;
+    nodes[last_node].self += cost;
+    last_cycle = cycle;
+}
+
+uint32_t CallProfile::child(uint32_t parent, uint16_t entry) {
+    std::map<uint16_t, uint32_t>::const_iterator it = nodes[parent].children.find(entry);
+    if (it != nodes[parent].children.end()) {
+        return it->second;
+    }
+
+    Node node;
+    node.entry = entry;
+    node.parent = parent;
+    node.depth = nodes[parent].depth + 1;
+    node.calls = 0;
+    node.self = 0;
+    uint32_t index = nodes.size();
+    nodes.push_back(node);
+    nodes[parent].children[entry] = index;
+    return index;
+}
+
+uint64_t CallProfile::totalCycles() const {
+    uint64_t total = 0;
+    for (size_t i = 0; i < nodes.size(); i++) {
+        total += nodes[i].self;
+    }
+    return total;
+}
+
+void CallProfile::report(std::ostream& stream, const SymbolMap& symbols, size_t top) const {
+    uint64_t total = totalCycles();
+    std::ios::fmtflags saved = stream.flags();
+    stream << "\n=== Hot Spots ===" << std::endl;
+    stream << "Cycles: " << total << std::endl;
+    if (total == 0) {
+        stream.flags(saved);
+        return;
+    }
+
+    // Hottest instructions
+    std::vector<uint16_t> pcs;
+    for (int pc = 0; pc < 65536; pc++) {
+        if (executions[pc] > 0) {
+            pcs.push_back(pc);
+        }
+    }
+    std::stable_sort(pcs.begin(), pcs.end(), [this](uint16_t a, uint16_t b) {
+        return cycles[a] > cycles[b];
+    });
+    stream << "  PC      Location              Executions      Cycles" << std::endl;
+    for (size_t i = 0; i < pcs.size() && i < top; i++) {
+        uint16_t pc = pcs[i];
+        stream << "  0x" << std::hex << std::setw(4) << std::setfill('0') << pc << std::dec
+               << std::setfill(' ') << "  " << std::left << std::setw(20) << symbols.describe(pc)
+               << std::right << std::setw(12) << executions[pc] << std::setw(12) << cycles[pc]
+               << std::setw(8) << std::fixed << std::setprecision(2)
+               << (100.0 * cycles[pc] / total) << "%" << std::endl;
+    }
+
+    // Inclusive cycles per node (children always come after parents)
+    std::vector<uint64_t> inclusive(nodes.size());
+    for (size_t i = 0; i < nodes.size(); i++) {
+        inclusive[i] = nodes[i].self;
+    }
+    for (size_t i = nodes.size(); i-- > 1;) {
+        inclusive[nodes[i].parent] += inclusive[i];
+    }
+
+    // Per routine; a recursive routine's inclusive time counts only its
+    // outermost activation
+    struct Routine {
+        uint64_t calls;
+        uint64_t exclusive;
+        uint64_t inclusive;
+    };
+    std::map<uint16_t, Routine> routines;
+    for (size_t i = 0; i < nodes.size(); i++) {
+        const Node& node = nodes[i];
+        Routine& routine = routines[node.entry];
+        routine.calls += node.calls;
+        routine.exclusive += node.self;
+
+        bool outermost = true;
+        for (uint32_t up = i; up != 0;) {
+            up = nodes[up].parent;
+            if (nodes[up].entry == node.entry) {
+                outermost = false;
+                break;
+            }
+        }
+        if (outermost) {
+            routine.inclusive += inclusive[i];
+        }
+    }
+
+    std::vector<std::pair<uint16_t, Routine>> order(routines.begin(), routines.end());
+    std::stable_sort(order.begin(), order.end(),
+                     [](const std::pair<uint16_t, Routine>& a, const std::pair<uint16_t, Routine>& b) {
+                         return a.second.inclusive > b.second.inclusive;
+                     });
+    stream << "\n  Routine               Calls   Exclusive   Inclusive" << std::endl;
+    for (size_t i = 0; i < order.size(); i++) {
+        const Routine& routine = order[i].second;
+        stream << "  " << std::left << std::setw(20) << symbols.describe(order[i].first)
+               << std::right << std::setw(8) << routine.calls
+               << std::setw(12) << routine.exclusive << std::setw(12) << routine.inclusive
+               << std::setw(8) << std::fixed << std::setprecision(2)
+               << (100.0 * routine.inclusive / total) << "%" << std::endl;
+    }
+    stream.flags(saved);
+}
+
+void CallProfile::writeCollapsed(std::ostream& stream, const SymbolMap& symbols) const {
+    std::vector<std::string> names(nodes.size());
+    for (size_t i = 0; i < nodes.size(); i++) {
+        names[i] = symbols.describe(nodes[i].entry);
+        // Frame separators must not appear inside a frame name
+        std::replace(names[i].begin(), names[i].end(), ';', ':');
+        std::replace(names[i].begin(), names[i].end(), ' ', '_');
+    }
+
+    std::vector<std::string> paths(nodes.size());
+    for (size_t i = 0; i < nodes.size(); i++) {
+        paths[i] = i == 0 ? names[0] : paths[nodes[i].parent] + ";" + names[i];
+        if (nodes[i].self > 0) {
+            stream << paths[i] << " " << nodes[i].self << "\n";
+        }
+    }
+}
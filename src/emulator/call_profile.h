@@ -0,0 +1,86 @@
+#ifndef CALL_PROFILE_H
+#define CALL_PROFILE_H
+
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <vector>
+#include "decode_cache.h"
+#include "symbol_map.h"
+
+class CPU;
+
+/**
+ * CallProfile - Trace policy that attributes cycles to code and calls
+ *
+ * Counts executions and cycles per PC, and follows CALL/RET with a
+ * shadow call stack so cycles are also charged to the call path they
+ * were spent under. The paths form a call tree: a node per distinct
+ * chain of call targets from the entry point, holding the cycles spent
+ * directly in it. From the tree the profile derives exclusive and
+ * inclusive cycles per routine, and collapsed stacks ("a;b;c 1234" per
+ * line) for flamegraph.pl, speedscope and similar tools.
+ *
+ * An instruction's cost is the change in the cycle count between its
+ * fetch and the next one, so it follows whatever the CPU charges per
+ * instruction. A RET pops the shadow stack back to the frame whose
+ * return address it lands on, so code that discards frames does not
+ * leave the stack permanently deeper.
+ */
+class CallProfile {
+private:
+    // The 256-byte stack page holds at most 128 return addresses, so
+    // deeper frames cannot be returned to; calls past this depth are
+    // charged to the deepest node and the oldest frames are dropped
+    static const size_t MAX_DEPTH = 128;
+
+    struct Node {
+        uint16_t entry;         // Call target (the start address for the root)
+        uint32_t parent;
+        uint32_t depth;         // Calls from the root
+        uint64_t calls;
+        uint64_t self;          // Cycles spent in this node, not its callees
+        std::map<uint16_t, uint32_t> children;
+    };
+
+    struct Frame {
+        uint32_t node;          // Caller's node
+        uint16_t return_pc;
+    };
+
+    std::vector<uint64_t> executions;   // Per PC
+    std::vector<uint64_t> cycles;       // Per PC
+    std::vector<Node> nodes;            // nodes[0] is the root
+    std::vector<Frame> stack;
+    uint32_t current;                   // Node executing now
+    bool started;
+
+    // The instruction being charged
+    uint16_t last_pc;
+    uint32_t last_node;
+    uint64_t last_cycle;
+
+    void charge(uint64_t cycle);
+    uint32_t child(uint32_t parent, uint16_t entry);
+    uint64_t totalCycles() const;
+
+public:
+    static const bool enabled = true;
+
+    CallProfile();
+
+    void fetch(const CPU& cpu, const DecodedOp& op);
+    void execute(const CPU&, const DecodedOp&) {}
+    void retire(const CPU& cpu, const DecodedOp& op);
+
+    // Charge the last instruction; call once the run has stopped
+    void finish(const CPU& cpu);
+
+    // Hottest PCs and per-routine exclusive/inclusive cycles
+    void report(std::ostream& stream, const SymbolMap& symbols, size_t top = 15) const;
+
+    // One "root;caller;callee cycles" line per call path
+    void writeCollapsed(std::ostream& stream, const SymbolMap& symbols) const;
+};
+
+#endif // CALL_PROFILE_H
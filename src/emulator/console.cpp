@@ -0,0 +1,49 @@
+#include "console.h"
+
+Console::Console() : console_out(0), console_in(0) {
+}
+
+uint8_t Console::read(uint16_t address) {
+    switch (address) {
+        case IO_CONSOLE_IN:
+            console_in = input.get();
+            return console_in;
+        case IO_CONSOLE_STATUS:
+            return (input.ready() ? STATUS_INPUT_READY : 0) |
+                   (input.finished() ? STATUS_INPUT_END : 0);
+        default:  // CONSOLE_OUT is write-only
+            return 0;
+    }
+}
+
+void Console::write(uint16_t address, uint8_t value) {
+    if (address == IO_CONSOLE_OUT) {
+        console_out = value;
+        output.put(static_cast<char>(value));
+    }
+}
+
+void Console::save(SnapshotWriter& snapshot) const {
+    snapshot.beginSection("CONS");
+    snapshot.putU8(console_out);
+    snapshot.putU8(console_in);
+    snapshot.endSection();
+}
+
+bool Console::restore(SnapshotReader& snapshot) {
+    // Output already produced by this run stays in the sink
+    console_out = 0;
+    console_in = 0;
+    if (!snapshot.enterSection("CONS")) {
+        return true;
+    }
+    console_out = snapshot.getU8();
+    console_in = snapshot.getU8();
+    return snapshot.good();
+}
+
+void Console::reset() {
+    console_out = 0;
+    console_in = 0;
+    output.clear();
+}
@@ -0,0 +1,57 @@
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+#include <cstdint>
+#include "console_input.h"
+#include "console_sink.h"
+#include "device.h"
+
+/**
+ * Console class - Character I/O
+ * 
+ * Registers:
+ * 0xFF01 CONSOLE_OUT     Write a byte to the ConsoleSink (stdout by default)
+ * 0xFF02 CONSOLE_IN      Read the next input byte, 0 if none is ready
+ * 0xFF04 CONSOLE_STATUS  Bit 0: input ready, bit 1: end of input
+ * 
+ * Input comes from a ConsoleInput stream, so polling CONSOLE_STATUS
+ * never blocks the host.
+ * 
+ * Snapshots hold the register latches only. The input and output
+ * streams belong to the host and are configured again on restore.
+ */
+class Console : public Device {
+public:
+    // CONSOLE_STATUS bits
+    static const uint8_t STATUS_INPUT_READY = 0x01;
+    static const uint8_t STATUS_INPUT_END = 0x02;
+    
+private:
+    uint8_t console_out;
+    uint8_t console_in;
+    ConsoleSink output;
+    ConsoleInput input;
+    
+public:
+    Console();
+    
+    // Device interface
+    uint8_t read(uint16_t address);
+    void write(uint16_t address, uint8_t value);
+    void reset();
+    void sync() { output.sync(); }
+    bool isHostInput(uint16_t address) const {
+        return address == IO_CONSOLE_IN || address == IO_CONSOLE_STATUS;
+    }
+    bool isHostOutput(uint16_t address) const { return address == IO_CONSOLE_OUT; }
+    void save(SnapshotWriter& snapshot) const;
+    bool restore(SnapshotReader& snapshot);
+    
+    // Output sink configuration
+    ConsoleSink& getOutput() { return output; }
+    
+    // Input source configuration
+    ConsoleInput& getInput() { return input; }
+};
+
+#endif // CONSOLE_H
@@ -0,0 +1,120 @@
+#include "console_input.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <iostream>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+ConsoleInput::ConsoleInput()
+    : ring(RING_SIZE), head(0), tail(0), closed(false), stopping(false), fd(-1),
+      owns_fd(false), position(0), source(SOURCE_NONE) {
+}
+
+ConsoleInput::~ConsoleInput() {
+    close();
+}
+
+bool ConsoleInput::openStdin() {
+    close();
+    startReader(STDIN_FILENO, false);
+    return true;
+}
+
+bool ConsoleInput::openFile(const std::string& path) {
+    close();
+    int descriptor = ::open(path.c_str(), O_RDONLY);
+    if (descriptor < 0) {
+        std::cerr << "Error: Cannot open input file '" << path << "'" << std::endl;
+        return false;
+    }
+    startReader(descriptor, true);
+    return true;
+}
+
+void ConsoleInput::openBuffer(const std::string& data) {
+    close();
+    buffer = data;
+    position = 0;
+    source = SOURCE_BUFFER;
+}
+
+void ConsoleInput::close() {
+    if (reader.joinable()) {
+        stopping.store(true);
+        reader.join();
+    }
+    if (owns_fd) {
+        ::close(fd);
+    }
+    fd = -1;
+    owns_fd = false;
+    head.store(0);
+    tail.store(0);
+    closed.store(false);
+    stopping.store(false);
+
+    buffer.clear();
+    position = 0;
+    source = SOURCE_NONE;
+}
+
+uint8_t ConsoleInput::get() {
+    if (!ready()) {
+        return 0;
+    }
+    if (source == SOURCE_BUFFER) {
+        return static_cast<uint8_t>(buffer[position++]);
+    }
+
+    size_t t = tail.load(std::memory_order_relaxed);
+    uint8_t value = ring[t & (RING_SIZE - 1)];
+    tail.store(t + 1, std::memory_order_release);
+    return value;
+}
+
+void ConsoleInput::startReader(int descriptor, bool owned) {
+    fd = descriptor;
+    owns_fd = owned;
+    source = SOURCE_STREAM;
+    reader = std::thread(&ConsoleInput::readerLoop, this);
+}
+
+void ConsoleInput::readerLoop() {
+    while (!stopping.load(std::memory_order_relaxed)) {
+        size_t h = head.load(std::memory_order_relaxed);
+        size_t space = RING_SIZE - (h - tail.load(std::memory_order_acquire));
+        if (space == 0) {
+            // Guest is not consuming; check again shortly
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+
+        // Wait with a timeout so close() never hangs on an idle terminal
+        struct pollfd request;
+        request.fd = fd;
+        request.events = POLLIN;
+        request.revents = 0;
+        int status = poll(&request, 1, 50);
+        if (status == 0 || (status < 0 && errno == EINTR)) {
+            continue;
+        }
+        if (status < 0) {
+            break;
+        }
+
+        // Fill as much of the ring as one read allows
+        size_t offset = h & (RING_SIZE - 1);
+        size_t chunk = std::min(space, RING_SIZE - offset);
+        ssize_t count = ::read(fd, &ring[offset], chunk);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            break;
+        }
+        head.store(h + count, std::memory_order_release);
+    }
+    closed.store(true, std::memory_order_release);
+}
@@ -0,0 +1,89 @@
+#ifndef CONSOLE_INPUT_H
+#define CONSOLE_INPUT_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * ConsoleInput class - Input stream behind CONSOLE_IN
+ *
+ * Input comes from one of:
+ * - a host file descriptor (stdin or a file): a reader thread fills a
+ *   single-producer/single-consumer ring buffer, reading as much as
+ *   fits with each host read
+ * - an in-memory buffer supplied through openBuffer()
+ *
+ * The guest side never blocks: ready() says whether a byte can be
+ * taken now and finished() whether the input has ended for good.
+ * With no source open the input is finished.
+ */
+class ConsoleInput {
+private:
+    static const size_t RING_SIZE = 1 << 16;   // Power of two
+
+    // Stream source (reader thread owns head, guest side owns tail)
+    std::vector<uint8_t> ring;
+    std::atomic<size_t> head;
+    std::atomic<size_t> tail;
+    std::atomic<bool> closed;       // Reader hit end of input or an error
+    std::atomic<bool> stopping;
+    std::thread reader;
+    int fd;
+    bool owns_fd;
+
+    // Buffer source
+    std::string buffer;
+    size_t position;
+
+    enum Source { SOURCE_NONE, SOURCE_BUFFER, SOURCE_STREAM };
+    Source source;
+
+    void readerLoop();
+    void startReader(int descriptor, bool owned);
+
+    ConsoleInput(const ConsoleInput&);
+    ConsoleInput& operator=(const ConsoleInput&);
+
+public:
+    ConsoleInput();
+    ~ConsoleInput();
+
+    // Select the input source (replaces any previous one)
+    bool openStdin();
+    bool openFile(const std::string& path);
+    void openBuffer(const std::string& data);
+    void close();
+
+    // A byte can be read now
+    bool ready() const {
+        switch (source) {
+            case SOURCE_BUFFER:
+                return position < buffer.size();
+            case SOURCE_STREAM:
+                return head.load(std::memory_order_acquire) != tail.load(std::memory_order_relaxed);
+            default:
+                return false;
+        }
+    }
+
+    // No byte is available and none will arrive
+    bool finished() const {
+        switch (source) {
+            case SOURCE_BUFFER:
+                return position >= buffer.size();
+            case SOURCE_STREAM:
+                return closed.load(std::memory_order_acquire) && !ready();
+            default:
+                return true;
+        }
+    }
+
+    // Take the next byte, or 0 if none is ready
+    uint8_t get();
+};
+
+#endif // CONSOLE_INPUT_H
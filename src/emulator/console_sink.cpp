@@ -0,0 +1,145 @@
+#include "console_sink.h"
+#include <algorithm>
+#include <iostream>
+
+ConsoleSink::ConsoleSink()
+    : ring(RING_SIZE), head(0), tail(0), signalled(0), target(ConsoleTarget::Stdout),
+      policy(FlushPolicy::Immediate), flush_size(4096), file(nullptr),
+      wake_requested(false), stopping(false) {
+}
+
+ConsoleSink::~ConsoleSink() {
+    close();
+}
+
+bool ConsoleSink::open(ConsoleTarget output, FlushPolicy flush, const std::string& path,
+                       size_t size) {
+    close();
+
+    if (output == ConsoleTarget::File) {
+        file = std::fopen(path.c_str(), "wb");
+        if (!file) {
+            std::cerr << "Error: Cannot open console output file '" << path << "'" << std::endl;
+            return false;
+        }
+    }
+
+    target = output;
+    policy = flush;
+    flush_size = std::max<size_t>(size, 1);
+
+    if (policy != FlushPolicy::Immediate) {
+        wake_requested = false;
+        stopping = false;
+        writer = std::thread(&ConsoleSink::writerLoop, this);
+    }
+    return true;
+}
+
+void ConsoleSink::close() {
+    if (writer.joinable()) {
+        sync();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake_cv.notify_one();
+        writer.join();
+    }
+
+    if (file) {
+        std::fclose(file);
+        file = nullptr;
+    }
+    target = ConsoleTarget::Stdout;
+    policy = FlushPolicy::Immediate;
+}
+
+void ConsoleSink::sync() {
+    if (!writer.joinable()) {
+        return;  // Immediate mode keeps nothing buffered
+    }
+
+    wake();
+    while (tail.load(std::memory_order_acquire) != head.load(std::memory_order_relaxed)) {
+        std::this_thread::yield();
+    }
+}
+
+void ConsoleSink::clear() {
+    sync();
+    capture.clear();
+}
+
+void ConsoleSink::putSlow(char c) {
+    if (policy == FlushPolicy::Immediate) {
+        writeTarget(&c, 1);
+        return;
+    }
+
+    // Ring is full: let the writer catch up
+    wake();
+    while (head.load(std::memory_order_relaxed) - tail.load(std::memory_order_acquire) == RING_SIZE) {
+        std::this_thread::yield();
+    }
+    put(c);
+}
+
+void ConsoleSink::wake() {
+    signalled = head.load(std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        wake_requested = true;
+    }
+    wake_cv.notify_one();
+}
+
+void ConsoleSink::writerLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake_cv.wait(lock, [this] { return wake_requested || stopping; });
+        bool stop = stopping;
+        wake_requested = false;
+
+        lock.unlock();
+        drain();
+        lock.lock();
+
+        if (stop) {
+            return;
+        }
+    }
+}
+
+void ConsoleSink::drain() {
+    size_t t = tail.load(std::memory_order_relaxed);
+    size_t h = head.load(std::memory_order_acquire);
+    if (t == h) {
+        return;
+    }
+
+    // Write the pending bytes in at most two contiguous chunks
+    while (t != h) {
+        size_t offset = t & (RING_SIZE - 1);
+        size_t chunk = std::min(h - t, RING_SIZE - offset);
+        writeTarget(&ring[offset], chunk);
+        t += chunk;
+    }
+    tail.store(t, std::memory_order_release);
+}
+
+void ConsoleSink::writeTarget(const char* data, size_t count) {
+    switch (target) {
+        case ConsoleTarget::Stdout:
+            std::fwrite(data, 1, count, stdout);
+            std::fflush(stdout);
+            break;
+        case ConsoleTarget::File:
+            std::fwrite(data, 1, count, file);
+            std::fflush(file);
+            break;
+        case ConsoleTarget::Capture:
+            capture.append(data, count);
+            break;
+    }
+}
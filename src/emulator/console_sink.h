@@ -0,0 +1,121 @@
+#ifndef CONSOLE_SINK_H
+#define CONSOLE_SINK_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * When buffered console output is handed to the target
+ * - Immediate: Write and flush every byte synchronously (no thread)
+ * - Newline:   Wake the writer at each '\n'
+ * - Size:      Wake the writer once flush_size bytes are pending
+ * - Halt:      Only write when the buffer fills or the CPU stops
+ */
+enum class FlushPolicy {
+    Immediate,
+    Newline,
+    Size,
+    Halt
+};
+
+/**
+ * Where console output goes
+ */
+enum class ConsoleTarget {
+    Stdout,
+    File,
+    Capture      // Kept in memory, read back with getCapture()
+};
+
+/**
+ * ConsoleSink class - Buffered, asynchronous console output
+ *
+ * The emulator thread appends bytes to a single-producer/single-consumer
+ * ring buffer without locking; a background writer thread drains it to
+ * the target. The flush policy only decides when the writer is woken,
+ * so the emulator never waits on terminal or file I/O unless the ring
+ * is full.
+ *
+ * sync() hands everything buffered so far to the target and waits for
+ * it, which keeps guest output ordered before the emulator's own
+ * messages. Until open() is called the sink writes straight to stdout
+ * with the Immediate policy.
+ */
+class ConsoleSink {
+private:
+    static const size_t RING_SIZE = 1 << 16;   // Power of two
+
+    // Ring buffer (producer owns head, writer owns tail)
+    std::vector<char> ring;
+    std::atomic<size_t> head;
+    std::atomic<size_t> tail;
+    size_t signalled;          // head at the last wake-up (producer only)
+
+    // Configuration
+    ConsoleTarget target;
+    FlushPolicy policy;
+    size_t flush_size;
+    FILE* file;
+    std::string capture;
+
+    // Writer thread
+    std::thread writer;
+    std::mutex mutex;
+    std::condition_variable wake_cv;
+    bool wake_requested;
+    bool stopping;
+
+    void writerLoop();
+    void drain();
+    void writeTarget(const char* data, size_t count);
+    void wake();
+    void putSlow(char c);
+    void close();
+
+    ConsoleSink(const ConsoleSink&);
+    ConsoleSink& operator=(const ConsoleSink&);
+
+public:
+    ConsoleSink();
+    ~ConsoleSink();
+
+    // Select target and policy; starts the writer thread unless the
+    // policy is Immediate. Returns false if the file cannot be opened.
+    bool open(ConsoleTarget output, FlushPolicy flush, const std::string& path = "",
+              size_t size = 4096);
+
+    // Append one byte of guest output
+    void put(char c) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (policy == FlushPolicy::Immediate ||
+            h - tail.load(std::memory_order_acquire) == RING_SIZE) {
+            putSlow(c);
+            return;
+        }
+        ring[h & (RING_SIZE - 1)] = c;
+        head.store(h + 1, std::memory_order_release);
+
+        if ((policy == FlushPolicy::Newline && c == '\n') ||
+            (policy == FlushPolicy::Size && h + 1 - signalled >= flush_size)) {
+            wake();
+        }
+    }
+
+    // Write out everything buffered so far and wait until it is done
+    void sync();
+
+    // Drop buffered output and captured text
+    void clear();
+
+    // Captured output (Capture target; call sync() first)
+    const std::string& getCapture() const { return capture; }
+};
+
+#endif // CONSOLE_SINK_H
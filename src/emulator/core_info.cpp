@@ -0,0 +1,3 @@
+#include "core_info.h"
+
+thread_local uint8_t CoreInfo::current = 0;
@@ -0,0 +1,34 @@
+#ifndef CORE_INFO_H
+#define CORE_INFO_H
+
+#include <cstdint>
+#include "device.h"
+
+/**
+ * CoreInfo class - Which core is running (CORE_ID 0xFF08, CORE_COUNT 0xFF09)
+ * 
+ * CORE_ID reads as the number of the core making the access and
+ * CORE_COUNT as the number of cores sharing the memory. Both are
+ * read-only; writes are ignored. Each core's host thread announces
+ * itself with setCurrentCore(), so a single-core run reads 0 and 1.
+ */
+class CoreInfo : public Device {
+private:
+    uint8_t count;
+    static thread_local uint8_t current;
+    
+public:
+    CoreInfo() : count(1) {}
+    
+    void setCoreCount(uint8_t cores) { count = cores; }
+    uint8_t getCoreCount() const { return count; }
+    
+    // The core that runs on the calling thread
+    static void setCurrentCore(uint8_t core) { current = core; }
+    
+    // Device interface
+    uint8_t read(uint16_t address) { return address == IO_CORE_ID ? current : count; }
+    void write(uint16_t, uint8_t) {}
+};
+
+#endif // CORE_INFO_H
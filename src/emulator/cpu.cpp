@@ -1,12 +1,55 @@
 #include "cpu.h"
+#include "cache.h"
+#include "call_profile.h"
+#include "jit.h"
+#include "pipeline_model.h"
+#include "timing_model.h"
+#include "trace.h"
+#include <algorithm>
 #include <iostream>
 #include <iomanip>
 #include <sstream>
 
-CPU::CPU(Memory* mem) : memory(mem), halted(false), cycle_count(0), debug_mode(false) {
+namespace {
+
+// Event queue for cores other than 0: nothing is ever scheduled on it
+Scheduler idle_events;
+
+} // namespace
+
+CPU::CPU(Memory* mem, ExecutionEngine eng, uint8_t core) 
+    : memory(mem), scheduler(core == 0 ? &mem->getScheduler() : &idle_events),
+      interrupts(core == 0 ? &mem->getInterrupts() : nullptr), decode_cache(mem),
+      core_id(core), halted(false), wait_stopped(false), cycle_count(0), cycle_limit(MAX_CYCLES), debug_mode(false),
+      lazy_flags(false), engine(eng), jit(nullptr), timing(nullptr), caches(nullptr) {
+    // Device timing runs off core 0's cycle count
+    if (core_id == 0) {
+        scheduler->setClock(&cycle_count);
+    }
+    
+    if (engine == ExecutionEngine::Jit) {
+        if (Jit::isSupported()) {
+            jit = new Jit(this, mem);
+            if (!jit->isReady()) {
+                delete jit;
+                jit = nullptr;
+            }
+        }
+        if (!jit) {
+            std::cerr << "Warning: JIT unavailable, using threaded engine" << std::endl;
+            engine = ExecutionEngine::Threaded;
+        }
+    }
     reset();
 }
 
+CPU::~CPU() {
+    if (core_id == 0) {
+        scheduler->setClock(nullptr);
+    }
+    delete jit;
+}
+
 void CPU::reset() {
     // Initialize all registers to 0
     for (int i = 0; i < 8; i++) {
@@ -17,96 +60,241 @@ void CPU::reset() {
     pc = 0x0100;
     
     // Initialize SP (R7) to top of stack (just below I/O area)
-    registers[7] = 0xFF;  // High byte of 0xFEFF
+    registers[7] = 0xFF;  // Low byte of 0xFEFF
     
     // Clear flags
     flags = 0;
+    pending_flags.op = FLAGOP_NONE;
     
     // Reset state
     halted = false;
+    wait_stopped = false;
     cycle_count = 0;
+}
+
+bool CPU::saveSnapshot(const std::string& path) {
+    SnapshotWriter snapshot;
+    saveState(snapshot);
+    memory->saveState(snapshot);
+    return snapshot.writeFile(path, memory->getRawMemory());
+}
+
+bool CPU::loadSnapshot(const std::string& path) {
+    SnapshotReader snapshot;
+    if (!snapshot.open(path)) {
+        return false;
+    }
+    if (!restoreState(snapshot)) {
+        std::cerr << "Error: Snapshot '" << path << "' has missing or corrupt CPU state" << std::endl;
+        return false;
+    }
+    return memory->restoreState(snapshot);
+}
+
+void CPU::saveState(SnapshotWriter& snapshot) {
+    resolvePendingFlags();
     
-    // Reset bus
-    bus.reset();
+    snapshot.beginSection("CPU ");
+    snapshot.putU16(pc);
+    for (int i = 0; i < 8; i++) {
+        snapshot.putU8(registers[i]);
+    }
+    snapshot.putU8(flags);
+    snapshot.putU8(halted);
+    snapshot.putU64(cycle_count);
+    snapshot.endSection();
+}
+
+bool CPU::restoreState(SnapshotReader& snapshot) {
+    if (!snapshot.enterSection("CPU ")) {
+        return false;
+    }
+    uint16_t saved_pc = snapshot.getU16();
+    uint8_t saved_registers[8];
+    for (int i = 0; i < 8; i++) {
+        saved_registers[i] = snapshot.getU8();
+    }
+    uint8_t saved_flags = snapshot.getU8();
+    bool saved_halted = snapshot.getU8() != 0;
+    uint64_t saved_cycles = snapshot.getU64();
+    if (!snapshot.good()) {
+        return false;
+    }
     
-    // Clear instruction register
-    ir[0] = ir[1] = ir[2] = 0;
+    // Devices schedule against the restored cycle count
+    pc = saved_pc;
+    for (int i = 0; i < 8; i++) {
+        registers[i] = saved_registers[i];
+    }
+    flags = saved_flags;
+    pending_flags.op = FLAGOP_NONE;
+    halted = saved_halted;
+    wait_stopped = false;
+    cycle_count = saved_cycles;
+    return true;
 }
 
 void CPU::step() {
+    if (debug_mode) {
+        TextTrace trace;
+        step(trace);
+    } else {
+        NoTrace trace;
+        step(trace);
+    }
+}
+
+void CPU::run() {
+    if (debug_mode) {
+        TextTrace trace;
+        run(trace);
+    } else {
+        NoTrace trace;
+        run(trace);
+    }
+}
+
+bool CPU::runUntilHalt() {
+    if (debug_mode) {
+        TextTrace trace;
+        return runUntilHalt(trace);
+    }
+    NoTrace trace;
+    return runUntilHalt(trace);
+}
+
+template <class Trace>
+void CPU::step(Trace& trace) {
     if (halted) {
         return;
     }
     
-    // FETCH phase
-    fetch();
+    // The threaded and JIT engines have no trace hooks or timing model
+    if (!Trace::enabled && !isTimed() && engine != ExecutionEngine::Switch) {
+        runThreaded(1);
+        return;
+    }
     
-    // DECODE and EXECUTE phase
-    execute();
+    if (isTimed()) {
+        stepSwitch<Trace, true>(trace);
+    } else {
+        stepSwitch<Trace, false>(trace);
+    }
+}
+
+template <class Trace, bool Timed>
+void CPU::stepSwitch(Trace& trace) {
+    // FETCH and DECODE phase (served from the decode cache)
+    const DecodedOp& op = fetch();
+    trace.fetch(*this, op);
     
-    // Update timer
-    memory->updateTimer();
+    // EXECUTE phase
+    uint16_t fetch_pc = pc;
+    uint8_t sp = registers[7];
+    uint16_t address = Timed ? dataAddress(op) : 0;
+    trace.execute(*this, op);
+    execute(op);
+    trace.retire(*this, op);
     
-    cycle_count++;
+    // One cycle per instruction unless a timing model is installed
+    if (Timed) {
+        bool branched = pc != static_cast<uint16_t>(fetch_pc + op.length);
+        cycle_count += timing ? timing->cost(op, branched, address) : 1;
+        if (caches) {
+            cycle_count += caches->instruction(op, fetch_pc, sp, address);
+        }
+    } else {
+        cycle_count++;
+    }
+    
+    // Fire device events that have come due
+    serviceEvents();
 }
 
-void CPU::run() {
+template <class Trace>
+void CPU::run(Trace& trace) {
     std::cout << "Starting CPU execution at PC=0x" << std::hex << pc << std::dec << std::endl;
     
-    while (!halted) {
-        step();
-        
-        // Safety check: halt if PC goes out of bounds or too many cycles
-        if (pc >= 0xFF00 || cycle_count > 1000000) {
-            std::cerr << "Error: CPU runaway detected (PC=0x" << std::hex << pc 
-                      << ", cycles=" << std::dec << cycle_count << ")" << std::endl;
-            halted = true;
-            break;
-        }
+    if (!runUntilHalt(trace)) {
+        std::cerr << "Error: CPU runaway detected (PC=0x" << std::hex << pc 
+                  << ", cycles=" << std::dec << cycle_count << ")" << std::endl;
     }
     
+    // Buffered device output comes before the summary
+    memory->sync();
+    
     std::cout << "\nCPU halted after " << cycle_count << " cycles" << std::endl;
 }
 
-void CPU::fetch() {
-    // Read instruction from memory
-    ir[0] = memory->read(pc);
-    
-    if (debug_mode) {
-        std::cout << "\n[FETCH] PC=0x" << std::hex << std::setw(4) 
-                  << std::setfill('0') << pc << " IR[0]=0x" 
-                  << std::setw(2) << static_cast<int>(ir[0]) << std::dec << std::endl;
+template <class Trace>
+bool CPU::runUntilHalt(Trace& trace) {
+    while (!halted) {
+        if (!Trace::enabled && !isTimed() && engine == ExecutionEngine::Jit) {
+            // Returns on HALT or when the runaway check below must fire
+            jit->run();
+        } else if (!Trace::enabled && !isTimed() && engine == ExecutionEngine::Threaded) {
+            runThreaded(cycle_limit + 1);
+        } else if (isTimed()) {
+            stepSwitch<Trace, true>(trace);
+        } else {
+            stepSwitch<Trace, false>(trace);
+        }
+        
+        // Safety check: halt if PC goes out of bounds; stop (resumably)
+        // once the cycle limit is passed
+        if (pc >= 0xFF00) {
+            halted = true;
+            return false;
+        }
+        if (cycle_count > cycle_limit) {
+            return false;
+        }
     }
+    return true;
 }
 
-uint8_t CPU::fetchByte() {
-    uint8_t byte = memory->read(pc);
-    pc++;
-    return byte;
-}
+// Every trace policy the emulator can run with
+template void CPU::step<NoTrace>(NoTrace& trace);
+template void CPU::step<TextTrace>(TextTrace& trace);
+template void CPU::step<StructuredTrace>(StructuredTrace& trace);
+template void CPU::step<ProfileTrace>(ProfileTrace& trace);
+template void CPU::step<BinaryTrace>(BinaryTrace& trace);
+template void CPU::step<CallProfile>(CallProfile& trace);
+template void CPU::step<StatsTrace>(StatsTrace& trace);
+template void CPU::step<PipelineModel>(PipelineModel& trace);
+template void CPU::run<NoTrace>(NoTrace& trace);
+template void CPU::run<TextTrace>(TextTrace& trace);
+template void CPU::run<StructuredTrace>(StructuredTrace& trace);
+template void CPU::run<ProfileTrace>(ProfileTrace& trace);
+template void CPU::run<BinaryTrace>(BinaryTrace& trace);
+template void CPU::run<CallProfile>(CallProfile& trace);
+template void CPU::run<StatsTrace>(StatsTrace& trace);
+template void CPU::run<PipelineModel>(PipelineModel& trace);
+template bool CPU::runUntilHalt<NoTrace>(NoTrace& trace);
+template bool CPU::runUntilHalt<TextTrace>(TextTrace& trace);
+template bool CPU::runUntilHalt<StructuredTrace>(StructuredTrace& trace);
+template bool CPU::runUntilHalt<ProfileTrace>(ProfileTrace& trace);
+template bool CPU::runUntilHalt<BinaryTrace>(BinaryTrace& trace);
+template bool CPU::runUntilHalt<CallProfile>(CallProfile& trace);
+template bool CPU::runUntilHalt<StatsTrace>(StatsTrace& trace);
+template bool CPU::runUntilHalt<PipelineModel>(PipelineModel& trace);
 
-uint16_t CPU::fetchWord() {
-    uint8_t low = fetchByte();
-    uint8_t high = fetchByte();
-    return low | (high << 8);
+const DecodedOp& CPU::fetch() {
+    // Look up the predecoded instruction (decoded on first visit)
+    return decode_cache.lookup(pc);
 }
 
-void CPU::execute() {
-    uint8_t opcode = getOpcode();
+void CPU::execute(const DecodedOp& op) {
+    uint8_t opcode = op.opcode;
     
-    if (debug_mode) {
-        std::cout << "[EXECUTE] Opcode=0x" << std::hex << static_cast<int>(opcode) 
-                  << std::dec << " ";
-    }
-    
-    // Increment PC past the first byte
-    pc++;
+    // Advance PC past the whole instruction
+    pc += op.length;
     
     // Execute based on opcode
     switch (opcode) {
         // Arithmetic
         case 0x00: // ADD
-            executeArithmetic();
+            executeArithmetic(op);
             break;
         case 0x01: // ADDI
         case 0x02: // SUB
@@ -114,7 +302,7 @@ void CPU::execute() {
         case 0x04: // MUL
         case 0x05: // INC
         case 0x06: // DEC
-            executeArithmetic();
+            executeArithmetic(op);
             break;
             
         // Logical
@@ -126,26 +314,34 @@ void CPU::execute() {
         case 0x0C: // NOT
         case 0x0D: // SHL
         case 0x0E: // SHR
-            executeLogical();
+            executeLogical(op);
             break;
             
         // Memory
+        case 0x0F: // LOAD/STORE Rd, [Rp+offset]
+            if (op.handler == HANDLER_INVALID) {
+                reportInvalid(op);
+                break;
+            }
+            executeMemory(op);
+            break;
         case 0x10: // LOAD
         case 0x11: // STORE
         case 0x12: // LOADI
-            executeMemory();
+        case 0x17: // CAS
+            executeMemory(op);
             break;
             
         // Comparison
         case 0x13: // CMP
         case 0x14: // CMPI
-            executeArithmetic();  // CMP uses ALU
+            executeArithmetic(op);  // CMP uses ALU
             break;
             
         // Stack
         case 0x15: // PUSH
         case 0x16: // POP
-            executeStack();
+            executeStack(op);
             break;
             
         // Control flow
@@ -156,277 +352,231 @@ void CPU::execute() {
         case 0x1C: // JNC
         case 0x1D: // CALL
         case 0x1E: // RET
-            executeControl();
+            executeControl(op);
             break;
             
         // Special
-        case 0x1F: // HALT or NOP
-            executeSpecial();
+        case 0x1F: // HALT, NOP, RETI or WAIT
+            executeSpecial(op);
             break;
             
         default:
-            std::cerr << "Error: Unknown opcode 0x" << std::hex << static_cast<int>(opcode) 
-                      << " at PC=0x" << (pc - 1) << std::dec << std::endl;
-            halted = true;
+            reportInvalid(op);
             break;
     }
-    
-    if (debug_mode) {
-        printState();
-    }
 }
 
-void CPU::executeArithmetic() {
-    uint8_t opcode = getOpcode();
-    uint8_t rd = getRd();
+void CPU::reportInvalid(const DecodedOp& op) {
+    std::cerr << "Error: Unknown opcode 0x" << std::hex << static_cast<int>(op.opcode) 
+              << " at PC=0x" << static_cast<uint16_t>(pc - op.length) << std::dec << std::endl;
+    halted = true;
+}
+
+void CPU::executeArithmetic(const DecodedOp& op) {
+    uint8_t opcode = op.opcode;
+    uint8_t rd = op.rd;
     
     switch (opcode) {
         case 0x00: { // ADD Rd, Rs1, Rs2
-            ir[1] = fetchByte();
-            uint8_t rs1 = getRs1();
-            uint8_t rs2 = getRs2();
-            if (debug_mode) std::cout << "ADD R" << static_cast<int>(rd) 
-                                      << ", R" << static_cast<int>(rs1) 
-                                      << ", R" << static_cast<int>(rs2) << std::endl;
+            uint8_t rs1 = op.rs1;
+            uint8_t rs2 = op.rs2;
             registers[rd] = alu.add(registers[rs1], registers[rs2], flags);
             break;
         }
         case 0x01: { // ADDI Rd, Rs, imm
-            ir[1] = fetchByte();
-            uint8_t rs = getRd();  // Source is in same position as Rd for immediate
-            uint8_t imm = getImmediate();
-            if (debug_mode) std::cout << "ADDI R" << static_cast<int>(rd) 
-                                      << ", R" << static_cast<int>(rs) 
-                                      << ", " << static_cast<int>(imm) << std::endl;
-            // Note: For RI format, we need to reinterpret the instruction
-            // Actually rd is destination, and we need another byte for source+immediate
-            // Let me fix the implementation to match ISA properly
-            ir[1] = memory->read(pc++);
-            registers[rd] = alu.add(registers[rd], imm, flags);
+            uint8_t rs = op.rd;  // Source is in same position as Rd for immediate
+            uint8_t imm = op.imm;
+            registers[rd] = alu.add(registers[rs], imm, flags);
             break;
         }
         case 0x02: { // SUB Rd, Rs1, Rs2
-            ir[1] = fetchByte();
-            uint8_t rs1 = getRs1();
-            uint8_t rs2 = getRs2();
-            if (debug_mode) std::cout << "SUB R" << static_cast<int>(rd) 
-                                      << ", R" << static_cast<int>(rs1) 
-                                      << ", R" << static_cast<int>(rs2) << std::endl;
+            uint8_t rs1 = op.rs1;
+            uint8_t rs2 = op.rs2;
             registers[rd] = alu.subtract(registers[rs1], registers[rs2], flags);
             break;
         }
         case 0x03: { // SUBI Rd, Rs, imm
-            ir[1] = fetchByte();
-            uint8_t imm = getImmediate();
-            if (debug_mode) std::cout << "SUBI R" << static_cast<int>(rd) 
-                                      << ", " << static_cast<int>(imm) << std::endl;
+            uint8_t imm = op.imm;
             registers[rd] = alu.subtract(registers[rd], imm, flags);
             break;
         }
-        case 0x04: { // MUL Rd, Rs1, Rs2
-            ir[1] = fetchByte();
-            uint8_t rs1 = getRs1();
-            uint8_t rs2 = getRs2();
-            if (debug_mode) std::cout << "MUL R" << static_cast<int>(rd) 
-                                      << ", R" << static_cast<int>(rs1) 
-                                      << ", R" << static_cast<int>(rs2) << std::endl;
-            registers[rd] = alu.multiply(registers[rs1], registers[rs2], flags);
+        case 0x04: { // MUL, MULH, DIV, MOD Rd, Rs1, Rs2
+            uint8_t a = registers[op.rs1];
+            uint8_t b = registers[op.rs2];
+            switch (op.handler) {
+                case HANDLER_MULH:
+                    registers[rd] = alu.multiplyHigh(a, b, flags);
+                    break;
+                case HANDLER_DIV:
+                    registers[rd] = alu.divide(a, b, flags);
+                    break;
+                case HANDLER_MOD:
+                    registers[rd] = alu.modulo(a, b, flags);
+                    break;
+                default:
+                    registers[rd] = alu.multiply(a, b, flags);
+                    break;
+            }
             break;
         }
         case 0x05: // INC Rd
-            if (debug_mode) std::cout << "INC R" << static_cast<int>(rd) << std::endl;
             registers[rd] = alu.increment(registers[rd], flags);
             break;
         case 0x06: // DEC Rd
-            if (debug_mode) std::cout << "DEC R" << static_cast<int>(rd) << std::endl;
             registers[rd] = alu.decrement(registers[rd], flags);
             break;
         case 0x13: { // CMP Rs1, Rs2
-            ir[1] = fetchByte();
-            uint8_t rs1 = getRd();  // First operand in Rd position
-            uint8_t rs2 = getRs1(); // Second operand in Rs1 position
-            if (debug_mode) std::cout << "CMP R" << static_cast<int>(rs1) 
-                                      << ", R" << static_cast<int>(rs2) << std::endl;
+            uint8_t rs1 = op.rd;  // First operand in Rd position
+            uint8_t rs2 = op.rs1; // Second operand in Rs1 position
             alu.compare(registers[rs1], registers[rs2], flags);
             break;
         }
         case 0x14: { // CMPI Rs, imm
-            ir[1] = fetchByte();
-            uint8_t rs = getRd();
-            uint8_t imm = getImmediate();
-            if (debug_mode) std::cout << "CMPI R" << static_cast<int>(rs) 
-                                      << ", " << static_cast<int>(imm) << std::endl;
+            uint8_t rs = op.rd;
+            uint8_t imm = op.imm;
             alu.compare(registers[rs], imm, flags);
             break;
         }
     }
 }
 
-void CPU::executeLogical() {
-    uint8_t opcode = getOpcode();
-    uint8_t rd = getRd();
+void CPU::executeLogical(const DecodedOp& op) {
+    uint8_t opcode = op.opcode;
+    uint8_t rd = op.rd;
     
     switch (opcode) {
         case 0x07: { // AND Rd, Rs1, Rs2
-            ir[1] = fetchByte();
-            uint8_t rs1 = getRs1();
-            uint8_t rs2 = getRs2();
-            if (debug_mode) std::cout << "AND R" << static_cast<int>(rd) 
-                                      << ", R" << static_cast<int>(rs1) 
-                                      << ", R" << static_cast<int>(rs2) << std::endl;
+            uint8_t rs1 = op.rs1;
+            uint8_t rs2 = op.rs2;
             registers[rd] = alu.logicalAnd(registers[rs1], registers[rs2], flags);
             break;
         }
         case 0x08: { // ANDI Rd, Rs, imm
-            ir[1] = fetchByte();
-            uint8_t imm = getImmediate();
-            if (debug_mode) std::cout << "ANDI R" << static_cast<int>(rd) 
-                                      << ", " << static_cast<int>(imm) << std::endl;
+            uint8_t imm = op.imm;
             registers[rd] = alu.logicalAnd(registers[rd], imm, flags);
             break;
         }
         case 0x09: { // OR Rd, Rs1, Rs2
-            ir[1] = fetchByte();
-            uint8_t rs1 = getRs1();
-            uint8_t rs2 = getRs2();
-            if (debug_mode) std::cout << "OR R" << static_cast<int>(rd) 
-                                      << ", R" << static_cast<int>(rs1) 
-                                      << ", R" << static_cast<int>(rs2) << std::endl;
+            uint8_t rs1 = op.rs1;
+            uint8_t rs2 = op.rs2;
             registers[rd] = alu.logicalOr(registers[rs1], registers[rs2], flags);
             break;
         }
         case 0x0A: { // ORI Rd, Rs, imm
-            ir[1] = fetchByte();
-            uint8_t imm = getImmediate();
-            if (debug_mode) std::cout << "ORI R" << static_cast<int>(rd) 
-                                      << ", " << static_cast<int>(imm) << std::endl;
+            uint8_t imm = op.imm;
             registers[rd] = alu.logicalOr(registers[rd], imm, flags);
             break;
         }
         case 0x0B: { // XOR Rd, Rs1, Rs2
-            ir[1] = fetchByte();
-            uint8_t rs1 = getRs1();
-            uint8_t rs2 = getRs2();
-            if (debug_mode) std::cout << "XOR R" << static_cast<int>(rd) 
-                                      << ", R" << static_cast<int>(rs1) 
-                                      << ", R" << static_cast<int>(rs2) << std::endl;
+            uint8_t rs1 = op.rs1;
+            uint8_t rs2 = op.rs2;
             registers[rd] = alu.logicalXor(registers[rs1], registers[rs2], flags);
             break;
         }
         case 0x0C: { // NOT Rd, Rs
-            ir[1] = fetchByte();
-            uint8_t rs = getRs1();
-            if (debug_mode) std::cout << "NOT R" << static_cast<int>(rd) 
-                                      << ", R" << static_cast<int>(rs) << std::endl;
+            uint8_t rs = op.rs1;
             registers[rd] = alu.logicalNot(registers[rs], flags);
             break;
         }
         case 0x0D: { // SHL Rd, Rs
-            ir[1] = fetchByte();
-            uint8_t rs = getRs1();
-            if (debug_mode) std::cout << "SHL R" << static_cast<int>(rd) 
-                                      << ", R" << static_cast<int>(rs) << std::endl;
+            uint8_t rs = op.rs1;
             registers[rd] = alu.shiftLeft(registers[rd], registers[rs], flags);
             break;
         }
         case 0x0E: { // SHR Rd, Rs
-            ir[1] = fetchByte();
-            uint8_t rs = getRs1();
-            if (debug_mode) std::cout << "SHR R" << static_cast<int>(rd) 
-                                      << ", R" << static_cast<int>(rs) << std::endl;
+            uint8_t rs = op.rs1;
             registers[rd] = alu.shiftRight(registers[rd], registers[rs], flags);
             break;
         }
     }
 }
 
-void CPU::executeMemory() {
-    uint8_t opcode = getOpcode();
-    uint8_t rd = getRd();
+void CPU::executeMemory(const DecodedOp& op) {
+    uint8_t opcode = op.opcode;
+    uint8_t rd = op.rd;
     
     switch (opcode) {
+        case 0x0F: { // LOAD/STORE Rd, [Rp+offset], [Rp+]
+            uint16_t addr = indirectAddress(op, registers);
+            if (op.handler == HANDLER_LOAD_INDIRECT) {
+                // A load into the pair itself wins over the increment
+                uint8_t value = memory->read(addr);
+                if (op.rs2) {
+                    incrementPair(op.rs1);
+                }
+                registers[rd] = value;
+            } else {
+                memory->write(addr, registers[rd]);
+                if (op.rs2) {
+                    incrementPair(op.rs1);
+                }
+            }
+            break;
+        }
         case 0x10: { // LOAD Rd, [addr]
-            uint16_t addr = fetchWord();
-            if (debug_mode) std::cout << "LOAD R" << static_cast<int>(rd) 
-                                      << ", [0x" << std::hex << addr << "]" << std::dec << std::endl;
+            uint16_t addr = op.target;
             registers[rd] = memory->read(addr);
             break;
         }
         case 0x11: { // STORE Rs, [addr]
-            uint16_t addr = fetchWord();
-            if (debug_mode) std::cout << "STORE R" << static_cast<int>(rd) 
-                                      << ", [0x" << std::hex << addr << "]" << std::dec << std::endl;
+            uint16_t addr = op.target;
             memory->write(addr, registers[rd]);
             break;
         }
         case 0x12: { // LOADI Rd, imm
-            ir[1] = fetchByte();
-            uint8_t imm = getImmediate();
-            if (debug_mode) std::cout << "LOADI R" << static_cast<int>(rd) 
-                                      << ", " << static_cast<int>(imm) << std::endl;
+            uint8_t imm = op.imm;
             registers[rd] = imm;
             break;
         }
+        case 0x17: { // CAS Rd, [addr]
+            // [addr] = Rd if it holds R0; R0 = the old value either way
+            uint8_t expected = registers[0];
+            registers[0] = memory->compareExchange(op.target, expected, registers[rd]);
+            alu.compare(expected, registers[0], flags);
+            break;
+        }
     }
 }
 
-void CPU::executeControl() {
-    uint8_t opcode = getOpcode();
+void CPU::executeControl(const DecodedOp& op) {
+    uint8_t opcode = op.opcode;
     
     switch (opcode) {
         case 0x18: { // JMP addr
-            uint16_t addr = fetchWord();
-            if (debug_mode) std::cout << "JMP 0x" << std::hex << addr << std::dec << std::endl;
+            uint16_t addr = op.target;
             pc = addr;
             break;
         }
         case 0x19: { // JZ addr
-            uint16_t addr = fetchWord();
-            if (debug_mode) std::cout << "JZ 0x" << std::hex << addr << std::dec;
+            uint16_t addr = op.target;
             if (flags & ALU::FLAG_Z) {
-                if (debug_mode) std::cout << " (taken)" << std::endl;
                 pc = addr;
-            } else {
-                if (debug_mode) std::cout << " (not taken)" << std::endl;
             }
             break;
         }
         case 0x1A: { // JNZ addr
-            uint16_t addr = fetchWord();
-            if (debug_mode) std::cout << "JNZ 0x" << std::hex << addr << std::dec;
+            uint16_t addr = op.target;
             if (!(flags & ALU::FLAG_Z)) {
-                if (debug_mode) std::cout << " (taken)" << std::endl;
                 pc = addr;
-            } else {
-                if (debug_mode) std::cout << " (not taken)" << std::endl;
             }
             break;
         }
         case 0x1B: { // JC addr
-            uint16_t addr = fetchWord();
-            if (debug_mode) std::cout << "JC 0x" << std::hex << addr << std::dec;
+            uint16_t addr = op.target;
             if (flags & ALU::FLAG_C) {
-                if (debug_mode) std::cout << " (taken)" << std::endl;
                 pc = addr;
-            } else {
-                if (debug_mode) std::cout << " (not taken)" << std::endl;
             }
             break;
         }
         case 0x1C: { // JNC addr
-            uint16_t addr = fetchWord();
-            if (debug_mode) std::cout << "JNC 0x" << std::hex << addr << std::dec;
+            uint16_t addr = op.target;
             if (!(flags & ALU::FLAG_C)) {
-                if (debug_mode) std::cout << " (taken)" << std::endl;
                 pc = addr;
-            } else {
-                if (debug_mode) std::cout << " (not taken)" << std::endl;
             }
             break;
         }
         case 0x1D: { // CALL addr
-            uint16_t addr = fetchWord();
-            if (debug_mode) std::cout << "CALL 0x" << std::hex << addr << std::dec << std::endl;
+            uint16_t addr = op.target;
             // Push return address (current PC) onto stack
             push(pc & 0xFF);        // Low byte
             push((pc >> 8) & 0xFF); // High byte
@@ -434,7 +584,6 @@ void CPU::executeControl() {
             break;
         }
         case 0x1E: { // RET
-            if (debug_mode) std::cout << "RET" << std::endl;
             // Pop return address from stack
             uint8_t high = pop();
             uint8_t low = pop();
@@ -444,59 +593,112 @@ void CPU::executeControl() {
     }
 }
 
-void CPU::executeStack() {
-    uint8_t opcode = getOpcode();
-    uint8_t rd = getRd();
+void CPU::executeStack(const DecodedOp& op) {
+    uint8_t opcode = op.opcode;
+    uint8_t rd = op.rd;
     
     switch (opcode) {
         case 0x15: // PUSH Rs
-            if (debug_mode) std::cout << "PUSH R" << static_cast<int>(rd) << std::endl;
             push(registers[rd]);
             break;
         case 0x16: // POP Rd
-            if (debug_mode) std::cout << "POP R" << static_cast<int>(rd) << std::endl;
             registers[rd] = pop();
             break;
     }
 }
 
-void CPU::executeSpecial() {
-    uint8_t opcode = getOpcode();
+void CPU::executeSpecial(const DecodedOp& op) {
+    uint8_t opcode = op.opcode;
     
     switch (opcode) {
-        case 0x1F: // HALT or NOP
-            if (ir[0] == 0xFF) {
+        case 0x1F: // HALT, NOP, RETI or WAIT
+            if (op.raw == 0xFF) {
                 // NOP (encoded as 0xFF)
-                if (debug_mode) std::cout << "NOP" << std::endl;
+            } else if (op.raw == 0xF9) {
+                returnFromInterrupt();
+            } else if (op.raw == 0xFA) {
+                waitForInterrupt();
             } else {
                 // HALT (encoded as 0xF8)
-                if (debug_mode) std::cout << "HALT" << std::endl;
                 halted = true;
             }
             break;
     }
 }
 
+void CPU::takeInterrupt() {
+    int source = interrupts->acknowledge();
+    if (source == InterruptController::NONE) {
+        return;
+    }
+    
+    // An event at the runaway guard ended the WAIT after all
+    if (wait_stopped) {
+        pc += 1;
+        wait_stopped = false;
+    }
+    
+    // Same frame as CALL, with the flags on top
+    resolvePendingFlags();
+    push(pc & 0xFF);
+    push((pc >> 8) & 0xFF);
+    push(flags);
+    uint16_t vector = InterruptController::vectorAddress(source);
+    pc = memory->read(vector) | (memory->read(vector + 1) << 8);
+}
+
+void CPU::returnFromInterrupt() {
+    flags = pop();
+    pending_flags.op = FLAGOP_NONE;
+    uint8_t high = pop();
+    uint8_t low = pop();
+    pc = low | (high << 8);
+    if (interrupts) {
+        interrupts->endOfInterrupt();
+    }
+}
+
+void CPU::waitForInterrupt() {
+    wait_stopped = false;
+    if (!interrupts) {
+        return;
+    }
+    
+    // Nothing but a device event can raise a source, so the cycles in
+    // between are skipped instead of executed
+    while (!interrupts->isWaking()) {
+        uint64_t next = scheduler->nextDeadline();
+        if (next > cycle_limit + 1) {
+            // Nothing wakes the core before the runaway guard. Stop one
+            // cycle short of the next event, so resuming with a higher
+            // limit waits again and wakes at the same cycle.
+            cycle_count = std::max(cycle_count, cycle_limit);
+            pc -= 1;
+            wait_stopped = true;
+            return;
+        }
+        cycle_count = std::max(cycle_count, next);
+        scheduler->runDue();
+    }
+    takeInterrupt();
+}
+
 void CPU::push(uint8_t value) {
-    // SP is R7 - it holds only the high byte, low byte is in a separate location
-    // For simplicity, we'll use a full 16-bit stack pointer
     // Decrement SP first (pre-decrement)
-    uint16_t sp = (registers[7] << 8) | 0xFE;
-    sp--;
-    memory->write(sp, value);
-    registers[7] = (sp >> 8) & 0xFF;
+    memory->write(pushAddress(registers[7]), value);
+    registers[7] = afterPush(registers[7]);
 }
 
 uint8_t CPU::pop() {
     // Read value then increment SP (post-increment)
-    uint16_t sp = (registers[7] << 8) | 0xFE;
-    uint8_t value = memory->read(sp);
-    sp++;
-    registers[7] = (sp >> 8) & 0xFF;
+    uint8_t value = memory->read(popAddress(registers[7]));
+    registers[7] = afterPop(registers[7]);
     return value;
 }
 
-void CPU::printState() {
+void CPU::printState() const {
+    uint8_t current_flags = getFlags();  // Resolves any pending lazy flags
+    
     std::cout << "Registers: ";
     for (int i = 0; i < 8; i++) {
         std::cout << "R" << i << "=0x" << std::hex << std::setw(2) 
@@ -506,17 +708,71 @@ void CPU::printState() {
     
     std::cout << "PC=0x" << std::hex << std::setw(4) << std::setfill('0') << pc;
     std::cout << " Flags=[";
-    std::cout << ((flags & ALU::FLAG_N) ? "N" : "-");
-    std::cout << ((flags & ALU::FLAG_Z) ? "Z" : "-");
-    std::cout << ((flags & ALU::FLAG_C) ? "C" : "-");
-    std::cout << ((flags & ALU::FLAG_V) ? "V" : "-");
+    std::cout << ((current_flags & ALU::FLAG_N) ? "N" : "-");
+    std::cout << ((current_flags & ALU::FLAG_Z) ? "Z" : "-");
+    std::cout << ((current_flags & ALU::FLAG_C) ? "C" : "-");
+    std::cout << ((current_flags & ALU::FLAG_V) ? "V" : "-");
     std::cout << "] Cycles=" << std::dec << cycle_count << std::endl;
 }
 
-std::string CPU::disassemble(uint8_t opcode, uint8_t byte1, uint8_t byte2) {
-    // Simple disassembly for debugging
+const char* CPU::mnemonic(uint8_t handler) {
+    static const char* const names[HANDLER_COUNT] = {
+        "ADD", "ADDI", "SUB", "SUBI", "MUL", "INC", "DEC", "AND",
+        "ANDI", "OR", "ORI", "XOR", "NOT", "SHL", "SHR", "???",
+        "LOAD", "STORE", "LOADI", "CMP", "CMPI", "PUSH", "POP", "CAS",
+        "JMP", "JZ", "JNZ", "JC", "JNC", "CALL", "RET", "HALT",
+        "NOP", "???", "RETI", "WAIT", "LOAD", "STORE", "MULH", "DIV",
+        "MOD"
+    };
+    return handler < HANDLER_COUNT ? names[handler] : "???";
+}
+
+std::string CPU::disassemble(const DecodedOp& op) {
     std::stringstream ss;
-    ss << "Opcode 0x" << std::hex << static_cast<int>(opcode);
+    ss << mnemonic(op.handler);
+    
+    switch (op.handler) {
+        case 0x00: case 0x02: case 0x04: // Rd, Rs1, Rs2
+        case HANDLER_MULH: case HANDLER_DIV: case HANDLER_MOD:
+        case 0x07: case 0x09: case 0x0B:
+            ss << " R" << static_cast<int>(op.rd) << ", R" << static_cast<int>(op.rs1)
+               << ", R" << static_cast<int>(op.rs2);
+            break;
+        case 0x01: // ADDI Rd, Rs, imm (Rs is Rd)
+            ss << " R" << static_cast<int>(op.rd) << ", R" << static_cast<int>(op.rd)
+               << ", " << static_cast<int>(op.imm);
+            break;
+        case 0x03: case 0x08: case 0x0A: // Rd, imm
+        case 0x12: case 0x14:
+            ss << " R" << static_cast<int>(op.rd) << ", " << static_cast<int>(op.imm);
+            break;
+        case 0x0C: case 0x0D: case 0x0E: // Rd, Rs
+        case 0x13:
+            ss << " R" << static_cast<int>(op.rd) << ", R" << static_cast<int>(op.rs1);
+            break;
+        case 0x05: case 0x06: case 0x15: case 0x16: // Rd
+            ss << " R" << static_cast<int>(op.rd);
+            break;
+        case 0x10: case 0x11: case 0x17: // Rd, [addr]
+            ss << " R" << static_cast<int>(op.rd) << ", [0x" << std::hex << op.target << "]";
+            break;
+        case HANDLER_LOAD_INDIRECT: case HANDLER_STORE_INDIRECT: { // Rd, [Rp+offset]
+            int offset = static_cast<int8_t>(op.target >> 8);
+            ss << " R" << static_cast<int>(op.rd) << ", [R" << static_cast<int>(op.rs1);
+            if (op.rs2) {
+                ss << "+";
+            } else if (offset != 0) {
+                ss << (offset > 0 ? "+" : "") << offset;
+            }
+            ss << "]";
+            break;
+        }
+        case 0x18: case 0x19: case 0x1A: case 0x1B: case 0x1C: case 0x1D: // addr
+            ss << " 0x" << std::hex << op.target;
+            break;
+        case HANDLER_INVALID:
+            ss << " (opcode 0x" << std::hex << static_cast<int>(op.opcode) << ")";
+            break;
+    }
     return ss.str();
 }
-
@@ -5,7 +5,25 @@
 #include <string>
 #include "memory.h"
 #include "alu.h"
-#include "bus.h"
+#include "decode_cache.h"
+
+class CacheHierarchy;
+class Jit;
+class TimingModel;
+
+/**
+ * Execution engines
+ * - Switch:   Classic opcode switch in CPU::execute()
+ * - Threaded: One indirect jump per instruction straight from the
+ *             decoded handler index (computed goto on GCC/Clang)
+ * - Jit:      x86-64 translation of basic blocks (see jit.h); falls
+ *             back to Threaded on other hosts
+ */
+enum class ExecutionEngine {
+    Switch,
+    Threaded,
+    Jit
+};
 
 /**
  * CPU class - Main CPU implementation
@@ -15,76 +33,222 @@
  * - 16-bit Program Counter (PC)
  * - 8-bit Flags register
  * - Instruction fetch/decode/execute cycle
+ * 
+ * Instructions are decoded once into a DecodeCache and executed from
+ * the predecoded entries on every later visit.
+ * 
+ * step() and run() are templates over a trace policy (see trace.h).
+ * Normal runs use NoTrace, whose hooks compile away; debug mode uses
+ * TextTrace. The threaded and JIT engines are only used with NoTrace,
+ * so any traced run steps through the switch engine. Single steps
+ * never enter translated code.
+ * 
+ * With a TimingModel installed each instruction costs the cycles the
+ * model gives it instead of one, and with a CacheHierarchy installed
+ * its cache miss stalls are added on top. Timed runs always use the
+ * switch engine, so the threaded and JIT engines never pay for either.
+ * 
+ * In lazy-flags mode the threaded engine records the last flag-producing
+ * operation instead of computing N/Z/C/V, and evaluates them only for
+ * conditional branches, shifts, or when control leaves the engine.
+ * 
+ * Core 0 owns device time: its cycle count is the scheduler clock and
+ * it fires device events. Other cores sharing the memory (see
+ * Multicore) count their own cycles and never service events.
+ * 
+ * Interrupts are taken by core 0 only, after the device events at an
+ * instruction boundary: PC (low byte, then high) and the flags are
+ * pushed and execution continues at the source's vector (see
+ * InterruptController); RETI pops them back. WAIT skips straight from
+ * one device event to the next until an unmasked source is pending,
+ * so an idle guest costs no interpreted instructions. On other cores
+ * WAIT does nothing.
  */
 class CPU {
+    friend class Jit;
+    
 private:
     // Registers
     uint8_t registers[8];    // R0-R7 (R7 is SP)
     uint16_t pc;             // Program Counter
     uint8_t flags;           // Status flags
+    PendingFlags pending_flags;  // Unevaluated flag update (lazy-flags mode)
     
     // Components
     Memory* memory;
+    Scheduler* scheduler;   // Device events (owned by memory; idle on cores > 0)
+    InterruptController* interrupts;  // Owned by memory; nullptr on cores > 0
     ALU alu;
-    Bus bus;
+    DecodeCache decode_cache;
     
     // State
+    uint8_t core_id;
     bool halted;
+    bool wait_stopped;      // PC was moved back onto a WAIT at the runaway guard
     uint64_t cycle_count;
+    uint64_t cycle_limit;   // Runaway guard
     bool debug_mode;
+    bool lazy_flags;
+    ExecutionEngine engine;
+    Jit* jit;               // Only allocated for ExecutionEngine::Jit
+    const TimingModel* timing;  // nullptr: one cycle per instruction
+    CacheHierarchy* caches;     // nullptr: no cache stalls
     
-    // Instruction register
-    uint8_t ir[3];  // Current instruction (max 3 bytes)
+    CPU(const CPU&);
+    CPU& operator=(const CPU&);
     
 public:
-    CPU(Memory* mem);
+    // Default runaway guard used by run()
+    static const uint64_t MAX_CYCLES = 1000000;
+    
+    // Page holding the stack (SP = STACK_PAGE | R7)
+    static const uint16_t STACK_PAGE = 0xFE00;
+    
+    CPU(Memory* mem, ExecutionEngine eng = ExecutionEngine::Switch, uint8_t core = 0);
+    ~CPU();
     
     // CPU control
-    void reset();
+    void reset();          // Registers only; caches survive (see Memory::reset)
     void step();           // Execute one instruction
     void run();            // Run until HALT
+    bool runUntilHalt();   // Same, silently; false on runaway
+    
+    // Same as step()/run(), reporting each instruction to a trace policy
+    template <class Trace> void step(Trace& trace);
+    template <class Trace> void run(Trace& trace);
+    template <class Trace> bool runUntilHalt(Trace& trace);
     bool isHalted() const { return halted; }
     
+    // Snapshots of the whole machine: registers, flags, cycle count,
+    // RAM and device state (format in snapshot.h)
+    bool saveSnapshot(const std::string& path);
+    bool loadSnapshot(const std::string& path);
+    
+    // The "CPU " section alone (RAM and devices belong to Memory)
+    void saveState(SnapshotWriter& snapshot);
+    bool restoreState(SnapshotReader& snapshot);
+    
     // Debugging
     void enableDebug(bool enable) { debug_mode = enable; }
-    void printState();
+    void enableLazyFlags(bool enable) { lazy_flags = enable; }
+    
+    // Multicore: the core's number (CORE_ID), the host thread that runs
+    // it (bind before any core starts), and picking up code other cores
+    // have rewritten (call between runs on the bound thread)
+    uint8_t getCoreId() const { return core_id; }
+    void bindToThread(std::thread::id thread) { decode_cache.setOwner(thread); }
+    void applyRemoteCodeChanges() { decode_cache.applyPending(); }
+    
+    // Charge cycles from a timing model (not owned; nullptr to go back
+    // to one cycle per instruction)
+    void setTimingModel(const TimingModel* model) { timing = model; }
+    
+    // Add miss stalls from a cache model (not owned; nullptr for none)
+    void setCaches(CacheHierarchy* hierarchy) { caches = hierarchy; }
+    void printState() const;
     uint64_t getCycleCount() const { return cycle_count; }
     
+    // Instructions run() may retire before it reports a runaway. The
+    // CPU is left unhalted there, so raising the limit continues the run.
+    void setCycleLimit(uint64_t limit) { cycle_limit = limit; }
+    uint64_t getCycleLimit() const { return cycle_limit; }
+    
     // Register access (for debugging)
     uint8_t getRegister(int reg) const { return registers[reg]; }
+    void setRegister(int reg, uint8_t value) { registers[reg] = value; }
+    const uint8_t* getRegisters() const { return registers; }
     uint16_t getPC() const { return pc; }
-    uint8_t getFlags() const { return flags; }
+    uint8_t getFlags() const { return ALU::resolveFlags(pending_flags, flags); }
+    ExecutionEngine getEngine() const { return engine; }
+    
+    // Disassembly (for trace output)
+    static const char* mnemonic(uint8_t handler);
+    static std::string disassemble(const DecodedOp& op);
+    
+    // The stack lives in page 0xFE and R7 holds the low byte of SP:
+    // PUSH is [--SP] = Rs, POP is Rd = [SP++]. These give the slot a
+    // push writes / a pop reads when R7 is `sp`, and the R7 it leaves.
+    static uint16_t pushAddress(uint8_t sp) { return STACK_PAGE | static_cast<uint8_t>(sp - 1); }
+    static uint16_t popAddress(uint8_t sp) { return STACK_PAGE | sp; }
+    static uint8_t afterPush(uint8_t sp) { return sp - 1; }
+    static uint8_t afterPop(uint8_t sp) { return sp + 1; }
+    
+    // Register-indirect LOAD/STORE address through the pair Rp (low
+    // byte), Rp+1 (high byte) plus the signed offset, given the
+    // registers the instruction executes with
+    static uint16_t indirectAddress(const DecodedOp& op, const uint8_t* regs) {
+        uint16_t base = regs[op.rs1] | (regs[op.rs1 + 1] << 8);
+        return static_cast<uint16_t>(base + static_cast<int8_t>(op.target >> 8));
+    }
+    static bool isIndirect(uint8_t handler) {
+        return handler == HANDLER_LOAD_INDIRECT || handler == HANDLER_STORE_INDIRECT;
+    }
+    
+    // Data address the instruction about to execute will access
+    // (LOAD, STORE, CAS and their indirect forms)
+    uint16_t dataAddress(const DecodedOp& op) const {
+        return isIndirect(op.handler) ? indirectAddress(op, registers) : op.target;
+    }
     
 private:
     // Instruction cycle phases
-    void fetch();
-    void decode();
-    void execute();
+    const DecodedOp& fetch();
+    void execute(const DecodedOp& op);
     
     // Instruction execution helpers
-    void executeArithmetic();
-    void executeLogical();
-    void executeMemory();
-    void executeControl();
-    void executeStack();
-    void executeSpecial();
+    void executeArithmetic(const DecodedOp& op);
+    void executeLogical(const DecodedOp& op);
+    void executeMemory(const DecodedOp& op);
+    void executeControl(const DecodedOp& op);
+    void executeStack(const DecodedOp& op);
+    void executeSpecial(const DecodedOp& op);
+    void reportInvalid(const DecodedOp& op);
+    
+    // One instruction through the switch engine; Timed charges cycles
+    // from the timing model and caches
+    template <class Trace, bool Timed> void stepSwitch(Trace& trace);
+    bool isTimed() const { return timing || caches; }
+    
+    // Threaded engine: runs until HALT, a runaway condition, or
+    // max_steps instructions have retired (see cpu_threaded.cpp).
+    // Pending lazy flags are always resolved before it returns.
+    void runThreaded(uint64_t max_steps);
+    template <bool Lazy> void runThreadedImpl(uint64_t max_steps);
+    
+    // Fire device events once the cycle count reaches the next deadline,
+    // then take any interrupt they requested (requests only ever appear
+    // with an event, see InterruptController)
+    void serviceEvents() {
+        if (cycle_count >= scheduler->nextDeadline()) {
+            scheduler->runDue();
+            if (interrupts && !halted) {
+                takeInterrupt();
+            }
+        }
+    }
+    
+    // Interrupts: enter the handler of the pending request, if any;
+    // RETI; WAIT
+    void takeInterrupt();
+    void returnFromInterrupt();
+    void waitForInterrupt();
+    
+    // Evaluate any pending lazy flag update into the flags register
+    void resolvePendingFlags() {
+        flags = ALU::resolveFlags(pending_flags, flags);
+        pending_flags.op = FLAGOP_NONE;
+    }
     
     // Helper functions
-    uint8_t fetchByte();
-    uint16_t fetchWord();
     void push(uint8_t value);
     uint8_t pop();
     
-    // Opcode extraction
-    uint8_t getOpcode() const { return ir[0] >> 3; }
-    uint8_t getRd() const { return ir[0] & 0x07; }
-    uint8_t getRs1() const { return (ir[1] >> 5) & 0x07; }
-    uint8_t getRs2() const { return (ir[1] >> 2) & 0x07; }
-    uint8_t getImmediate() const { return ir[1]; }
-    uint16_t getAddress() const { return ir[1] | (ir[2] << 8); }
-    
-    // Disassembly (for debug output)
-    std::string disassemble(uint8_t opcode, uint8_t byte1, uint8_t byte2);
+    // Post-increment of a register-indirect pair
+    void incrementPair(uint8_t base) {
+        uint16_t value = (registers[base] | (registers[base + 1] << 8)) + 1;
+        registers[base] = value & 0xFF;
+        registers[base + 1] = value >> 8;
+    }
 };
 
 #endif // CPU_H
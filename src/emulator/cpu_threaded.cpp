@@ -0,0 +1,329 @@
+#include "cpu.h"
+#include <algorithm>
+#include <iostream>
+
+/**
+ * Threaded execution engine
+ *
+ * Each instruction jumps straight to its handler through the handler
+ * index stored in its DecodedOp, and every handler ends with its own
+ * copy of the dispatch jump. This replaces the two-level switch in
+ * CPU::execute() (opcode class, then opcode) with one indirect branch
+ * per instruction that the host predictor can learn per call site.
+ *
+ * Device events are not polled per instruction: `limit` holds the
+ * earlier of the stop cycle and the scheduler's next deadline, so a
+ * handler leaves the fast path only when one of them is reached (or
+ * when PC runs into the I/O region). Interrupts are taken there too,
+ * since a request always comes with an event.
+ *
+ * The engine is instantiated twice: with eager flags (ALU helpers) and
+ * with lazy flags, where arithmetic only records a PendingFlags entry
+ * and branches evaluate just the flag they test.
+ *
+ * GCC and Clang use labels-as-values; other compilers fall back to a
+ * single switch over the same handler bodies. Build with
+ * -DSC8_COMPUTED_GOTO=0 to force the portable fallback.
+ */
+
+#ifndef SC8_COMPUTED_GOTO
+#if defined(__GNUC__) || defined(__clang__)
+#define SC8_COMPUTED_GOTO 1
+#else
+#define SC8_COMPUTED_GOTO 0
+#endif
+#endif
+
+#if SC8_COMPUTED_GOTO
+#define HANDLER(index) op_##index:
+#define DISPATCH() goto *dispatch_table[op->handler]
+#else
+#define HANDLER(index) case index:
+#define DISPATCH() goto dispatch
+#endif
+
+// Retire the current instruction, then fetch and dispatch the next one
+#define NEXT()                                                      \
+    {                                                               \
+        if (++cycle_count >= limit || pc >= 0xFF00) {              \
+            serviceEvents();                                        \
+            if (cycle_count >= stop || pc >= 0xFF00) {              \
+                return;                                             \
+            }                                                       \
+            limit = std::min(stop, scheduler->nextDeadline());      \
+        }                                                           \
+        op = &decode_cache.lookup(pc);                              \
+        pc += op->length;                                           \
+        DISPATCH();                                                 \
+    }
+
+#define BRANCH_IF(condition)                                        \
+    {                                                               \
+        if (condition) {                                            \
+            pc = op->target;                                        \
+        }                                                           \
+        NEXT();                                                     \
+    }
+
+// Flag tests for conditional branches
+#define FLAG_Z_SET() \
+    (Lazy ? ALU::pendingZero(pending_flags, flags) : (flags & ALU::FLAG_Z) != 0)
+#define FLAG_C_SET() \
+    (Lazy ? ALU::pendingCarry(pending_flags, flags) : (flags & ALU::FLAG_C) != 0)
+
+void CPU::runThreaded(uint64_t max_steps) {
+    if (lazy_flags) {
+        runThreadedImpl<true>(max_steps);
+        resolvePendingFlags();
+    } else {
+        runThreadedImpl<false>(max_steps);
+    }
+}
+
+template <bool Lazy>
+void CPU::runThreadedImpl(uint64_t max_steps) {
+    if (halted || max_steps == 0) {
+        return;
+    }
+
+#if SC8_COMPUTED_GOTO
+    static void* const dispatch_table[HANDLER_COUNT] = {
+        &&op_0x00, &&op_0x01, &&op_0x02, &&op_0x03,
+        &&op_0x04, &&op_0x05, &&op_0x06, &&op_0x07,
+        &&op_0x08, &&op_0x09, &&op_0x0A, &&op_0x0B,
+        &&op_0x0C, &&op_0x0D, &&op_0x0E, &&op_invalid,
+        &&op_0x10, &&op_0x11, &&op_0x12, &&op_0x13,
+        &&op_0x14, &&op_0x15, &&op_0x16, &&op_0x17,
+        &&op_0x18, &&op_0x19, &&op_0x1A, &&op_0x1B,
+        &&op_0x1C, &&op_0x1D, &&op_0x1E, &&op_0x1F,
+        &&op_HANDLER_NOP, &&op_invalid, &&op_HANDLER_RETI, &&op_HANDLER_WAIT,
+        &&op_HANDLER_LOAD_INDIRECT, &&op_HANDLER_STORE_INDIRECT,
+        &&op_HANDLER_MULH, &&op_HANDLER_DIV, &&op_HANDLER_MOD
+    };
+#endif
+
+    // Stop after max_steps instructions or once the runaway limit is hit
+    uint64_t stop = std::min(cycle_count + max_steps, cycle_limit + 1);
+    uint64_t limit = std::min(stop, scheduler->nextDeadline());
+
+    const DecodedOp* op = &decode_cache.lookup(pc);
+    pc += op->length;
+
+#if SC8_COMPUTED_GOTO
+    DISPATCH();
+#else
+dispatch:
+    switch (op->handler) {
+#endif
+
+    // Arithmetic
+    HANDLER(0x00) // ADD
+        registers[op->rd] = Lazy ? ALU::addLazy(registers[op->rs1], registers[op->rs2], pending_flags)
+                                 : alu.add(registers[op->rs1], registers[op->rs2], flags);
+        NEXT();
+    HANDLER(0x01) // ADDI
+        registers[op->rd] = Lazy ? ALU::addLazy(registers[op->rd], op->imm, pending_flags)
+                                 : alu.add(registers[op->rd], op->imm, flags);
+        NEXT();
+    HANDLER(0x02) // SUB
+        registers[op->rd] = Lazy ? ALU::subtractLazy(registers[op->rs1], registers[op->rs2], pending_flags)
+                                 : alu.subtract(registers[op->rs1], registers[op->rs2], flags);
+        NEXT();
+    HANDLER(0x03) // SUBI
+        registers[op->rd] = Lazy ? ALU::subtractLazy(registers[op->rd], op->imm, pending_flags)
+                                 : alu.subtract(registers[op->rd], op->imm, flags);
+        NEXT();
+    HANDLER(0x04) // MUL
+        registers[op->rd] = Lazy ? ALU::logicLazy(registers[op->rs1] * registers[op->rs2], pending_flags)
+                                 : alu.multiply(registers[op->rs1], registers[op->rs2], flags);
+        NEXT();
+    HANDLER(HANDLER_MULH)
+        if (Lazy) resolvePendingFlags();
+        registers[op->rd] = alu.multiplyHigh(registers[op->rs1], registers[op->rs2], flags);
+        NEXT();
+    HANDLER(HANDLER_DIV)
+        if (Lazy) resolvePendingFlags();  // Divide by zero sets carry
+        registers[op->rd] = alu.divide(registers[op->rs1], registers[op->rs2], flags);
+        NEXT();
+    HANDLER(HANDLER_MOD)
+        if (Lazy) resolvePendingFlags();
+        registers[op->rd] = alu.modulo(registers[op->rs1], registers[op->rs2], flags);
+        NEXT();
+    HANDLER(0x05) // INC
+        registers[op->rd] = Lazy ? ALU::addLazy(registers[op->rd], 1, pending_flags)
+                                 : alu.increment(registers[op->rd], flags);
+        NEXT();
+    HANDLER(0x06) // DEC
+        registers[op->rd] = Lazy ? ALU::subtractLazy(registers[op->rd], 1, pending_flags)
+                                 : alu.decrement(registers[op->rd], flags);
+        NEXT();
+
+    // Logical
+    HANDLER(0x07) // AND
+        registers[op->rd] = Lazy ? ALU::logicLazy(registers[op->rs1] & registers[op->rs2], pending_flags)
+                                 : alu.logicalAnd(registers[op->rs1], registers[op->rs2], flags);
+        NEXT();
+    HANDLER(0x08) // ANDI
+        registers[op->rd] = Lazy ? ALU::logicLazy(registers[op->rd] & op->imm, pending_flags)
+                                 : alu.logicalAnd(registers[op->rd], op->imm, flags);
+        NEXT();
+    HANDLER(0x09) // OR
+        registers[op->rd] = Lazy ? ALU::logicLazy(registers[op->rs1] | registers[op->rs2], pending_flags)
+                                 : alu.logicalOr(registers[op->rs1], registers[op->rs2], flags);
+        NEXT();
+    HANDLER(0x0A) // ORI
+        registers[op->rd] = Lazy ? ALU::logicLazy(registers[op->rd] | op->imm, pending_flags)
+                                 : alu.logicalOr(registers[op->rd], op->imm, flags);
+        NEXT();
+    HANDLER(0x0B) // XOR
+        registers[op->rd] = Lazy ? ALU::logicLazy(registers[op->rs1] ^ registers[op->rs2], pending_flags)
+                                 : alu.logicalXor(registers[op->rs1], registers[op->rs2], flags);
+        NEXT();
+    HANDLER(0x0C) // NOT
+        registers[op->rd] = Lazy ? ALU::logicLazy(~registers[op->rs1], pending_flags)
+                                 : alu.logicalNot(registers[op->rs1], flags);
+        NEXT();
+    HANDLER(0x0D) // SHL
+        if (Lazy) resolvePendingFlags();  // Shift by 0 keeps the old flags
+        registers[op->rd] = alu.shiftLeft(registers[op->rd], registers[op->rs1], flags);
+        NEXT();
+    HANDLER(0x0E) // SHR
+        if (Lazy) resolvePendingFlags();
+        registers[op->rd] = alu.shiftRight(registers[op->rd], registers[op->rs1], flags);
+        NEXT();
+
+    // Memory
+    HANDLER(0x10) // LOAD
+        registers[op->rd] = memory->read(op->target);
+        NEXT();
+    HANDLER(0x11) // STORE
+        memory->write(op->target, registers[op->rd]);
+        if (op->target >= 0xFF00) {
+            // A device register write may have scheduled an event
+            limit = std::min(stop, scheduler->nextDeadline());
+        }
+        NEXT();
+    HANDLER(HANDLER_LOAD_INDIRECT)
+    {
+        uint8_t value = memory->read(indirectAddress(*op, registers));
+        if (op->rs2) {
+            incrementPair(op->rs1);
+        }
+        registers[op->rd] = value;
+        NEXT();
+    }
+    HANDLER(HANDLER_STORE_INDIRECT)
+    {
+        uint16_t address = indirectAddress(*op, registers);
+        memory->write(address, registers[op->rd]);
+        if (op->rs2) {
+            incrementPair(op->rs1);
+        }
+        if (address >= 0xFF00) {
+            limit = std::min(stop, scheduler->nextDeadline());
+        }
+        NEXT();
+    }
+    HANDLER(0x12) // LOADI
+        registers[op->rd] = op->imm;
+        NEXT();
+    HANDLER(0x17) // CAS
+    {
+        uint8_t expected = registers[0];
+        registers[0] = memory->compareExchange(op->target, expected, registers[op->rd]);
+        if (Lazy) ALU::subtractLazy(expected, registers[0], pending_flags);
+        else alu.compare(expected, registers[0], flags);
+        if (op->target >= 0xFF00) {
+            limit = std::min(stop, scheduler->nextDeadline());
+        }
+        NEXT();
+    }
+
+    // Comparison
+    HANDLER(0x13) // CMP
+        if (Lazy) ALU::subtractLazy(registers[op->rd], registers[op->rs1], pending_flags);
+        else alu.compare(registers[op->rd], registers[op->rs1], flags);
+        NEXT();
+    HANDLER(0x14) // CMPI
+        if (Lazy) ALU::subtractLazy(registers[op->rd], op->imm, pending_flags);
+        else alu.compare(registers[op->rd], op->imm, flags);
+        NEXT();
+
+    // Stack
+    HANDLER(0x15) // PUSH
+        push(registers[op->rd]);
+        NEXT();
+    HANDLER(0x16) // POP
+        registers[op->rd] = pop();
+        NEXT();
+
+    // Control flow
+    HANDLER(0x18) // JMP
+        pc = op->target;
+        NEXT();
+    HANDLER(0x19) // JZ
+        BRANCH_IF(FLAG_Z_SET());
+    HANDLER(0x1A) // JNZ
+        BRANCH_IF(!FLAG_Z_SET());
+    HANDLER(0x1B) // JC
+        BRANCH_IF(FLAG_C_SET());
+    HANDLER(0x1C) // JNC
+        BRANCH_IF(!FLAG_C_SET());
+    HANDLER(0x1D) // CALL
+        push(pc & 0xFF);        // Low byte
+        push((pc >> 8) & 0xFF); // High byte
+        pc = op->target;
+        NEXT();
+    HANDLER(0x1E) // RET
+    {
+        uint8_t high = pop();
+        uint8_t low = pop();
+        pc = low | (high << 8);
+        NEXT();
+    }
+
+    // Special
+    HANDLER(0x1F) // HALT
+        halted = true;
+        cycle_count++;
+        serviceEvents();
+        return;
+    HANDLER(HANDLER_NOP)
+        NEXT();
+    HANDLER(HANDLER_RETI)
+        returnFromInterrupt();
+        limit = std::min(stop, scheduler->nextDeadline());  // Another request may be due
+        NEXT();
+    HANDLER(HANDLER_WAIT)
+        // The wait runs device events and may enter a handler
+        waitForInterrupt();
+        limit = std::min(stop, scheduler->nextDeadline());
+        NEXT();
+
+#if SC8_COMPUTED_GOTO
+op_invalid:
+#else
+    default:
+#endif
+    std::cerr << "Error: Unknown opcode 0x" << std::hex << static_cast<int>(op->opcode)
+              << " at PC=0x" << static_cast<uint16_t>(pc - op->length) << std::dec << std::endl;
+    halted = true;
+    cycle_count++;
+    serviceEvents();
+    return;
+
+#if !SC8_COMPUTED_GOTO
+    }
+#endif
+}
+
+template void CPU::runThreadedImpl<true>(uint64_t max_steps);
+template void CPU::runThreadedImpl<false>(uint64_t max_steps);
+
+#undef FLAG_C_SET
+#undef FLAG_Z_SET
+#undef BRANCH_IF
+#undef NEXT
+#undef DISPATCH
+#undef HANDLER
+#undef SC8_COMPUTED_GOTO
@@ -0,0 +1,132 @@
+#include "decode_cache.h"
+
+DecodeCache::DecodeCache(Memory* mem) : memory(mem), ops(65536), has_pending(false) {
+    clear();
+    memory->addWatcher(this);
+}
+
+DecodeCache::~DecodeCache() {
+    memory->removeWatcher(this);
+}
+
+void DecodeCache::fill(uint16_t pc) {
+    uint8_t byte0 = memory->read(pc);
+    uint8_t length = lengthOf(byte0 >> 3);
+    
+    // Only read the bytes the instruction actually uses
+    uint8_t byte1 = (length > 1) ? memory->read(static_cast<uint16_t>(pc + 1)) : 0;
+    uint8_t byte2 = (length > 2) ? memory->read(static_cast<uint16_t>(pc + 2)) : 0;
+    
+    DecodedOp op = decode(byte0, byte1, byte2);
+    
+    if (pc >= 0xFF00) {
+        io_op = op;
+        return;
+    }
+    
+    // Flag every page the instruction touches so stores invalidate it
+    memory->markCodePage(pc);
+    memory->markCodePage(static_cast<uint16_t>(pc + length - 1));
+    ops[pc] = op;
+}
+
+void DecodeCache::clear() {
+    for (size_t i = 0; i < ops.size(); i++) {
+        ops[i].valid = false;
+    }
+}
+
+void DecodeCache::onCodeModified(uint16_t start, uint32_t count) {
+    if (owner != std::thread::id() && std::this_thread::get_id() != owner) {
+        std::lock_guard<std::mutex> guard(pending_lock);
+        pending.push_back(std::make_pair(start, count));
+        has_pending.store(true, std::memory_order_release);
+        return;
+    }
+    invalidate(start, count);
+}
+
+void DecodeCache::applyPendingSlow() {
+    std::lock_guard<std::mutex> guard(pending_lock);
+    for (size_t i = 0; i < pending.size(); i++) {
+        invalidate(pending[i].first, pending[i].second);
+    }
+    pending.clear();
+    has_pending.store(false, std::memory_order_relaxed);
+}
+
+void DecodeCache::invalidate(uint16_t start, uint32_t count) {
+    // An instruction of up to 3 bytes starting at start-2 may overlap
+    uint32_t first = (start >= 2) ? start - 2 : 0;
+    uint32_t last = start + count;
+    if (last > ops.size()) {
+        last = ops.size();
+    }
+    
+    for (uint32_t addr = first; addr < last; addr++) {
+        ops[addr].valid = false;
+    }
+}
+
+uint8_t DecodeCache::lengthOf(uint8_t opcode) {
+    switch (opcode) {
+        case 0x05: // INC
+        case 0x06: // DEC
+        case 0x15: // PUSH
+        case 0x16: // POP
+        case 0x1E: // RET
+        case 0x1F: // HALT / NOP / RETI / WAIT
+            return 1;
+        case 0x0F: // LOAD / STORE Rd, [Rp+offset]
+        case 0x10: // LOAD
+        case 0x11: // STORE
+        case 0x17: // CAS
+        case 0x18: // JMP
+        case 0x19: // JZ
+        case 0x1A: // JNZ
+        case 0x1B: // JC
+        case 0x1C: // JNC
+        case 0x1D: // CALL
+            return 3;
+        default:   // RR and RI formats
+            return 2;
+    }
+}
+
+DecodedOp DecodeCache::decode(uint8_t byte0, uint8_t byte1, uint8_t byte2) {
+    DecodedOp op;
+    op.opcode = byte0 >> 3;
+    op.rd = byte0 & 0x07;
+    op.rs1 = (byte1 >> 5) & 0x07;
+    op.rs2 = (byte1 >> 2) & 0x07;
+    op.imm = byte1;
+    op.length = lengthOf(op.opcode);
+    op.raw = byte0;
+    op.valid = true;
+    
+    if (byte0 == 0xFF) {
+        op.handler = HANDLER_NOP;
+    } else if (byte0 == 0xF9) {
+        op.handler = HANDLER_RETI;
+    } else if (byte0 == 0xFA) {
+        op.handler = HANDLER_WAIT;
+    } else if (op.opcode == 0x04 && (byte1 & 0x03)) {
+        // Byte 1 bits 1-0 select MUL (0), MULH, DIV or MOD
+        static const uint8_t variants[] = { 0x04, HANDLER_MULH, HANDLER_DIV, HANDLER_MOD };
+        op.handler = variants[byte1 & 0x03];
+    } else if (op.opcode == 0x0F) {
+        // Byte 1: pair base (even register), bit 4 store, bit 3
+        // post-increment (offset must be 0), bits 2-0 reserved
+        bool post_increment = (byte1 & 0x08) != 0;
+        op.rs2 = post_increment;
+        if ((byte1 & 0x27) || (post_increment && byte2)) {
+            op.handler = HANDLER_INVALID;
+        } else {
+            op.handler = (byte1 & 0x10) ? HANDLER_STORE_INDIRECT : HANDLER_LOAD_INDIRECT;
+        }
+    } else {
+        op.handler = op.opcode;
+    }
+    op.target = byte1 | (byte2 << 8);
+    return op;
+}
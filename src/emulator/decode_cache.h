@@ -0,0 +1,121 @@
+#ifndef DECODE_CACHE_H
+#define DECODE_CACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "memory.h"
+
+/**
+ * Handler indices used by the threaded execution engine. Every opcode
+ * maps to itself except NOP, RETI and WAIT, which share opcode 0x1F
+ * with HALT, the register-indirect LOAD and STORE, which share opcode
+ * 0x0F, MULH, DIV and MOD, which share opcode 0x04 with MUL, and
+ * reserved encodings, which map to HANDLER_INVALID.
+ */
+enum : uint8_t {
+    HANDLER_NOP = 0x20,
+    HANDLER_INVALID = 0x21,
+    HANDLER_RETI = 0x22,
+    HANDLER_WAIT = 0x23,
+    HANDLER_LOAD_INDIRECT = 0x24,
+    HANDLER_STORE_INDIRECT = 0x25,
+    HANDLER_MULH = 0x26,
+    HANDLER_DIV = 0x27,
+    HANDLER_MOD = 0x28,
+    HANDLER_COUNT = 0x29
+};
+
+/**
+ * DecodedOp - A predecoded SC8 instruction
+ * 
+ * Holds every field the execute phase needs, so the hot loop never
+ * goes back to memory for instruction bytes.
+ */
+struct DecodedOp {
+    uint8_t opcode;    // 5-bit opcode (byte 0, bits 7-3)
+    uint8_t rd;        // Rd / condition field (byte 0, bits 2-0)
+    uint8_t rs1;       // RR source 1 (byte 1, bits 7-5); indirect: pair base
+    uint8_t rs2;       // RR source 2 (byte 1, bits 4-2); indirect: post-increment
+    uint8_t imm;       // Immediate (byte 1)
+    uint8_t length;    // Instruction length in bytes (1-3)
+    uint8_t raw;       // Raw first byte (distinguishes HALT, NOP, RETI, WAIT)
+    uint8_t handler;   // Threaded-engine handler index
+    bool valid;        // Entry holds a current decode
+    uint16_t target;   // Absolute address / branch target (bytes 1-2);
+                       // indirect: signed offset in the high byte
+};
+
+/**
+ * DecodeCache class - Predecoded instruction array
+ * 
+ * One entry per address in the 64KB space. Entries are decoded the
+ * first time the CPU executes from an address and reused afterwards.
+ * Pages that hold decoded instructions are flagged as code pages in
+ * Memory; any write to such a page invalidates the entries that
+ * overlap the written bytes.
+ * 
+ * Instructions fetched from the I/O region (0xFF00-0xFFFF) are never
+ * cached because reading device registers may have side effects.
+ * 
+ * Once bound to a thread (setOwner), invalidations caused by writes
+ * from other threads (other cores) are queued instead of applied, and
+ * take effect when the owner calls applyPending().
+ */
+class DecodeCache : public MemoryWatcher {
+private:
+    Memory* memory;
+    std::vector<DecodedOp> ops;
+    DecodedOp io_op;   // Scratch entry for uncached I/O region fetches
+    
+    // Invalidations from other threads: (start, count) ranges
+    std::thread::id owner;     // Default id: unbound, apply in place
+    std::mutex pending_lock;
+    std::vector<std::pair<uint16_t, uint32_t> > pending;
+    std::atomic<bool> has_pending;
+    
+    void fill(uint16_t pc);
+    void invalidate(uint16_t start, uint32_t count);
+    void applyPendingSlow();
+    
+public:
+    DecodeCache(Memory* mem);
+    ~DecodeCache();
+    
+    // Get the decoded instruction at pc, decoding it if needed
+    const DecodedOp& lookup(uint16_t pc) {
+        const DecodedOp& op = ops[pc];
+        if (op.valid) {
+            return op;
+        }
+        fill(pc);
+        return pc >= 0xFF00 ? io_op : ops[pc];
+    }
+    
+    // Drop every cached entry
+    void clear();
+    
+    // MemoryWatcher interface
+    void onCodeModified(uint16_t start, uint32_t count);
+    
+    // Queue invalidations from threads other than `thread`
+    void setOwner(std::thread::id thread) { owner = thread; }
+    
+    // Apply the queued invalidations (owner thread only)
+    void applyPending() {
+        if (has_pending.load(std::memory_order_acquire)) {
+            applyPendingSlow();
+        }
+    }
+    
+    // Instruction length implied by an opcode
+    static uint8_t lengthOf(uint8_t opcode);
+    
+    // Decode raw instruction bytes
+    static DecodedOp decode(uint8_t byte0, uint8_t byte1, uint8_t byte2);
+};
+
+#endif // DECODE_CACHE_H
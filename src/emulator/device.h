@@ -0,0 +1,83 @@
+#ifndef DEVICE_H
+#define DEVICE_H
+
+#include <cstdint>
+#include "snapshot.h"
+
+/**
+ * Memory-mapped I/O register addresses
+ */
+enum IoRegister : uint16_t {
+    IO_TIMER_CTRL   = 0xFF00,
+    IO_CONSOLE_OUT  = 0xFF01,
+    IO_CONSOLE_IN   = 0xFF02,
+    IO_TIMER_VALUE  = 0xFF03,
+    IO_CONSOLE_STATUS = 0xFF04,
+    IO_CORE_ID      = 0xFF08,
+    IO_CORE_COUNT   = 0xFF09,
+    IO_PERF_SELECT  = 0xFF10,
+    IO_PERF_CTRL    = 0xFF11,
+    IO_PERF_DATA    = 0xFF12,    // Four bytes, 0xFF12-0xFF15
+    IO_INT_ENABLE   = 0xFF20,
+    IO_INT_MASK     = 0xFF21,
+    IO_INT_PENDING  = 0xFF22,
+    IO_DMA_SRC      = 0xFF30,    // Two bytes each, low byte first
+    IO_DMA_DST      = 0xFF32,
+    IO_DMA_LEN      = 0xFF34,
+    IO_DMA_CTRL     = 0xFF36,
+    IO_DMA_STATUS   = 0xFF37
+};
+
+/**
+ * Device - A memory-mapped I/O device
+ *
+ * Devices are attached to the Bus at one or more register addresses.
+ * Reads and writes to those addresses are routed to the device instead
+ * of RAM; the device receives the full 16-bit address.
+ */
+class Device {
+public:
+    virtual ~Device() {}
+
+    virtual uint8_t read(uint16_t address) = 0;
+    virtual void write(uint16_t address, uint8_t value) = 0;
+
+    // Return to the power-on state
+    virtual void reset() {}
+    
+    // Finish any buffered work (called when the CPU stops)
+    virtual void sync() {}
+    
+    // Registers whose reads depend on the host rather than on guest
+    // state, registers whose writes reach the host, and registers whose
+    // writes serve as replay checkpoints (see IoInterceptor)
+    virtual bool isHostInput(uint16_t) const { return false; }
+    virtual bool isHostOutput(uint16_t) const { return false; }
+    virtual bool isLoggedWrite(uint16_t) const { return false; }
+    
+    // Snapshots: a device with state writes it as its own section.
+    // restore() is called for every device; without a section of its
+    // own the device returns to the power-on state.
+    virtual void save(SnapshotWriter&) const {}
+    virtual bool restore(SnapshotReader&) { reset(); return true; }
+};
+
+/**
+ * IoInterceptor - Hook on the accesses that connect the guest to the host
+ *
+ * Installed on the Bus by record/replay (IoLog) and time travel
+ * (TimeTravel). It sees every read of a host-input register and every
+ * write to a host-output or logged-write register.
+ */
+class IoInterceptor {
+public:
+    virtual ~IoInterceptor() {}
+
+    // Returns the value the guest reads (normally device->read(address))
+    virtual uint8_t read(Device* device, uint16_t address) = 0;
+
+    // Returns false to drop the write instead of passing it to the device
+    virtual bool write(Device* device, uint16_t address, uint8_t value) = 0;
+};
+
+#endif // DEVICE_H
@@ -0,0 +1,159 @@
+#include "dma.h"
+#include "memory.h"
+
+namespace {
+
+// Transfers stay below the memory-mapped I/O region
+const uint32_t IO_REGION = 0xFF00;
+
+} // namespace
+
+DmaController::DmaController(Scheduler& sched, Memory& mem, InterruptController& irq)
+    : scheduler(sched), memory(mem), interrupts(irq), source(0), destination(0), length(0),
+      mode(MODE_COPY), status(0), deadline(0) {
+}
+
+bool DmaController::validRange() const {
+    uint32_t end = length;
+    if (mode != MODE_FILL && source + end > IO_REGION) {
+        return false;
+    }
+    return mode == MODE_CONSOLE || destination + end <= IO_REGION;
+}
+
+void DmaController::finish(uint8_t result) {
+    status = (status & ~STATUS_BUSY) | STATUS_DONE | result;
+    interrupts.raise(IRQ_DMA);
+}
+
+uint8_t DmaController::read(uint16_t address) {
+    switch (address) {
+        case IO_DMA_SRC:
+            return source & 0xFF;
+        case IO_DMA_SRC + 1:
+            return source >> 8;
+        case IO_DMA_DST:
+            return destination & 0xFF;
+        case IO_DMA_DST + 1:
+            return destination >> 8;
+        case IO_DMA_LEN:
+            return length & 0xFF;
+        case IO_DMA_LEN + 1:
+            return length >> 8;
+        case IO_DMA_CTRL:
+            return mode;
+        case IO_DMA_STATUS:
+            return status;
+        default:
+            return 0;
+    }
+}
+
+void DmaController::write(uint16_t address, uint8_t value) {
+    // The registers describe the transfer in flight
+    if ((status & STATUS_BUSY) && address != IO_DMA_STATUS) {
+        status |= STATUS_ERROR;
+        return;
+    }
+
+    switch (address) {
+        case IO_DMA_SRC:
+            source = (source & 0xFF00) | value;
+            break;
+        case IO_DMA_SRC + 1:
+            source = (source & 0x00FF) | (value << 8);
+            break;
+        case IO_DMA_DST:
+            destination = (destination & 0xFF00) | value;
+            break;
+        case IO_DMA_DST + 1:
+            destination = (destination & 0x00FF) | (value << 8);
+            break;
+        case IO_DMA_LEN:
+            length = (length & 0xFF00) | value;
+            break;
+        case IO_DMA_LEN + 1:
+            length = (length & 0x00FF) | (value << 8);
+            break;
+        case IO_DMA_CTRL:
+            mode = value & 0x03;
+            status &= ~(STATUS_DONE | STATUS_ERROR);
+            if (mode > MODE_CONSOLE || !validRange()) {
+                finish(STATUS_ERROR);
+                break;
+            }
+            status |= STATUS_BUSY;
+            deadline = scheduler.now() + SETUP_CYCLES +
+                static_cast<uint64_t>(length) * (mode == MODE_FILL ? 1 : 2);
+            scheduler.schedule(this, deadline);
+            break;
+        case IO_DMA_STATUS:
+            status &= ~(value & (STATUS_DONE | STATUS_ERROR));
+            break;
+        default:
+            break;
+    }
+}
+
+void DmaController::reset() {
+    source = 0;
+    destination = 0;
+    length = 0;
+    mode = MODE_COPY;
+    status = 0;
+    deadline = 0;
+    scheduler.cancel(this);
+}
+
+void DmaController::save(SnapshotWriter& snapshot) const {
+    snapshot.beginSection("DMAC");
+    snapshot.putU16(source);
+    snapshot.putU16(destination);
+    snapshot.putU16(length);
+    snapshot.putU8(mode);
+    snapshot.putU8(status);
+    snapshot.putU64(deadline);
+    snapshot.endSection();
+}
+
+bool DmaController::restore(SnapshotReader& snapshot) {
+    reset();
+    if (!snapshot.enterSection("DMAC")) {
+        return true;
+    }
+    source = snapshot.getU16();
+    destination = snapshot.getU16();
+    length = snapshot.getU16();
+    mode = snapshot.getU8() & 0x03;
+    status = snapshot.getU8() & (STATUS_BUSY | STATUS_DONE | STATUS_ERROR);
+    deadline = snapshot.getU64();
+    if (!snapshot.good() || ((status & STATUS_BUSY) && (mode > MODE_CONSOLE || !validRange()))) {
+        reset();
+        return false;
+    }
+
+    // The deadline is absolute, so a transfer in flight completes on time
+    if (status & STATUS_BUSY) {
+        scheduler.schedule(this, deadline);
+    }
+    return true;
+}
+
+void DmaController::onEvent(uint64_t) {
+    switch (mode) {
+        case MODE_COPY:
+            memory.copyBlock(destination, source, length);
+            break;
+        case MODE_FILL:
+            memory.fillBlock(destination, source & 0xFF, length);
+            break;
+        case MODE_CONSOLE:
+            // Through the bus, so console sinks and record/replay see
+            // ordinary CONSOLE_OUT writes
+            for (uint32_t i = 0; i < length; i++) {
+                memory.write(IO_CONSOLE_OUT, memory.read(source + i));
+            }
+            break;
+    }
+    finish(0);
+}
@@ -0,0 +1,88 @@
+#ifndef DMA_H
+#define DMA_H
+
+#include <cstdint>
+#include "device.h"
+#include "interrupt_controller.h"
+#include "scheduler.h"
+
+class Memory;
+
+/**
+ * DmaController class - Block copy, fill and console output
+ *
+ * Registers:
+ * 0xFF30 DMA_SRC     Source address (low byte first); in fill mode
+ *  -0xFF31           the low byte is the fill value
+ * 0xFF32 DMA_DST     Destination address (low byte first)
+ *  -0xFF33
+ * 0xFF34 DMA_LEN     Byte count (low byte first)
+ *  -0xFF35
+ * 0xFF36 DMA_CTRL    Write: start a transfer, bits 0-1 select the mode
+ *                    (0 copy, 1 fill, 2 copy to CONSOLE_OUT).
+ *                    Read: the last mode written
+ * 0xFF37 DMA_STATUS  Bit 0: busy, bit 1: done, bit 2: error.
+ *                    Writing 1 to done or error clears it
+ *
+ * A transfer runs alongside the CPU and completes SETUP_CYCLES plus
+ * one cycle per byte moved over the bus later (two per byte when the
+ * block is read as well as written). It then takes effect all at
+ * once: the host moves the block with memmove/memset, or writes the
+ * bytes to CONSOLE_OUT through the bus, sets done and raises IRQ_DMA.
+ * The guest must leave the block alone and keep running (WAIT or poll
+ * DMA_STATUS) until then; a transfer still busy when the CPU halts is
+ * lost.
+ *
+ * The blocks must lie below the I/O region. Starting a transfer with a
+ * block outside it or an unknown mode transfers nothing and completes
+ * at once with the error bit set. While busy, writes to any register
+ * but DMA_STATUS are ignored and only set the error bit.
+ *
+ * The address registers keep their values, so repeating a transfer
+ * only takes another DMA_CTRL write.
+ */
+class DmaController : public Device, public EventHandler {
+public:
+    enum Mode : uint8_t {
+        MODE_COPY = 0,
+        MODE_FILL = 1,
+        MODE_CONSOLE = 2
+    };
+
+    // DMA_STATUS bits
+    static const uint8_t STATUS_BUSY = 0x01;
+    static const uint8_t STATUS_DONE = 0x02;
+    static const uint8_t STATUS_ERROR = 0x04;
+
+    // Cycles from DMA_CTRL write to the first byte
+    static const uint64_t SETUP_CYCLES = 4;
+
+private:
+    Scheduler& scheduler;
+    Memory& memory;
+    InterruptController& interrupts;
+    uint16_t source;
+    uint16_t destination;
+    uint16_t length;
+    uint8_t mode;
+    uint8_t status;
+    uint64_t deadline;      // Completion cycle while busy
+
+    bool validRange() const;
+    void finish(uint8_t result);
+
+public:
+    DmaController(Scheduler& sched, Memory& mem, InterruptController& irq);
+
+    // Device interface
+    uint8_t read(uint16_t address);
+    void write(uint16_t address, uint8_t value);
+    void reset();
+    void save(SnapshotWriter& snapshot) const;
+    bool restore(SnapshotReader& snapshot);
+
+    // EventHandler interface (transfer complete)
+    void onEvent(uint64_t deadline);
+};
+
+#endif // DMA_H
@@ -0,0 +1,136 @@
+#include "interrupt_controller.h"
+#include "bus.h"
+#include "console.h"
+
+InterruptController::InterruptController(Scheduler& sched, Bus& io_bus)
+    : scheduler(sched), bus(io_bus), enable(0), mask(0xFF), pending(0), in_service(false),
+      lock(nullptr) {
+}
+
+bool InterruptController::polling() const {
+    uint8_t console = 1 << IRQ_CONSOLE;
+    return !(mask & console) && !(pending & console);
+}
+
+void InterruptController::update() {
+    if (requesting()) {
+        // Noticed at the next instruction boundary
+        scheduler.schedule(this, scheduler.now());
+    } else if (polling()) {
+        scheduler.schedule(this, scheduler.now() + POLL_INTERVAL);
+    } else {
+        scheduler.cancel(this);
+    }
+}
+
+std::unique_lock<std::recursive_mutex> InterruptController::lockShared() {
+    return lock ? std::unique_lock<std::recursive_mutex>(*lock) : std::unique_lock<std::recursive_mutex>();
+}
+
+void InterruptController::raise(InterruptSource source) {
+    pending |= 1 << source;
+    update();
+}
+
+int InterruptController::acknowledge() {
+    std::unique_lock<std::recursive_mutex> guard = lockShared();
+    if (!requesting()) {
+        return NONE;
+    }
+    int source = 0;
+    while (!(unmasked() & (1 << source))) {
+        source++;
+    }
+    pending &= ~(1 << source);
+    in_service = true;
+    update();
+    return source;
+}
+
+void InterruptController::endOfInterrupt() {
+    std::unique_lock<std::recursive_mutex> guard = lockShared();
+    in_service = false;
+    update();
+}
+
+bool InterruptController::isWaking() {
+    std::unique_lock<std::recursive_mutex> guard = lockShared();
+    return unmasked() != 0;
+}
+
+uint8_t InterruptController::read(uint16_t address) {
+    switch (address) {
+        case IO_INT_ENABLE:
+            return enable;
+        case IO_INT_MASK:
+            return mask;
+        case IO_INT_PENDING:
+            return pending;
+        default:
+            return 0;
+    }
+}
+
+void InterruptController::write(uint16_t address, uint8_t value) {
+    switch (address) {
+        case IO_INT_ENABLE:
+            enable = value & 0x01;
+            break;
+        case IO_INT_MASK:
+            mask = value;
+            break;
+        case IO_INT_PENDING:
+            pending &= ~value;
+            break;
+        default:
+            return;
+    }
+    update();
+}
+
+void InterruptController::reset() {
+    enable = 0;
+    mask = 0xFF;
+    pending = 0;
+    in_service = false;
+    scheduler.cancel(this);
+}
+
+void InterruptController::save(SnapshotWriter& snapshot) const {
+    snapshot.beginSection("INTC");
+    snapshot.putU8(enable);
+    snapshot.putU8(mask);
+    snapshot.putU8(pending);
+    snapshot.putU8(in_service);
+    snapshot.endSection();
+}
+
+bool InterruptController::restore(SnapshotReader& snapshot) {
+    reset();
+    if (!snapshot.enterSection("INTC")) {
+        return true;
+    }
+    enable = snapshot.getU8() & 0x01;
+    mask = snapshot.getU8();
+    pending = snapshot.getU8();
+    in_service = snapshot.getU8() != 0;
+    if (!snapshot.good()) {
+        reset();
+        return false;
+    }
+
+    // Console sampling restarts from the restored cycle
+    update();
+    return true;
+}
+
+void InterruptController::onEvent(uint64_t) {
+    // The CPU checks for a request as soon as the due events have run,
+    // so only console sampling needs another event
+    if (polling() && (bus.read(IO_CONSOLE_STATUS) & Console::STATUS_INPUT_READY)) {
+        pending |= 1 << IRQ_CONSOLE;
+    }
+    if (polling()) {
+        scheduler.schedule(this, scheduler.now() + POLL_INTERVAL);
+    }
+}
@@ -0,0 +1,108 @@
+#ifndef INTERRUPT_CONTROLLER_H
+#define INTERRUPT_CONTROLLER_H
+
+#include <cstdint>
+#include <mutex>
+#include "device.h"
+#include "scheduler.h"
+
+class Bus;
+
+/**
+ * Interrupt sources: bit numbers in INT_MASK and INT_PENDING, and
+ * priority order (lowest number first)
+ */
+enum InterruptSource : uint8_t {
+    IRQ_TIMER = 0,      // Timer countdown reached zero
+    IRQ_CONSOLE = 1,    // Console input ready
+    IRQ_DMA = 2,        // DMA transfer complete
+    IRQ_COUNT
+};
+
+/**
+ * InterruptController class - Vectored interrupts for core 0
+ *
+ * Registers:
+ * 0xFF20 INT_ENABLE   Bit 0: interrupts enabled (clear at reset)
+ * 0xFF21 INT_MASK     Bit per source, 1 = masked (all masked at reset)
+ * 0xFF22 INT_PENDING  Bit per source that has raised a request.
+ *                     Writing 1 to a bit clears it
+ *
+ * Sources latch their pending bit even while masked. The controller
+ * requests an interrupt while it is enabled, no handler is running and
+ * an unmasked source is pending; the lowest-numbered one wins. The CPU
+ * takes the request between instructions: acknowledge() clears the
+ * source's pending bit and holds off further requests until RETI calls
+ * endOfInterrupt(), so handlers never nest. The handler for source n
+ * starts at the little-endian word stored at 0x0000 + 2n.
+ *
+ * The timer raises its source when the countdown expires and the DMA
+ * controller when a transfer completes. Console input has no event of
+ * its own, so while its source is unmasked the controller samples
+ * CONSOLE_STATUS through the bus every POLL_INTERVAL cycles;
+ * record/replay and time travel see the samples as ordinary host-input
+ * reads.
+ *
+ * The execution engines only stop at scheduler deadlines. A request
+ * that appears outside an event (a register write, RETI) therefore
+ * schedules an event for the current cycle, and the CPU checks for
+ * requests after every batch of events (CPU::serviceEvents).
+ *
+ * The CPU-side calls take the shared lock when several cores share
+ * the memory; register accesses already hold it (see Bus).
+ */
+class InterruptController : public Device, public EventHandler {
+public:
+    // Cycles between console input samples
+    static const uint64_t POLL_INTERVAL = 64;
+
+    // acknowledge() when nothing is requested
+    static const int NONE = -1;
+
+private:
+    Scheduler& scheduler;
+    Bus& bus;
+    uint8_t enable;
+    uint8_t mask;
+    uint8_t pending;
+    bool in_service;            // A handler is running (until RETI)
+    std::recursive_mutex* lock; // Shared with the Bus, or nullptr
+
+    uint8_t unmasked() const { return pending & ~mask; }
+    bool requesting() const { return (enable & 0x01) && !in_service && unmasked(); }
+    bool polling() const;
+    void update();
+    std::unique_lock<std::recursive_mutex> lockShared();
+
+public:
+    InterruptController(Scheduler& sched, Bus& io_bus);
+
+    // Latch a request from a device
+    void raise(InterruptSource source);
+
+    // CPU side: take the winning request (its source, or NONE), and
+    // finish its handler
+    int acknowledge();
+    void endOfInterrupt();
+
+    // An unmasked source is pending (ends WAIT whether or not
+    // interrupts are enabled)
+    bool isWaking();
+
+    // Address of the vector for a source
+    static uint16_t vectorAddress(int source) { return static_cast<uint16_t>(2 * source); }
+
+    void setLock(std::recursive_mutex* mutex) { lock = mutex; }
+
+    // Device interface
+    uint8_t read(uint16_t address);
+    void write(uint16_t address, uint8_t value);
+    void reset();
+    void save(SnapshotWriter& snapshot) const;
+    bool restore(SnapshotReader& snapshot);
+
+    // EventHandler interface (console sample, or a request to notice)
+    void onEvent(uint64_t deadline);
+};
+
+#endif // INTERRUPT_CONTROLLER_H
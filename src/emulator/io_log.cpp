@@ -0,0 +1,297 @@
+#include "io_log.h"
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+const char IO_LOG_MAGIC[8] = { 'S', 'C', '8', 'I', 'O', 'L', 'O', 'G' };
+const uint32_t IO_LOG_VERSION = 1;
+
+// Record tags
+const uint8_t TAG_WRITE = 0x01;
+const uint8_t TAG_SAME_ADDRESS = 0x02;
+const uint8_t TAG_REPEAT = 0x80;
+const uint8_t TAG_END = 0xFF;
+
+} // namespace
+
+IoLog::IoLog(Scheduler& sched)
+    : scheduler(sched), mode(Mode::Off), last_cycle(0), last_address(0),
+      has_pending(false), repeats(0), position(0), current_repeats(0), diverged(false) {
+}
+
+bool IoLog::startRecording(const std::string& file) {
+    path = file;
+    out.open(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        std::cerr << "Error: Cannot create I/O log '" << path << "'" << std::endl;
+        return false;
+    }
+    out.write(IO_LOG_MAGIC, sizeof(IO_LOG_MAGIC));
+    for (int i = 0; i < 4; i++) {
+        out.put(static_cast<char>((IO_LOG_VERSION >> (8 * i)) & 0xFF));
+    }
+
+    mode = Mode::Record;
+    last_cycle = scheduler.now();
+    last_address = 0;
+    has_pending = false;
+    repeats = 0;
+    return true;
+}
+
+bool IoLog::startReplay(const std::string& file) {
+    path = file;
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        std::cerr << "Error: Cannot open I/O log '" << path << "'" << std::endl;
+        return false;
+    }
+    std::ostringstream contents;
+    contents << in.rdbuf();
+    std::string bytes = contents.str();
+    data.assign(bytes.begin(), bytes.end());
+
+    if (data.size() < sizeof(IO_LOG_MAGIC) + 4 ||
+        std::memcmp(data.data(), IO_LOG_MAGIC, sizeof(IO_LOG_MAGIC)) != 0) {
+        std::cerr << "Error: '" << path << "' is not an SC8 I/O log" << std::endl;
+        return false;
+    }
+    uint32_t version = 0;
+    for (int i = 0; i < 4; i++) {
+        version |= static_cast<uint32_t>(data[sizeof(IO_LOG_MAGIC) + i]) << (8 * i);
+    }
+    if (version == 0 || version > IO_LOG_VERSION) {
+        std::cerr << "Error: I/O log '" << path << "' has unsupported version "
+                  << version << std::endl;
+        return false;
+    }
+
+    mode = Mode::Replay;
+    position = sizeof(IO_LOG_MAGIC) + 4;
+    last_cycle = scheduler.now();
+    last_address = 0;
+    current_repeats = 0;
+    diverged = false;
+    return true;
+}
+
+bool IoLog::finish() {
+    bool ok = true;
+    if (mode == Mode::Record) {
+        flushPending();
+        out.put(static_cast<char>(TAG_END));
+        writeVarint(scheduler.now() - last_cycle);
+        out.close();
+        if (!out) {
+            std::cerr << "Error: Failed to write I/O log '" << path << "'" << std::endl;
+            ok = false;
+        }
+    } else if (mode == Mode::Replay && !diverged) {
+        // The run must stop where the recording stopped
+        uint64_t delta;
+        if (current_repeats > 0 || position >= data.size() || data[position] != TAG_END) {
+            reportDivergence("run ended before the end of the log");
+        } else if (position++, !readVarint(delta)) {
+            reportDivergence("log is truncated");
+        } else if (last_cycle + delta != scheduler.now()) {
+            std::ostringstream reason;
+            reason << "run ended at cycle " << scheduler.now()
+                   << ", recording ended at cycle " << last_cycle + delta;
+            reportDivergence(reason.str());
+        }
+    }
+    ok = ok && !diverged;
+    mode = Mode::Off;
+    return ok;
+}
+
+uint8_t IoLog::read(Device* device, uint16_t address) {
+    if (mode == Mode::Replay) {
+        uint8_t value;
+        if (expect(address, false, value)) {
+            return value;
+        }
+        return device->read(address);
+    }
+
+    uint8_t value = device->read(address);
+    if (mode == Mode::Record) {
+        append(address, value, false);
+    }
+    return value;
+}
+
+bool IoLog::write(Device* device, uint16_t address, uint8_t value) {
+    if (!device->isLoggedWrite(address)) {
+        return true;  // Host output is not input; it needs no log
+    }
+    if (mode == Mode::Record) {
+        append(address, value, true);
+    } else if (mode == Mode::Replay) {
+        uint8_t logged;
+        if (expect(address, true, logged) && logged != value) {
+            std::ostringstream reason;
+            reason << "guest wrote 0x" << std::hex << static_cast<int>(value)
+                   << " to 0x" << address << ", log has 0x" << static_cast<int>(logged);
+            reportDivergence(reason.str());
+        }
+    }
+    return true;
+}
+
+// Recording
+
+void IoLog::append(uint16_t address, uint8_t value, bool write) {
+    uint64_t now = scheduler.now();
+    Entry entry;
+    entry.delta = now - last_cycle;
+    entry.address = address;
+    entry.value = value;
+    entry.write = write;
+    last_cycle = now;
+
+    if (has_pending && entry.delta == pending.delta && entry.address == pending.address &&
+        entry.value == pending.value && entry.write == pending.write) {
+        repeats++;
+        return;
+    }
+    flushPending();
+    pending = entry;
+    has_pending = true;
+}
+
+void IoLog::flushPending() {
+    if (!has_pending) {
+        return;
+    }
+    writeEntry(pending);
+    if (repeats > 0) {
+        out.put(static_cast<char>(TAG_REPEAT));
+        writeVarint(repeats);
+    }
+    has_pending = false;
+    repeats = 0;
+}
+
+void IoLog::writeEntry(const Entry& entry) {
+    uint8_t tag = entry.write ? TAG_WRITE : 0;
+    if (entry.address == last_address) {
+        tag |= TAG_SAME_ADDRESS;
+    }
+    out.put(static_cast<char>(tag));
+    writeVarint(entry.delta);
+    if (!(tag & TAG_SAME_ADDRESS)) {
+        out.put(static_cast<char>(entry.address & 0xFF));
+        out.put(static_cast<char>(entry.address >> 8));
+    }
+    out.put(static_cast<char>(entry.value));
+    last_address = entry.address;
+}
+
+void IoLog::writeVarint(uint64_t value) {
+    while (value >= 0x80) {
+        out.put(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.put(static_cast<char>(value));
+}
+
+// Replay
+
+bool IoLog::readVarint(uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (position >= data.size()) {
+            return false;
+        }
+        uint8_t byte = data[position++];
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool IoLog::nextEntry() {
+    if (current_repeats > 0) {
+        return true;
+    }
+    if (position >= data.size()) {
+        return false;
+    }
+
+    uint8_t tag = data[position];
+    if (tag == TAG_END) {
+        return false;
+    }
+    position++;
+
+    if (tag == TAG_REPEAT) {
+        // More copies of the entry just delivered
+        return readVarint(current_repeats) && current_repeats > 0;
+    }
+    if (tag & ~(TAG_WRITE | TAG_SAME_ADDRESS)) {
+        return false;
+    }
+
+    current.write = (tag & TAG_WRITE) != 0;
+    if (!readVarint(current.delta)) {
+        return false;
+    }
+    if (tag & TAG_SAME_ADDRESS) {
+        current.address = last_address;
+    } else {
+        if (position + 2 > data.size()) {
+            return false;
+        }
+        current.address = data[position] | (data[position + 1] << 8);
+        position += 2;
+    }
+    if (position >= data.size()) {
+        return false;
+    }
+    current.value = data[position++];
+    last_address = current.address;
+    current_repeats = 1;
+    return true;
+}
+
+bool IoLog::expect(uint16_t address, bool write, uint8_t& value) {
+    if (diverged) {
+        return false;
+    }
+
+    uint64_t now = scheduler.now();
+    if (!nextEntry()) {
+        std::ostringstream reason;
+        reason << "guest accessed 0x" << std::hex << address << " past the end of the log";
+        reportDivergence(reason.str());
+        return false;
+    }
+    if (current.address != address || current.write != write ||
+        last_cycle + current.delta != now) {
+        std::ostringstream reason;
+        reason << "guest " << (write ? "wrote" : "read") << " 0x" << std::hex << address
+               << std::dec << ", log has a " << (current.write ? "write to" : "read of")
+               << " 0x" << std::hex << current.address << std::dec
+               << " at cycle " << last_cycle + current.delta;
+        reportDivergence(reason.str());
+        return false;
+    }
+
+    current_repeats--;
+    last_cycle = now;
+    value = current.value;
+    return true;
+}
+
+void IoLog::reportDivergence(const std::string& reason) {
+    if (!diverged) {
+        std::cerr << "Error: Replay diverged at cycle " << scheduler.now()
+                  << ": " << reason << std::endl;
+    }
+    diverged = true;
+}
@@ -0,0 +1,103 @@
+#ifndef IO_LOG_H
+#define IO_LOG_H
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "device.h"
+#include "scheduler.h"
+
+/**
+ * IoLog class - Deterministic record/replay of device I/O
+ *
+ * Everything the guest computes follows from the program image and
+ * the values it reads from devices. Devices mark the registers whose
+ * reads depend on the host (Device::isHostInput, e.g. CONSOLE_IN and
+ * CONSOLE_STATUS); while recording, the Bus passes each such read
+ * through the log, and while replaying the logged value is returned
+ * without touching the device, so replay never waits for real input.
+ *
+ * Registers marked with Device::isLoggedWrite (e.g. TIMER_CTRL) are
+ * logged as checkpoints. Replay checks that the guest writes the same
+ * value on the same cycle, so a divergent replay is reported at the
+ * first access that differs rather than by its final state.
+ *
+ * Log format (version 1): the magic "SC8IOLOG", a 4-byte little-endian
+ * version, then one record per access:
+ *   tag byte      bit 0: write, bit 1: same address as the last record,
+ *                 0x80: repeat, 0xFF: end of log
+ *   cycle delta   LEB128, cycles since the previous record
+ *   address       2 bytes little-endian, unless bit 1 is set
+ *   value         1 byte
+ * A repeat record (tag 0x80, LEB128 count) stands for `count` copies of
+ * the previous record, which keeps guest polling loops to a few bytes.
+ * The end record carries the cycle delta to the end of the run.
+ */
+class IoLog : public IoInterceptor {
+public:
+    enum class Mode { Off, Record, Replay };
+
+private:
+    struct Entry {
+        uint64_t delta;     // Cycles since the previous entry
+        uint16_t address;
+        uint8_t value;
+        bool write;
+    };
+
+    Scheduler& scheduler;   // Cycle source
+    Mode mode;
+    std::string path;
+
+    // Position in the cycle-delta chain
+    uint64_t last_cycle;
+    uint16_t last_address;
+
+    // Record: the last entry is held back until it stops repeating
+    std::ofstream out;
+    Entry pending;
+    bool has_pending;
+    uint64_t repeats;
+
+    // Replay: the whole log, decoded one entry at a time
+    std::vector<uint8_t> data;
+    size_t position;
+    Entry current;
+    uint64_t current_repeats;   // Copies of `current` still to deliver
+    bool diverged;
+
+    void writeEntry(const Entry& entry);
+    void writeVarint(uint64_t value);
+    void flushPending();
+    void append(uint16_t address, uint8_t value, bool write);
+
+    bool readVarint(uint64_t& value);
+    bool nextEntry();
+    bool expect(uint16_t address, bool write, uint8_t& value);
+    void reportDivergence(const std::string& reason);
+
+    IoLog(const IoLog&);
+    IoLog& operator=(const IoLog&);
+
+public:
+    IoLog(Scheduler& sched);
+
+    bool startRecording(const std::string& file);
+    bool startReplay(const std::string& file);
+
+    // Close the log at the end of a run. Recording writes the end
+    // record; replay checks that the whole log was consumed. Returns
+    // false if the log could not be written or the replay diverged.
+    bool finish();
+
+    Mode getMode() const { return mode; }
+    bool hasDiverged() const { return diverged; }
+
+    // IoInterceptor interface
+    uint8_t read(Device* device, uint16_t address);
+    bool write(Device* device, uint16_t address, uint8_t value);
+};
+
+#endif // IO_LOG_H
@@ -0,0 +1,579 @@
+#include "jit.h"
+#include "cpu.h"
+#include <algorithm>
+#include <iostream>
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__linux__) || defined(__APPLE__))
+#define SC8_JIT_X86_64 1
+#include <sys/mman.h>
+#else
+#define SC8_JIT_X86_64 0
+#endif
+
+namespace {
+
+const size_t CODE_BUFFER_SIZE = 4 * 1024 * 1024;
+const size_t MAX_BLOCK_BYTES = 8 * 1024;   // Worst case for one block
+const int MAX_BLOCK_OPS = 64;
+
+// Marks a guest PC whose first instruction cannot be translated
+uint8_t* const NO_BLOCK = reinterpret_cast<uint8_t*>(1);
+
+// Displacements into JitContext used by generated code
+const uint8_t CTX_BUDGET = offsetof(JitContext, budget);
+const uint8_t CTX_EXIT_PC = offsetof(JitContext, exit_pc);
+
+// helperIndirect: the address is on a device page, nothing was executed
+const uint8_t HELPER_DEVICE = 2;
+
+typedef void (*EntryFunction)(JitContext* ctx, uint8_t* registers, uint8_t* flags,
+                              const uint8_t* ram, uint8_t* block);
+
+bool isBlockEnd(uint8_t opcode) {
+    return opcode >= 0x18 && opcode <= 0x1E;  // JMP, Jcc, CALL, RET
+}
+
+} // namespace
+
+Jit::Jit(CPU* owner, Memory* mem)
+    : cpu(owner), memory(mem), buffer(nullptr), buffer_size(0), used(0),
+      code(nullptr), entry(nullptr), epilogue(nullptr), block_area(nullptr),
+      blocks(65536, nullptr), flush_pending(false) {
+    std::memset(jit_pages, 0, sizeof(jit_pages));
+    context.budget = 0;
+    context.cpu = owner;
+    context.jit = this;
+    context.exit_pc = 0;
+
+#if SC8_JIT_X86_64
+    void* mapping = mmap(nullptr, CODE_BUFFER_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+        std::cerr << "Warning: Cannot allocate JIT code buffer" << std::endl;
+        return;
+    }
+    buffer = static_cast<uint8_t*>(mapping);
+    buffer_size = CODE_BUFFER_SIZE;
+    code = buffer;
+
+    // Entry trampoline: (ctx=rdi, registers=rsi, flags=rdx, ram=rcx, block=r8)
+    entry = code;
+    static const uint8_t prologue[] = {
+        0x53,                   // push rbx
+        0x41, 0x54,             // push r12
+        0x41, 0x55,             // push r13
+        0x41, 0x56,             // push r14
+        0x41, 0x57,             // push r15 (keeps rsp 16-byte aligned)
+        0x49, 0x89, 0xFE,       // mov r14, rdi   ; context
+        0x48, 0x89, 0xF3,       // mov rbx, rsi   ; guest registers
+        0x49, 0x89, 0xD4,       // mov r12, rdx   ; guest flags
+        0x49, 0x89, 0xCD,       // mov r13, rcx   ; guest RAM
+        0x41, 0xFF, 0xE0        // jmp r8         ; block
+    };
+    emitBytes(prologue, sizeof(prologue));
+
+    epilogue = code;
+    static const uint8_t restore[] = {
+        0x41, 0x5F,             // pop r15
+        0x41, 0x5E,             // pop r14
+        0x41, 0x5D,             // pop r13
+        0x41, 0x5C,             // pop r12
+        0x5B,                   // pop rbx
+        0xC3                    // ret
+    };
+    emitBytes(restore, sizeof(restore));
+    block_area = code;
+    used = code - buffer;
+
+    memory->addWatcher(this);
+#endif
+}
+
+Jit::~Jit() {
+#if SC8_JIT_X86_64
+    if (buffer) {
+        memory->removeWatcher(this);
+        munmap(buffer, buffer_size);
+    }
+#endif
+}
+
+bool Jit::isSupported() {
+    return SC8_JIT_X86_64 != 0;
+}
+
+void Jit::run() {
+    CPU& c = *cpu;
+    const uint8_t* ram = memory->getRawMemory();
+    EntryFunction enter = reinterpret_cast<EntryFunction>(entry);
+
+    while (!c.halted) {
+        if (c.pc >= 0xFF00 || c.cycle_count > c.cycle_limit) {
+            return;
+        }
+        if (flush_pending) {
+            flush();
+        }
+
+        uint8_t* block = lookupBlock(c.pc);
+        if (block) {
+            // Blocks only start when the whole block fits in the budget,
+            // so device events are never overshot
+            uint64_t limit = std::min<uint64_t>(c.cycle_limit + 1, c.scheduler->nextDeadline());
+            int64_t budget = limit > c.cycle_count ? static_cast<int64_t>(limit - c.cycle_count) : 0;
+            context.budget = budget;
+            context.exit_pc = c.pc;
+
+            enter(&context, c.registers, &c.flags, ram, block);
+
+            uint64_t retired = static_cast<uint64_t>(budget - context.budget);
+            c.pc = context.exit_pc;
+            if (retired > 0) {
+                c.cycle_count += retired;
+                c.serviceEvents();
+                continue;
+            }
+        }
+
+        // No block, or not enough budget left for it: interpret one instruction
+        c.runThreaded(1);
+    }
+}
+
+void Jit::onCodeModified(uint16_t start, uint32_t count) {
+    uint32_t first_page = start >> 8;
+    uint32_t last_page = (start + count - 1) >> 8;
+    for (uint32_t page = first_page; page <= last_page && page < 256; page++) {
+        if (jit_pages[page]) {
+            flush_pending = true;
+            return;
+        }
+    }
+}
+
+uint8_t* Jit::lookupBlock(uint16_t pc) {
+    uint8_t* block = blocks[pc];
+    if (block == NO_BLOCK) {
+        return nullptr;
+    }
+    if (block) {
+        return block;
+    }
+
+    if (used + MAX_BLOCK_BYTES > buffer_size) {
+        flush();
+    }
+    block = translate(pc);
+    blocks[pc] = block ? block : NO_BLOCK;
+    return block;
+}
+
+bool Jit::isTranslatable(const DecodedOp& op) const {
+    switch (op.handler) {
+        case 0x10: // LOAD
+        case 0x11: // STORE
+            // Device pages go through the interpreter; translated loads
+            // read guest RAM directly
+            return memory->isRamPage(op.target >> 8);
+        case 0x17: // CAS (atomic, see Bus::compareExchange)
+        case 0x1F: // HALT
+        case HANDLER_RETI:
+        case HANDLER_WAIT:
+        case HANDLER_INVALID:
+            return false;
+        default:
+            return true;
+    }
+}
+
+uint8_t* Jit::translate(uint16_t start_pc) {
+    // Collect the block's instructions
+    std::vector<const DecodedOp*> ops;
+    uint32_t pc = start_pc;
+    while (ops.size() < static_cast<size_t>(MAX_BLOCK_OPS)) {
+        // Never decode ahead into the I/O region (reads may have side effects)
+        if (pc + 3 > 0xFF00) {
+            break;
+        }
+        const DecodedOp& op = cpu->decode_cache.lookup(static_cast<uint16_t>(pc));
+        if (!isTranslatable(op)) {
+            break;
+        }
+        ops.push_back(&op);
+        jit_pages[pc >> 8] = 1;
+        jit_pages[(pc + op.length - 1) >> 8] = 1;
+        pc += op.length;
+        if (isBlockEnd(op.opcode)) {
+            break;
+        }
+    }
+    if (ops.empty()) {
+        return nullptr;
+    }
+
+    uint8_t* block = code;
+    int count = static_cast<int>(ops.size());
+
+    // Budget check: bail out before running anything if it would overrun
+    emit8(0x49); emit8(0x81); emit8(0x7E); emit8(CTX_BUDGET);   // cmp qword [r14+budget], count
+    emit32(count);
+    emit8(0x0F); emit8(0x8C);                                   // jl bail
+    uint8_t* bail_jump = code;
+    emit32(0);
+    emit8(0x49); emit8(0x81); emit8(0x6E); emit8(CTX_BUDGET);   // sub qword [r14+budget], count
+    emit32(count);
+
+    pc = start_pc;
+    for (int i = 0; i < count; i++) {
+        uint16_t next_pc = static_cast<uint16_t>(pc + ops[i]->length);
+        emitOp(*ops[i], next_pc, count - i - 1);
+        pc = next_pc;
+    }
+    if (!isBlockEnd(ops.back()->opcode)) {
+        emitExit(static_cast<uint16_t>(pc));
+    }
+
+    // Bail stub: leave with PC at the block start and nothing retired
+    uint8_t* bail = code;
+    int32_t rel = static_cast<int32_t>(bail - (bail_jump + 4));
+    std::memcpy(bail_jump, &rel, 4);
+    emitUnchainedExit(start_pc);
+
+    used = code - buffer;
+
+    // Chain every exit that was waiting for this block
+    std::map<uint16_t, std::vector<uint8_t*> >::iterator waiting = links.find(start_pc);
+    if (waiting != links.end()) {
+        for (size_t i = 0; i < waiting->second.size(); i++) {
+            emitJumpTo(waiting->second[i], block);
+        }
+        links.erase(waiting);
+    }
+
+    return block;
+}
+
+void Jit::flush() {
+    code = block_area;
+    used = code - buffer;
+
+    std::fill(blocks.begin(), blocks.end(), static_cast<uint8_t*>(nullptr));
+    links.clear();
+    op_copies.clear();
+    std::memset(jit_pages, 0, sizeof(jit_pages));
+    flush_pending = false;
+}
+
+void Jit::emitOp(const DecodedOp& op, uint16_t next_pc, int remaining) {
+    uint8_t rd = op.rd;
+    uint8_t rs1 = op.rs1;
+    uint8_t rs2 = op.rs2;
+
+    // Register-register ALU ops: mov al, [rbx+rs1]; <op> al, [rbx+rs2]
+    // Register-immediate ALU ops: mov al, [rbx+rd]; <op> al, imm
+    switch (op.handler) {
+        case 0x00:   // ADD
+        case 0x02:   // SUB
+        case 0x07:   // AND
+        case 0x09:   // OR
+        case 0x0B: { // XOR
+            uint8_t alu_op = 0x02;                       // add r8, r/m8
+            if (op.handler == 0x02) alu_op = 0x2A;       // sub
+            if (op.handler == 0x07) alu_op = 0x22;       // and
+            if (op.handler == 0x09) alu_op = 0x0A;       // or
+            if (op.handler == 0x0B) alu_op = 0x32;       // xor
+            emit8(0x8A); emit8(0x43); emit8(rs1);        // mov al, [rbx+rs1]
+            emit8(alu_op); emit8(0x43); emit8(rs2);      // <op> al, [rbx+rs2]
+            emitStoreFlags();
+            emit8(0x88); emit8(0x43); emit8(rd);         // mov [rbx+rd], al
+            break;
+        }
+        case 0x01:   // ADDI
+        case 0x03:   // SUBI
+        case 0x08:   // ANDI
+        case 0x0A:   // ORI
+        case 0x05:   // INC
+        case 0x06: { // DEC
+            uint8_t alu_op = 0x04;                       // add al, imm8
+            uint8_t imm = op.imm;
+            if (op.handler == 0x03) alu_op = 0x2C;       // sub
+            if (op.handler == 0x08) alu_op = 0x24;       // and
+            if (op.handler == 0x0A) alu_op = 0x0C;       // or
+            if (op.handler == 0x05) imm = 1;
+            if (op.handler == 0x06) { alu_op = 0x2C; imm = 1; }
+            emit8(0x8A); emit8(0x43); emit8(rd);         // mov al, [rbx+rd]
+            emit8(alu_op); emit8(imm);                   // <op> al, imm
+            emitStoreFlags();
+            emit8(0x88); emit8(0x43); emit8(rd);         // mov [rbx+rd], al
+            break;
+        }
+        case 0x04:   // MUL
+            emit8(0x8A); emit8(0x43); emit8(rs1);        // mov al, [rbx+rs1]
+            emit8(0xF6); emit8(0x63); emit8(rs2);        // mul byte [rbx+rs2]
+            emit8(0x84); emit8(0xC0);                    // test al, al (N,Z; clears C,V)
+            emitStoreFlags();
+            emit8(0x88); emit8(0x43); emit8(rd);         // mov [rbx+rd], al
+            break;
+        case 0x0C:   // NOT
+            emit8(0x8A); emit8(0x43); emit8(rs1);        // mov al, [rbx+rs]
+            emit8(0x34); emit8(0xFF);                    // xor al, 0xFF
+            emitStoreFlags();
+            emit8(0x88); emit8(0x43); emit8(rd);         // mov [rbx+rd], al
+            break;
+        case 0x13:   // CMP
+            emit8(0x8A); emit8(0x43); emit8(rd);         // mov al, [rbx+rs1]
+            emit8(0x3A); emit8(0x43); emit8(rs1);        // cmp al, [rbx+rs2]
+            emitStoreFlags();
+            break;
+        case 0x14:   // CMPI
+            emit8(0x8A); emit8(0x43); emit8(rd);         // mov al, [rbx+rs]
+            emit8(0x3C); emit8(op.imm);                  // cmp al, imm
+            emitStoreFlags();
+            break;
+        case 0x12:   // LOADI
+            emit8(0xC6); emit8(0x43); emit8(rd);         // mov byte [rbx+rd], imm
+            emit8(op.imm);
+            break;
+        case 0x10:   // LOAD (RAM only)
+            emit8(0x41); emit8(0x8A); emit8(0x85);       // mov al, [r13+addr]
+            emit32(op.target);
+            emit8(0x88); emit8(0x43); emit8(rd);         // mov [rbx+rd], al
+            break;
+        case 0x11:   // STORE (RAM only)
+            emit8(0xBE); emit32(op.target);              // mov esi, addr
+            emit8(0x0F); emit8(0xB6); emit8(0x53); emit8(rd); // movzx edx, byte [rbx+rs]
+            emitHelperCall(reinterpret_cast<const void*>(&Jit::helperStore), 0, false);
+            emitEarlyExit(next_pc, remaining);
+            break;
+        case 0x15:   // PUSH
+            emitHelperCall(reinterpret_cast<const void*>(&Jit::helperPush), rd, true);
+            emitEarlyExit(next_pc, remaining);
+            break;
+        case 0x16:   // POP
+            emitHelperCall(reinterpret_cast<const void*>(&Jit::helperPop), rd, true);
+            break;
+        case HANDLER_LOAD_INDIRECT:
+        case HANDLER_STORE_INDIRECT: {
+            op_copies.push_back(op);
+            const DecodedOp* copy = &op_copies.back();
+            emit8(0x48); emit8(0xBE);                    // mov rsi, copy
+            emit64(reinterpret_cast<uint64_t>(copy));
+            emitHelperCall(reinterpret_cast<const void*>(&Jit::helperIndirect), 0, false);
+
+            // Device page: leave before the access, with it not retired
+            emit8(0x3C); emit8(HELPER_DEVICE);           // cmp al, HELPER_DEVICE
+            emit8(0x75);                                 // jne after
+            uint8_t* skip = code;
+            emit8(0);
+            emit8(0x49); emit8(0x81); emit8(0x46);       // add qword [r14+budget], remaining + 1
+            emit8(CTX_BUDGET);
+            emit32(remaining + 1);
+            emitUnchainedExit(static_cast<uint16_t>(next_pc - op.length));
+            *skip = static_cast<uint8_t>(code - (skip + 1));
+            emitEarlyExit(next_pc, remaining);
+            break;
+        }
+        case 0x0D:   // SHL
+        case 0x0E:   // SHR
+        case HANDLER_MULH:
+        case HANDLER_DIV:
+        case HANDLER_MOD: {
+            // Shift edge cases (count 0 or >= 8) and divide by zero are
+            // left to the ALU
+            op_copies.push_back(op);
+            const DecodedOp* copy = &op_copies.back();
+            emit8(0x48); emit8(0xBE);                    // mov rsi, copy
+            emit64(reinterpret_cast<uint64_t>(copy));
+            emitHelperCall(reinterpret_cast<const void*>(&Jit::helperExecute), 0, false);
+            break;
+        }
+        case 0x18:   // JMP
+            emitExit(op.target);
+            break;
+        case 0x19:   // JZ
+        case 0x1A:   // JNZ
+        case 0x1B:   // JC
+        case 0x1C: { // JNC
+            uint8_t mask = (op.handler <= 0x1A) ? ALU::FLAG_Z : ALU::FLAG_C;
+            bool when_set = (op.handler == 0x19 || op.handler == 0x1B);
+            emit8(0x41); emit8(0xF6); emit8(0x04); emit8(0x24); // test byte [r12], mask
+            emit8(mask);
+            emit8(0x0F); emit8(when_set ? 0x85 : 0x84);  // jnz/jz taken
+            uint8_t* taken_jump = code;
+            emit32(0);
+            emitExit(next_pc);                           // Not taken
+            int32_t rel = static_cast<int32_t>(code - (taken_jump + 4));
+            std::memcpy(taken_jump, &rel, 4);
+            emitExit(op.target);                         // Taken
+            break;
+        }
+        case 0x1D: { // CALL
+            emitHelperCall(reinterpret_cast<const void*>(&Jit::helperCall), next_pc, true);
+            emit8(0x84); emit8(0xC0);                    // test al, al
+            emit8(0x74);                                 // jz chained
+            uint8_t* skip = code;
+            emit8(0);
+            emitUnchainedExit(op.target);                // Stack write hit code
+            *skip = static_cast<uint8_t>(code - (skip + 1));
+            emitExit(op.target);
+            break;
+        }
+        case 0x1E:   // RET
+            emitHelperCall(reinterpret_cast<const void*>(&Jit::helperRet), 0, false);
+            emit8(0x66); emit8(0x41); emit8(0x89); emit8(0x46); // mov [r14+exit_pc], ax
+            emit8(CTX_EXIT_PC);
+            emit8(0xE9);                                 // jmp epilogue
+            emit32(static_cast<uint32_t>(epilogue - (code + 4)));
+            break;
+        case HANDLER_NOP:
+        default:
+            break;
+    }
+}
+
+void Jit::emitStoreFlags() {
+    // SC8 N/Z sit at the same bit positions as x86 SF/ZF (7, 6);
+    // C and V come from CF (AH bit 0) and OF. Bits 3-0 are kept, as
+    // the ALU keeps them.
+    static const uint8_t sequence[] = {
+        0x0F, 0x90, 0xC1,       // seto cl
+        0x9F,                   // lahf
+        0x88, 0xE2,             // mov dl, ah
+        0x80, 0xE2, 0xC0,       // and dl, 0xC0       ; N, Z
+        0x80, 0xE4, 0x01,       // and ah, 1
+        0xC0, 0xE4, 0x05,       // shl ah, 5          ; C
+        0x08, 0xE2,             // or dl, ah
+        0xC0, 0xE1, 0x04,       // shl cl, 4          ; V
+        0x08, 0xCA,             // or dl, cl
+        0x41, 0x8A, 0x0C, 0x24, // mov cl, [r12]
+        0x80, 0xE1, 0x0F,       // and cl, 0x0F
+        0x08, 0xCA,             // or dl, cl
+        0x41, 0x88, 0x14, 0x24  // mov [r12], dl
+    };
+    emitBytes(sequence, sizeof(sequence));
+}
+
+void Jit::emitHelperCall(const void* helper, uint32_t arg1, bool has_arg1) {
+    if (has_arg1) {
+        emit8(0xBE); emit32(arg1);                       // mov esi, arg1
+    }
+    emit8(0x4C); emit8(0x89); emit8(0xF7);               // mov rdi, r14
+    emit8(0x48); emit8(0xB8);                            // mov rax, helper
+    emit64(reinterpret_cast<uint64_t>(helper));
+    emit8(0xFF); emit8(0xD0);                            // call rax
+}
+
+void Jit::emitExit(uint16_t target) {
+    uint8_t* block = blocks[target];
+    if (target < 0xFF00 && block && block != NO_BLOCK) {
+        emit8(0xE9);                                     // jmp block
+        emit32(static_cast<uint32_t>(block - (code + 4)));
+        return;
+    }
+
+    if (target < 0xFF00) {
+        links[target].push_back(code);                   // Patch once translated
+    }
+    emitUnchainedExit(target);
+}
+
+void Jit::emitUnchainedExit(uint16_t target) {
+    emit8(0x66); emit8(0x41); emit8(0xC7); emit8(0x46);  // mov word [r14+exit_pc], target
+    emit8(CTX_EXIT_PC);
+    emit16(target);
+    emit8(0xE9);                                         // jmp epilogue
+    emit32(static_cast<uint32_t>(epilogue - (code + 4)));
+}
+
+void Jit::emitEarlyExit(uint16_t next_pc, int remaining) {
+    // Leave the block if the helper reported a write to translated code
+    emit8(0x84); emit8(0xC0);                            // test al, al
+    emit8(0x74);                                         // jz continue
+    uint8_t* skip = code;
+    emit8(0);
+    if (remaining > 0) {
+        emit8(0x49); emit8(0x81); emit8(0x46);           // add qword [r14+budget], remaining
+        emit8(CTX_BUDGET);
+        emit32(remaining);
+    }
+    emitUnchainedExit(next_pc);
+    *skip = static_cast<uint8_t>(code - (skip + 1));
+}
+
+void Jit::emitJumpTo(uint8_t* site, uint8_t* target) {
+    site[0] = 0xE9;                                      // jmp target
+    int32_t rel = static_cast<int32_t>(target - (site + 5));
+    std::memcpy(site + 1, &rel, 4);
+}
+
+void Jit::emit8(uint8_t value) {
+    *code++ = value;
+}
+
+void Jit::emit16(uint16_t value) {
+    std::memcpy(code, &value, 2);
+    code += 2;
+}
+
+void Jit::emit32(uint32_t value) {
+    std::memcpy(code, &value, 4);
+    code += 4;
+}
+
+void Jit::emit64(uint64_t value) {
+    std::memcpy(code, &value, 8);
+    code += 8;
+}
+
+void Jit::emitBytes(const uint8_t* bytes, size_t count) {
+    std::memcpy(code, bytes, count);
+    code += count;
+}
+
+// Helpers called from translated code. Those that write memory return
+// non-zero when the write hit translated code and the block must exit;
+// helperIndirect also returns HELPER_DEVICE.
+
+uint32_t Jit::helperStore(JitContext* ctx, uint32_t address, uint32_t value) {
+    ctx->cpu->memory->write(static_cast<uint16_t>(address), static_cast<uint8_t>(value));
+    return ctx->jit->flush_pending;
+}
+
+uint32_t Jit::helperPush(JitContext* ctx, uint32_t reg) {
+    ctx->cpu->push(ctx->cpu->registers[reg]);
+    return ctx->jit->flush_pending;
+}
+
+uint32_t Jit::helperPop(JitContext* ctx, uint32_t reg) {
+    ctx->cpu->registers[reg] = ctx->cpu->pop();
+    return 0;
+}
+
+uint32_t Jit::helperCall(JitContext* ctx, uint32_t return_pc) {
+    ctx->cpu->push(return_pc & 0xFF);        // Low byte
+    ctx->cpu->push((return_pc >> 8) & 0xFF); // High byte
+    return ctx->jit->flush_pending;
+}
+
+uint32_t Jit::helperRet(JitContext* ctx) {
+    uint8_t high = ctx->cpu->pop();
+    uint8_t low = ctx->cpu->pop();
+    return low | (high << 8);
+}
+
+uint32_t Jit::helperExecute(JitContext* ctx, const DecodedOp* op) {
+    ctx->cpu->execute(*op);
+    return 0;
+}
+
+uint32_t Jit::helperIndirect(JitContext* ctx, const DecodedOp* op) {
+    // Device accesses need the exact cycle count, which only the
+    // interpreter keeps
+    CPU& cpu = *ctx->cpu;
+    if (!ctx->jit->memory->isRamPage(CPU::indirectAddress(*op, cpu.registers) >> 8)) {
+        return HELPER_DEVICE;
+    }
+    cpu.executeMemory(*op);
+    return ctx->jit->flush_pending;
+}
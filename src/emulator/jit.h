@@ -0,0 +1,122 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+#include <map>
+#include <vector>
+#include "decode_cache.h"
+#include "memory.h"
+
+class CPU;
+class Jit;
+
+/**
+ * JitContext - State shared by translated code and the dispatcher
+ *
+ * Translated blocks keep a pointer to this structure in R14 for the
+ * whole time they run.
+ */
+struct JitContext {
+    int64_t budget;      // Instructions left before control must return
+    CPU* cpu;
+    Jit* jit;
+    uint16_t exit_pc;    // Guest PC to resume at after a block exits
+};
+
+/**
+ * Jit class - x86-64 dynamic binary translator for SC8 basic blocks
+ *
+ * A basic block runs up to and including the first JMP, JZ, JNZ, JC,
+ * JNC, CALL or RET. HALT, RETI, WAIT, CAS, unknown opcodes and
+ * LOAD/STORE to the I/O region (0xFF00-0xFFFF) are never translated; a
+ * block stops just before them and the interpreter executes them
+ * instead. Register-indirect LOAD/STORE only know their address when
+ * they run: the translated access leaves the block before touching a
+ * device page, and the interpreter performs it.
+ *
+ * Guest registers and flags stay in the CPU object and are accessed
+ * directly by the generated code, so register, flag and PC state is
+ * exact whenever a block returns to the dispatcher. Flags are taken
+ * straight from the host's 8-bit ALU result (SF/ZF/CF/OF map to
+ * N/Z/C/V one-to-one for every translated operation).
+ *
+ * Block exits with a static target are chained (patched into a direct
+ * jump) once the target is translated. Every block entry checks the
+ * instruction budget, so chained loops still return in time for the
+ * CPU's runaway check. A guest store into a page holding translated
+ * code flushes the whole translation cache; a store from inside a block
+ * leaves the block immediately so stale code never runs.
+ *
+ * Only available on x86-64 System V hosts (Linux, macOS).
+ */
+class Jit : public MemoryWatcher {
+private:
+    CPU* cpu;
+    Memory* memory;
+    JitContext context;
+
+    // Executable code buffer
+    uint8_t* buffer;
+    size_t buffer_size;
+    size_t used;
+    uint8_t* code;       // Current emit position
+    uint8_t* entry;      // Trampoline: saves host registers, jumps to a block
+    uint8_t* epilogue;   // Restores host registers, returns to dispatcher
+    uint8_t* block_area; // First byte after the trampolines
+
+    // Translation cache
+    std::vector<uint8_t*> blocks;                      // Guest PC -> block
+    std::map<uint16_t, std::vector<uint8_t*> > links;  // Unchained exits by target
+    std::deque<DecodedOp> op_copies;                   // Ops referenced by helper calls
+    uint8_t jit_pages[256];                            // Pages holding translated code
+    bool flush_pending;
+
+    // Translation
+    uint8_t* lookupBlock(uint16_t pc);
+    uint8_t* translate(uint16_t pc);
+    bool isTranslatable(const DecodedOp& op) const;
+    void flush();
+
+    // Code emission
+    void emit8(uint8_t value);
+    void emit16(uint16_t value);
+    void emit32(uint32_t value);
+    void emit64(uint64_t value);
+    void emitBytes(const uint8_t* bytes, size_t count);
+    void emitOp(const DecodedOp& op, uint16_t next_pc, int remaining);
+    void emitStoreFlags();
+    void emitHelperCall(const void* helper, uint32_t arg1, bool has_arg1);
+    void emitExit(uint16_t target);
+    void emitUnchainedExit(uint16_t target);
+    void emitEarlyExit(uint16_t next_pc, int remaining);
+    void emitJumpTo(uint8_t* site, uint8_t* target);
+
+    // Helpers called from translated code
+    static uint32_t helperStore(JitContext* ctx, uint32_t address, uint32_t value);
+    static uint32_t helperPush(JitContext* ctx, uint32_t reg);
+    static uint32_t helperPop(JitContext* ctx, uint32_t reg);
+    static uint32_t helperCall(JitContext* ctx, uint32_t return_pc);
+    static uint32_t helperRet(JitContext* ctx);
+    static uint32_t helperExecute(JitContext* ctx, const DecodedOp* op);
+    static uint32_t helperIndirect(JitContext* ctx, const DecodedOp* op);
+
+public:
+    Jit(CPU* owner, Memory* mem);
+    ~Jit();
+
+    // True when the host can run translated code
+    static bool isSupported();
+
+    // False if the executable buffer could not be allocated
+    bool isReady() const { return buffer != nullptr; }
+
+    // Run until HALT or until the CPU's runaway check must fire
+    void run();
+
+    // MemoryWatcher interface
+    void onCodeModified(uint16_t start, uint32_t count);
+};
+
+#endif // JIT_H
@@ -1,22 +1,71 @@
 #include <iostream>
 #include <fstream>
+#include <memory>
 #include <vector>
 #include <string>
 #include <iomanip>
+#include <sstream>
+#include "batch.h"
+#include "cache.h"
+#include "call_profile.h"
 #include "cpu.h"
+#include "io_log.h"
 #include "memory.h"
+#include "multicore.h"
+#include "pipeline_model.h"
+#include "time_travel.h"
+#include "timing_model.h"
+#include "trace.h"
 
 void printUsage(const char* program) {
     std::cout << "SC8 CPU Emulator" << std::endl;
     std::cout << "Usage: " << program << " [options] <binary_file>" << std::endl;
+    std::cout << "       " << program << " [options] --load-state <snapshot>" << std::endl;
     std::cout << "\nOptions:" << std::endl;
     std::cout << "  -d, --debug       Enable debug mode (step-by-step execution)" << std::endl;
     std::cout << "  -m, --dump-memory Dump memory after execution" << std::endl;
     std::cout << "  -s, --start ADDR  Set program start address (default: 0x0100)" << std::endl;
+    std::cout << "  -e, --engine NAME Execution engine: switch (default), threaded or jit" << std::endl;
+    std::cout << "  -l, --lazy-flags  Evaluate flags only when read (threaded/jit engines)" << std::endl;
+    std::cout << "  -t, --trace FILE  Write a JSON-lines trace of every instruction to FILE" << std::endl;
+    std::cout << "  -T, --binary-trace FILE  Write a compact binary trace to FILE (see trace_decode)" << std::endl;
+    std::cout << "  -p, --profile     Print per-opcode instruction counts after execution" << std::endl;
+    std::cout << "  --flamegraph FILE Profile cycles per PC and call path; print the hot spots and" << std::endl;
+    std::cout << "                    write collapsed stacks for flamegraph tools to FILE" << std::endl;
+    std::cout << "  --symbols FILE    Symbol map for --flamegraph and --pipeline (default: the binary's .sym file)" << std::endl;
+    std::cout << "  --stats FILE      Count instruction classes, branches, memory and stack traffic" << std::endl;
+    std::cout << "                    (guest-readable at 0xFF10-0xFF15) and write them to FILE as JSON" << std::endl;
+    std::cout << "  --cache FILE      Simulate L1 I/D caches and an L2, charge miss stalls as cycles and" << std::endl;
+    std::cout << "                    report hit rates ('default' for the built-in configuration)" << std::endl;
+    std::cout << "  --pipeline NAME   Time the run on a 5-stage pipeline model and report CPI and stalls;" << std::endl;
+    std::cout << "                    NAME is the branch predictor: static, bimodal or btb" << std::endl;
+    std::cout << "  --no-forwarding   Model the pipeline without operand forwarding" << std::endl;
+    std::cout << "  -i, --input FILE  Feed FILE to CONSOLE_IN ('-' for stdin)" << std::endl;
+    std::cout << "  --console-out FILE    Write guest console output to FILE instead of stdout" << std::endl;
+    std::cout << "  --console-flush MODE  Console flush policy: newline (default), size, halt" << std::endl;
+    std::cout << "                        or immediate (always immediate in debug mode)" << std::endl;
+    std::cout << "  --timing FILE     Charge per-opcode cycles, memory accesses and I/O wait states" << std::endl;
+    std::cout << "                    from a timing table ('default' for the built-in table)" << std::endl;
+    std::cout << "  --cores N         Run N cores (2-" << Multicore::MAX_CORES << ") on host threads, sharing memory;" << std::endl;
+    std::cout << "                    each reads its number from CORE_ID (0xFF08)" << std::endl;
+    std::cout << "  -c, --cycles N    Stop after N more cycles (default: " << CPU::MAX_CYCLES << ")" << std::endl;
+    std::cout << "  --save-state FILE     Write a snapshot of the machine to FILE when execution stops" << std::endl;
+    std::cout << "  --load-state FILE     Resume from a snapshot instead of loading a binary" << std::endl;
+    std::cout << "  -r, --reverse     Interactive debugger with reverse execution ('help' lists commands)" << std::endl;
+    std::cout << "  --checkpoint-interval N  Cycles between --reverse checkpoints (default: 10000)" << std::endl;
+    std::cout << "  --record FILE     Log every host input the guest reads to FILE" << std::endl;
+    std::cout << "  --replay FILE     Re-run with the input logged by --record (no real input)" << std::endl;
+    std::cout << "  -b, --batch FILE  Run every job in a manifest file in parallel" << std::endl;
+    std::cout << "                    (one job per line: <binary> [<input>|-] [<cycle budget>])" << std::endl;
+    std::cout << "  -j, --jobs N      Worker threads for --batch (default: one per core)" << std::endl;
+    std::cout << "  --results FILE    Write per-job --batch results as JSON lines" << std::endl;
     std::cout << "  -h, --help        Show this help message" << std::endl;
     std::cout << "\nExample:" << std::endl;
     std::cout << "  " << program << " program.bin" << std::endl;
     std::cout << "  " << program << " -d program.bin" << std::endl;
+    std::cout << "  " << program << " -b jobs.txt -j 4" << std::endl;
+    std::cout << "  " << program << " -c 500000 --save-state run.snap program.bin" << std::endl;
+    std::cout << "  " << program << " --load-state run.snap" << std::endl;
 }
 
 std::vector<uint8_t> loadBinaryFile(const std::string& filename) {
@@ -43,10 +92,160 @@ std::vector<uint8_t> loadBinaryFile(const std::string& filename) {
     return buffer;
 }
 
+void printTimeTravelHelp() {
+    std::cout << "Commands:" << std::endl;
+    std::cout << "  s [N]        Step forward N instructions (default 1; empty line steps once)" << std::endl;
+    std::cout << "  b [N]        Step back N instructions" << std::endl;
+    std::cout << "  c            Continue to a breakpoint or HALT" << std::endl;
+    std::cout << "  rc           Reverse-continue to the previous breakpoint hit" << std::endl;
+    std::cout << "  g CYCLE      Go to a cycle, forward or back" << std::endl;
+    std::cout << "  break ADDR   Set a breakpoint at a PC (hex)" << std::endl;
+    std::cout << "  delete ADDR  Remove a breakpoint" << std::endl;
+    std::cout << "  last ADDR    Find when the byte at ADDR (hex) last changed" << std::endl;
+    std::cout << "  p            Print CPU state" << std::endl;
+    std::cout << "  info         Show checkpoint usage" << std::endl;
+    std::cout << "  q            Quit" << std::endl;
+}
+
+bool parseNumber(const std::string& text, int base, uint64_t& value) {
+    if (text.empty()) {
+        return false;
+    }
+    std::istringstream field(text);
+    field >> (base == 16 ? std::hex : std::dec) >> value;
+    return field && field.eof();
+}
+
+// Interactive debugger on top of TimeTravel
+void runTimeTravel(CPU& cpu, Memory& memory, uint64_t interval, uint64_t cycle_budget) {
+    TimeTravel debugger(cpu, memory, interval);
+    
+    std::cout << "=== Starting Reverse Debugger ===" << std::endl;
+    std::cout << "Type 'help' for commands" << std::endl;
+    cpu.printState();
+    
+    std::string line;
+    while (std::cout << "(sc8) " << std::flush, std::getline(std::cin, line)) {
+        std::istringstream args(line);
+        std::string command;
+        std::string operand;
+        args >> command >> operand;
+        uint64_t value = 1;
+        
+        if (command.empty() || command == "s" || command == "step") {
+            if (!operand.empty() && !parseNumber(operand, 10, value)) {
+                std::cout << "Usage: s [count]" << std::endl;
+                continue;
+            }
+            debugger.step(value);
+        } else if (command == "b" || command == "back") {
+            if (!operand.empty() && !parseNumber(operand, 10, value)) {
+                std::cout << "Usage: b [count]" << std::endl;
+                continue;
+            }
+            debugger.stepBack(value);
+        } else if (command == "c" || command == "continue") {
+            if (debugger.continueForward(cycle_budget)) {
+                std::cout << "Breakpoint at 0x" << std::hex << cpu.getPC() << std::dec << std::endl;
+            }
+        } else if (command == "rc") {
+            if (debugger.reverseContinue()) {
+                std::cout << "Breakpoint at 0x" << std::hex << cpu.getPC() << std::dec << std::endl;
+            } else {
+                std::cout << "Reached the start of the recorded history" << std::endl;
+            }
+        } else if (command == "g" || command == "goto") {
+            if (!parseNumber(operand, 10, value)) {
+                std::cout << "Usage: g cycle" << std::endl;
+                continue;
+            }
+            debugger.goTo(value);
+        } else if (command == "break" || command == "delete") {
+            if (!parseNumber(operand, 16, value) || value > 0xFFFF) {
+                std::cout << "Usage: " << command << " address" << std::endl;
+                continue;
+            }
+            if (command == "break") {
+                debugger.addBreakpoint(value);
+            } else {
+                debugger.removeBreakpoint(value);
+            }
+            continue;
+        } else if (command == "last") {
+            if (!parseNumber(operand, 16, value) || value > 0xFFFF) {
+                std::cout << "Usage: last address" << std::endl;
+                continue;
+            }
+            if (!memory.isRamPage(value >> 8)) {
+                std::cout << "0x" << std::hex << value << std::dec << " is not RAM" << std::endl;
+                continue;
+            }
+            TimeTravel::Change change = debugger.lastChange(value);
+            if (change.found) {
+                std::cout << "Changed at cycle " << change.cycle << " by PC=0x" << std::hex
+                          << std::setw(4) << std::setfill('0') << change.pc << ": 0x"
+                          << std::setw(2) << static_cast<int>(change.before) << " -> 0x"
+                          << std::setw(2) << static_cast<int>(change.after) << std::dec << std::endl;
+            } else {
+                std::cout << "Unchanged since cycle " << debugger.getFirstCycle() << std::endl;
+            }
+            continue;
+        } else if (command == "info") {
+            std::cout << debugger.getCheckpointCount() << " checkpoints from cycle "
+                      << debugger.getFirstCycle() << ", " << debugger.getStoredBytes()
+                      << " bytes of pages" << std::endl;
+            continue;
+        } else if (command == "p" || command == "print") {
+            // Falls through to the state print below
+        } else if (command == "help") {
+            printTimeTravelHelp();
+            continue;
+        } else if (command == "q" || command == "quit") {
+            break;
+        } else {
+            std::cout << "Unknown command '" << command << "' (try 'help')" << std::endl;
+            continue;
+        }
+        
+        memory.sync();
+        if (cpu.isHalted()) {
+            std::cout << "CPU halted" << std::endl;
+        }
+        cpu.printState();
+    }
+    memory.sync();
+}
+
 int main(int argc, char* argv[]) {
     bool debug = false;
     bool dump_memory = false;
+    bool lazy_flags = false;
+    bool profile = false;
+    bool reverse = false;
+    uint64_t checkpoint_interval = 10000;
+    std::string trace_file;
+    std::string binary_trace_file;
+    std::string flamegraph_file;
+    std::string symbols_file;
+    std::string stats_file;
+    std::string timing_file;
+    std::string cache_file;
+    std::string pipeline_predictor;
+    bool forwarding = true;
+    std::string console_file;
+    std::string input_file;
+    std::string batch_file;
+    std::string results_file;
+    std::string save_state_file;
+    std::string load_state_file;
+    std::string record_file;
+    std::string replay_file;
+    uint64_t cycle_budget = 0;   // 0: the default runaway guard
+    unsigned cores = 1;
+    unsigned batch_threads = 0;
+    FlushPolicy console_flush = FlushPolicy::Newline;
     uint16_t start_address = 0x0100;
+    ExecutionEngine engine = ExecutionEngine::Switch;
     std::string binary_file;
     
     // Parse command line arguments
@@ -55,6 +254,185 @@ int main(int argc, char* argv[]) {
         
         if (arg == "-d" || arg == "--debug") {
             debug = true;
+        } else if (arg == "-l" || arg == "--lazy-flags") {
+            lazy_flags = true;
+        } else if (arg == "-r" || arg == "--reverse") {
+            reverse = true;
+        } else if (arg == "--checkpoint-interval") {
+            if (i + 1 < argc) {
+                checkpoint_interval = std::stoull(argv[++i]);
+            } else {
+                std::cerr << "Error: --checkpoint-interval option requires a cycle count" << std::endl;
+                return 1;
+            }
+        } else if (arg == "-p" || arg == "--profile") {
+            profile = true;
+        } else if (arg == "-t" || arg == "--trace") {
+            if (i + 1 < argc) {
+                trace_file = argv[++i];
+            } else {
+                std::cerr << "Error: -t option requires a file name" << std::endl;
+                return 1;
+            }
+        } else if (arg == "-T" || arg == "--binary-trace") {
+            if (i + 1 < argc) {
+                binary_trace_file = argv[++i];
+            } else {
+                std::cerr << "Error: -T option requires a file name" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--flamegraph") {
+            if (i + 1 < argc) {
+                flamegraph_file = argv[++i];
+            } else {
+                std::cerr << "Error: --flamegraph option requires a file name" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--symbols") {
+            if (i + 1 < argc) {
+                symbols_file = argv[++i];
+            } else {
+                std::cerr << "Error: --symbols option requires a file name" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--stats") {
+            if (i + 1 < argc) {
+                stats_file = argv[++i];
+            } else {
+                std::cerr << "Error: --stats option requires a file name" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--timing") {
+            if (i + 1 < argc) {
+                timing_file = argv[++i];
+            } else {
+                std::cerr << "Error: --timing option requires a file name" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--cache") {
+            if (i + 1 < argc) {
+                cache_file = argv[++i];
+            } else {
+                std::cerr << "Error: --cache option requires a file name" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--pipeline") {
+            if (i + 1 < argc) {
+                pipeline_predictor = argv[++i];
+                if (!BranchPredictor::create(pipeline_predictor)) {
+                    std::cerr << "Error: Unknown branch predictor '" << pipeline_predictor << "'" << std::endl;
+                    return 1;
+                }
+            } else {
+                std::cerr << "Error: --pipeline option requires a predictor name" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--no-forwarding") {
+            forwarding = false;
+        } else if (arg == "-i" || arg == "--input") {
+            if (i + 1 < argc) {
+                input_file = argv[++i];
+            } else {
+                std::cerr << "Error: -i option requires a file name" << std::endl;
+                return 1;
+            }
+        } else if (arg == "-c" || arg == "--cycles") {
+            if (i + 1 < argc) {
+                cycle_budget = std::stoull(argv[++i]);
+                if (cycle_budget == 0) {
+                    std::cerr << "Error: -c needs a positive cycle count" << std::endl;
+                    return 1;
+                }
+            } else {
+                std::cerr << "Error: -c option requires a cycle count" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--cores") {
+            if (i + 1 < argc) {
+                cores = std::stoi(argv[++i]);
+                if (cores < 1 || cores > Multicore::MAX_CORES) {
+                    std::cerr << "Error: --cores needs a count from 1 to " << Multicore::MAX_CORES << std::endl;
+                    return 1;
+                }
+            } else {
+                std::cerr << "Error: --cores option requires a core count" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--save-state") {
+            if (i + 1 < argc) {
+                save_state_file = argv[++i];
+            } else {
+                std::cerr << "Error: --save-state option requires a file name" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--load-state") {
+            if (i + 1 < argc) {
+                load_state_file = argv[++i];
+            } else {
+                std::cerr << "Error: --load-state option requires a file name" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--record") {
+            if (i + 1 < argc) {
+                record_file = argv[++i];
+            } else {
+                std::cerr << "Error: --record option requires a file name" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--replay") {
+            if (i + 1 < argc) {
+                replay_file = argv[++i];
+            } else {
+                std::cerr << "Error: --replay option requires a file name" << std::endl;
+                return 1;
+            }
+        } else if (arg == "-b" || arg == "--batch") {
+            if (i + 1 < argc) {
+                batch_file = argv[++i];
+            } else {
+                std::cerr << "Error: -b option requires a manifest file" << std::endl;
+                return 1;
+            }
+        } else if (arg == "-j" || arg == "--jobs") {
+            if (i + 1 < argc) {
+                batch_threads = std::stoi(argv[++i]);
+            } else {
+                std::cerr << "Error: -j option requires a thread count" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--results") {
+            if (i + 1 < argc) {
+                results_file = argv[++i];
+            } else {
+                std::cerr << "Error: --results option requires a file name" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--console-out") {
+            if (i + 1 < argc) {
+                console_file = argv[++i];
+            } else {
+                std::cerr << "Error: --console-out option requires a file name" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--console-flush") {
+            if (i + 1 < argc) {
+                std::string name = argv[++i];
+                if (name == "newline") {
+                    console_flush = FlushPolicy::Newline;
+                } else if (name == "size") {
+                    console_flush = FlushPolicy::Size;
+                } else if (name == "halt") {
+                    console_flush = FlushPolicy::Halt;
+                } else if (name == "immediate") {
+                    console_flush = FlushPolicy::Immediate;
+                } else {
+                    std::cerr << "Error: Unknown flush policy '" << name << "'" << std::endl;
+                    return 1;
+                }
+            } else {
+                std::cerr << "Error: --console-flush option requires a policy" << std::endl;
+                return 1;
+            }
         } else if (arg == "-m" || arg == "--dump-memory") {
             dump_memory = true;
         } else if (arg == "-s" || arg == "--start") {
@@ -64,6 +442,23 @@ int main(int argc, char* argv[]) {
                 std::cerr << "Error: -s option requires an address" << std::endl;
                 return 1;
             }
+        } else if (arg == "-e" || arg == "--engine") {
+            if (i + 1 < argc) {
+                std::string name = argv[++i];
+                if (name == "switch") {
+                    engine = ExecutionEngine::Switch;
+                } else if (name == "threaded") {
+                    engine = ExecutionEngine::Threaded;
+                } else if (name == "jit") {
+                    engine = ExecutionEngine::Jit;
+                } else {
+                    std::cerr << "Error: Unknown engine '" << name << "'" << std::endl;
+                    return 1;
+                }
+            } else {
+                std::cerr << "Error: -e option requires an engine name" << std::endl;
+                return 1;
+            }
         } else if (arg == "-h" || arg == "--help") {
             printUsage(argv[0]);
             return 0;
@@ -76,32 +471,218 @@ int main(int argc, char* argv[]) {
         }
     }
     
-    if (binary_file.empty()) {
+    // Each of these runs the CPU its own way
+    int run_modes = debug + reverse + profile + !trace_file.empty() + !binary_trace_file.empty() +
+                    !flamegraph_file.empty() + !stats_file.empty() + !pipeline_predictor.empty();
+    if (run_modes > 1) {
+        std::cerr << "Error: only one of -d, -r, -t, -T, -p, --flamegraph, --stats and --pipeline can be used"
+                  << std::endl;
+        return 1;
+    }
+    
+    // Tracers, profilers and snapshots follow a single CPU
+    if (cores > 1 && (run_modes > 0 || !cache_file.empty() || !batch_file.empty() ||
+                      !record_file.empty() || !replay_file.empty() ||
+                      !save_state_file.empty() || !load_state_file.empty())) {
+        std::cerr << "Error: --cores cannot be combined with -d, -r, -t, -T, -p, --flamegraph, --stats, "
+                  << "--pipeline, --cache, --batch, --record, --replay, --save-state or --load-state"
+                  << std::endl;
+        return 1;
+    }
+    if (cores > 1 && engine == ExecutionEngine::Jit) {
+        std::cerr << "Error: --cores needs the switch or threaded engine" << std::endl;
+        return 1;
+    }
+    
+    TimingModel timing;
+    if (!timing_file.empty() && timing_file != "default" && !timing.load(timing_file)) {
+        return 1;
+    }
+    CacheHierarchy::Config cache_config;
+    if (!cache_file.empty() && cache_file != "default" && !cache_config.load(cache_file)) {
+        return 1;
+    }
+    
+    if (!batch_file.empty() && !cache_file.empty()) {
+        std::cerr << "Error: --cache cannot be used with --batch" << std::endl;
+        return 1;
+    }
+    
+    if (!batch_file.empty()) {
+        BatchRunner batch(engine, lazy_flags);
+        if (!timing_file.empty()) {
+            batch.setTimingModel(&timing);
+        }
+        if (!batch.loadManifest(batch_file)) {
+            return 1;
+        }
+        batch.run(batch_threads);
+        batch.printSummary(std::cout);
+        if (!results_file.empty() && !batch.writeResults(results_file)) {
+            return 1;
+        }
+        return batch.allHalted() ? 0 : 1;
+    }
+    
+    if (reverse && (!record_file.empty() || !replay_file.empty())) {
+        std::cerr << "Error: -r cannot be combined with --record or --replay" << std::endl;
+        return 1;
+    }
+    
+    // The reverse debugger's positions are instruction counts
+    if (reverse && (!timing_file.empty() || !cache_file.empty())) {
+        std::cerr << "Error: -r cannot be combined with --timing or --cache" << std::endl;
+        return 1;
+    }
+    
+    // Binary traces count one cycle per instruction
+    if (!binary_trace_file.empty() && (!timing_file.empty() || !cache_file.empty())) {
+        std::cerr << "Error: -T cannot be combined with --timing or --cache" << std::endl;
+        return 1;
+    }
+    
+    if (reverse && input_file == "-") {
+        std::cerr << "Error: the reverse debugger reads stdin; use -i with a file" << std::endl;
+        return 1;
+    }
+    
+    if (!record_file.empty() && !replay_file.empty()) {
+        std::cerr << "Error: --record and --replay cannot be used together" << std::endl;
+        return 1;
+    }
+    
+    if (!replay_file.empty() && !input_file.empty()) {
+        std::cerr << "Error: --replay takes all input from the log; drop -i" << std::endl;
+        return 1;
+    }
+    
+    if (debug && input_file == "-") {
+        std::cerr << "Error: debug mode reads stdin; use -i with a file" << std::endl;
+        return 1;
+    }
+    
+    if (binary_file.empty() && load_state_file.empty()) {
         std::cerr << "Error: No binary file specified" << std::endl;
         printUsage(argv[0]);
         return 1;
     }
     
-    // Load binary file
-    std::vector<uint8_t> program = loadBinaryFile(binary_file);
-    if (program.empty()) {
+    if (!binary_file.empty() && !load_state_file.empty()) {
+        std::cerr << "Error: give either a binary file or --load-state, not both" << std::endl;
         return 1;
     }
     
+    // Load binary file
+    std::vector<uint8_t> program;
+    if (!binary_file.empty()) {
+        program = loadBinaryFile(binary_file);
+        if (program.empty()) {
+            return 1;
+        }
+    }
+    
     std::cout << "\n=== SC8 CPU Emulator ===" << std::endl;
-    std::cout << "Program: " << binary_file << std::endl;
-    std::cout << "Size: " << program.size() << " bytes" << std::endl;
-    std::cout << "Start address: 0x" << std::hex << std::setw(4) 
-              << std::setfill('0') << start_address << std::dec << std::endl;
+    if (load_state_file.empty()) {
+        std::cout << "Program: " << binary_file << std::endl;
+        std::cout << "Size: " << program.size() << " bytes" << std::endl;
+        std::cout << "Start address: 0x" << std::hex << std::setw(4) 
+                  << std::setfill('0') << start_address << std::dec << std::endl;
+    } else {
+        std::cout << "Snapshot: " << load_state_file << std::endl;
+    }
     std::cout << "Debug mode: " << (debug ? "ON" : "OFF") << std::endl;
     std::cout << std::endl;
     
+    // Labels for the profilers: the assembler writes them next to the binary
+    SymbolMap symbols;
+    if (!flamegraph_file.empty() || !pipeline_predictor.empty()) {
+        if (symbols_file.empty() && !binary_file.empty()) {
+            std::string guess = binary_file.substr(0, binary_file.find_last_of('.')) + ".sym";
+            if (guess != binary_file && std::ifstream(guess)) {
+                symbols_file = guess;
+            }
+        }
+        if (!symbols_file.empty() && !symbols.load(symbols_file)) {
+            return 1;
+        }
+    }
+    
     // Create memory and CPU
     Memory memory;
-    CPU cpu(&memory);
+    CPU cpu(&memory, engine);
+    cpu.enableLazyFlags(lazy_flags);
+    if (!timing_file.empty()) {
+        cpu.setTimingModel(&timing);
+    }
+    std::unique_ptr<CacheHierarchy> caches;
+    if (!cache_file.empty()) {
+        caches.reset(new CacheHierarchy(cache_config));
+        cpu.setCaches(caches.get());
+    }
     
-    // Load program into memory
-    memory.loadProgram(program, start_address);
+    // Guest console output is buffered and written by a background
+    // thread, except in debug mode where it interleaves with the trace
+    if (debug || reverse) {
+        console_flush = FlushPolicy::Immediate;
+    }
+    ConsoleTarget console_target = console_file.empty() ? ConsoleTarget::Stdout : ConsoleTarget::File;
+    if (!memory.getConsole().getOutput().open(console_target, console_flush, console_file)) {
+        return 1;
+    }
+    
+    if (input_file == "-") {
+        memory.getConsole().getInput().openStdin();
+    } else if (!input_file.empty() && !memory.getConsole().getInput().openFile(input_file)) {
+        return 1;
+    }
+    
+    // Load program into memory, or pick up a saved machine
+    if (load_state_file.empty()) {
+        if (!memory.loadProgram(program, start_address)) {
+            return 1;
+        }
+        std::cout << "Loaded " << program.size() << " bytes at address 0x" 
+                  << std::hex << std::setw(4) << std::setfill('0') 
+                  << start_address << std::dec << std::endl;
+    } else {
+        if (!cpu.loadSnapshot(load_state_file)) {
+            return 1;
+        }
+        std::cout << "Resumed at cycle " << cpu.getCycleCount() << ", PC=0x"
+                  << std::hex << std::setw(4) << std::setfill('0')
+                  << cpu.getPC() << std::dec << std::endl;
+    }
+    
+    // The budget counts from where this run starts; without one the
+    // runaway guard trips once MAX_CYCLES have retired
+    if (cycle_budget > 0) {
+        cpu.setCycleLimit(cpu.getCycleCount() + cycle_budget - 1);
+    } else {
+        cpu.setCycleLimit(cpu.getCycleCount() + CPU::MAX_CYCLES);
+        cycle_budget = CPU::MAX_CYCLES;
+    }
+    
+    // Further cores share the memory and run the same program
+    std::unique_ptr<Multicore> multicore;
+    if (cores > 1) {
+        multicore.reset(new Multicore(cpu, memory, cores));
+        for (unsigned i = 1; i < cores; i++) {
+            multicore->core(i).enableLazyFlags(lazy_flags);
+            if (!timing_file.empty()) {
+                multicore->core(i).setTimingModel(&timing);
+            }
+        }
+    }
+    
+    // Record or replay host input from here on
+    IoLog io_log(memory.getScheduler());
+    if (!record_file.empty() && !io_log.startRecording(record_file)) {
+        return 1;
+    }
+    if (!replay_file.empty() && !io_log.startReplay(replay_file)) {
+        return 1;
+    }
+    memory.setInterceptor(&io_log);
     
     // Enable debug mode if requested
     if (debug) {
@@ -111,7 +692,9 @@ int main(int argc, char* argv[]) {
     }
     
     // Run the CPU
-    if (debug) {
+    if (reverse) {
+        runTimeTravel(cpu, memory, checkpoint_interval, cycle_budget);
+    } else if (debug) {
         // Step-by-step execution
         cpu.printState();
         while (!cpu.isHalted()) {
@@ -119,14 +702,89 @@ int main(int argc, char* argv[]) {
             std::cin.get();
             cpu.step();
         }
+    } else if (!trace_file.empty()) {
+        // Run until halt, tracing every instruction
+        std::ofstream trace_out(trace_file);
+        if (!trace_out) {
+            std::cerr << "Error: Cannot open trace file '" << trace_file << "'" << std::endl;
+            return 1;
+        }
+        StructuredTrace trace(trace_out);
+        cpu.run(trace);
+    } else if (!binary_trace_file.empty()) {
+        // Records are written by a background thread as the CPU runs
+        BinaryTrace trace;
+        if (!trace.open(binary_trace_file, cpu)) {
+            return 1;
+        }
+        cpu.run(trace);
+        if (!trace.close()) {
+            return 1;
+        }
+    } else if (!flamegraph_file.empty()) {
+        CallProfile trace;
+        cpu.run(trace);
+        trace.finish(cpu);
+        trace.report(std::cout, symbols);
+        std::ofstream out(flamegraph_file);
+        trace.writeCollapsed(out, symbols);
+        if (!out) {
+            std::cerr << "Error: Cannot write '" << flamegraph_file << "'" << std::endl;
+            return 1;
+        }
+        std::cout << "Collapsed stacks written to " << flamegraph_file << std::endl;
+    } else if (!stats_file.empty()) {
+        StatsTrace trace(memory.getPerfCounters());
+        cpu.run(trace);
+        std::ofstream out(stats_file);
+        memory.getPerfCounters().writeJson(out);
+        if (!out) {
+            std::cerr << "Error: Cannot write '" << stats_file << "'" << std::endl;
+            return 1;
+        }
+        std::cout << "Statistics written to " << stats_file << std::endl;
+    } else if (!pipeline_predictor.empty()) {
+        PipelineModel trace(BranchPredictor::create(pipeline_predictor), forwarding);
+        cpu.run(trace);
+        trace.report(std::cout, symbols);
+    } else if (profile) {
+        ProfileTrace trace;
+        cpu.run(trace);
+        trace.report(std::cout);
+    } else if (multicore) {
+        multicore->run();
     } else {
         // Run until halt
         cpu.run();
     }
     
+    if (caches) {
+        caches->report(std::cout, cpu.getCycleCount());
+    }
+    
     // Print final state
     std::cout << "\n=== Final CPU State ===" << std::endl;
-    cpu.printState();
+    if (multicore) {
+        multicore->printState();
+    } else {
+        cpu.printState();
+    }
+    
+    bool replaying = io_log.getMode() == IoLog::Mode::Replay;
+    memory.setInterceptor(nullptr);
+    if (!io_log.finish()) {
+        return 1;
+    }
+    if (replaying) {
+        std::cout << "Replay matched the recording" << std::endl;
+    }
+    
+    if (!save_state_file.empty()) {
+        if (!cpu.saveSnapshot(save_state_file)) {
+            return 1;
+        }
+        std::cout << "Saved snapshot to " << save_state_file << std::endl;
+    }
     
     // Dump memory if requested
     if (dump_memory) {
@@ -1,72 +1,52 @@
 #include "memory.h"
 #include <iomanip>
 #include <cstring>
+#include <algorithm>
 
-Memory::Memory() : ram(65536, 0), timer_ctrl(0), console_out(0), 
-                   console_in(0), timer_value(0), timer_counter(0) {
-}
-
-uint8_t Memory::read(uint16_t address) {
-    // Check for memory-mapped I/O
-    if (address >= 0xFF00) {
-        switch (address) {
-            case 0xFF00:  // TIMER_CTRL
-                return timer_ctrl;
-            case 0xFF01:  // CONSOLE_OUT (write-only, return 0)
-                return 0;
-            case 0xFF02:  // CONSOLE_IN (read character from stdin)
-                // For simplicity, return 0 (no input available)
-                return console_in;
-            case 0xFF03:  // TIMER_VALUE
-                return timer_value;
-            default:
-                return ram[address];
-        }
+Memory::Memory()
+    : storage(65536, 0), mapping(nullptr), ram(storage.data()), bus(ram),
+      interrupts(scheduler, bus), timer(scheduler, interrupts), perf(scheduler),
+      dma(scheduler, *this, interrupts) {
+    bus.attach(&timer, IO_TIMER_CTRL);
+    bus.attach(&console, IO_CONSOLE_OUT);
+    bus.attach(&console, IO_CONSOLE_IN);
+    bus.attach(&timer, IO_TIMER_VALUE);
+    bus.attach(&console, IO_CONSOLE_STATUS);
+    bus.attach(&perf, IO_PERF_SELECT);
+    bus.attach(&perf, IO_PERF_CTRL);
+    for (int i = 0; i < 4; i++) {
+        bus.attach(&perf, IO_PERF_DATA + i);
     }
-    
-    return ram[address];
-}
-
-void Memory::write(uint16_t address, uint8_t value) {
-    // Check for memory-mapped I/O
-    if (address >= 0xFF00) {
-        switch (address) {
-            case 0xFF00:  // TIMER_CTRL - start timer
-                timer_ctrl = value;
-                timer_counter = value;
-                timer_value = value;
-                break;
-            case 0xFF01:  // CONSOLE_OUT - output character
-                console_out = value;
-                std::cout << static_cast<char>(value);
-                std::cout.flush();
-                break;
-            case 0xFF02:  // CONSOLE_IN - input character (write has no effect)
-                break;
-            case 0xFF03:  // TIMER_VALUE (read-only, write has no effect)
-                break;
-            default:
-                ram[address] = value;
-                break;
-        }
-    } else {
-        ram[address] = value;
+    bus.attach(&cores, IO_CORE_ID);
+    bus.attach(&cores, IO_CORE_COUNT);
+    bus.attach(&interrupts, IO_INT_ENABLE);
+    bus.attach(&interrupts, IO_INT_MASK);
+    bus.attach(&interrupts, IO_INT_PENDING);
+    for (uint16_t address = IO_DMA_SRC; address <= IO_DMA_STATUS; address++) {
+        bus.attach(&dma, address);
     }
 }
 
-void Memory::loadProgram(const std::vector<uint8_t>& program, uint16_t start_address) {
+Memory::~Memory() {
+    SnapshotReader::unmapRam(mapping);
+}
+
+bool Memory::loadProgram(const std::vector<uint8_t>& program, uint16_t start_address) {
     if (start_address + program.size() > 65536) {
         std::cerr << "Error: Program too large to fit in memory" << std::endl;
-        return;
+        return false;
     }
     
-    for (size_t i = 0; i < program.size(); i++) {
-        ram[start_address + i] = program[i];
+    if (program.empty()) {
+        return true;
     }
     
-    std::cout << "Loaded " << program.size() << " bytes at address 0x" 
-              << std::hex << std::setw(4) << std::setfill('0') 
-              << start_address << std::dec << std::endl;
+    std::memcpy(&ram[start_address], program.data(), program.size());
+    for (uint32_t page = start_address >> 8; page <= (start_address + program.size() - 1) >> 8; page++) {
+        bus.markDirty(page);
+    }
+    notifyCodeModified(start_address, program.size());
+    return true;
 }
 
 void Memory::dump(uint16_t start, uint16_t end) {
@@ -101,18 +81,98 @@ void Memory::dump(uint16_t start, uint16_t end) {
 }
 
 void Memory::reset() {
-    std::fill(ram.begin(), ram.end(), 0);
-    timer_ctrl = 0;
-    console_out = 0;
-    console_in = 0;
-    timer_value = 0;
-    timer_counter = 0;
-}
-
-void Memory::updateTimer() {
-    if (timer_counter > 0) {
-        timer_counter--;
-        timer_value = timer_counter;
+    // Only pages written since the last reset differ from the baseline
+    const std::vector<uint8_t>& pages = bus.getDirtyPages();
+    for (size_t i = 0; i < pages.size(); i++) {
+        uint16_t start = pages[i] << 8;
+        if (baseline.empty()) {
+            std::memset(&ram[start], 0, 256);
+        } else {
+            std::memcpy(&ram[start], &baseline[start], 256);
+        }
+        notifyCodeModified(start, 256);
+    }
+    bus.clearDirty();
+    bus.resetDevices();
+}
+
+void Memory::setBaseline() {
+    baseline.assign(ram, ram + 65536);
+    bus.clearDirty();
+}
+
+void Memory::saveState(SnapshotWriter& snapshot) const {
+    bus.saveDevices(snapshot);
+}
+
+bool Memory::restoreState(SnapshotReader& snapshot) {
+    uint8_t* image = snapshot.mapRam();
+    if (image) {
+        setBacking(image);
+    } else {
+        if (!snapshot.readRam(storage.data())) {
+            return false;
+        }
+        setBacking(storage.data());
     }
+    
+    // Every page may differ from the baseline now
+    baseline.clear();
+    for (int page = 0; page < 256; page++) {
+        bus.markDirty(page);
+    }
+    notifyCodeModified(0, 65536);
+    
+    return restoreDevices(snapshot);
 }
 
+bool Memory::restoreDevices(SnapshotReader& snapshot) {
+    if (!bus.restoreDevices(snapshot)) {
+        std::cerr << "Error: Snapshot has corrupt device state" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void Memory::restorePage(uint8_t page, const uint8_t* contents) {
+    uint16_t start = page << 8;
+    std::memcpy(&ram[start], contents, 256);
+    bus.markDirty(page);
+    notifyCodeModified(start, 256);
+}
+
+void Memory::setBacking(uint8_t* image) {
+    if (mapping && mapping != image) {
+        SnapshotReader::unmapRam(mapping);
+    }
+    mapping = (image == storage.data()) ? nullptr : image;
+    ram = image;
+    bus.setBacking(ram);
+}
+
+void Memory::attachDevice(Device* device, uint16_t address) {
+    bus.attach(device, address);
+    
+    // Cached code may have read this address as RAM
+    notifyCodeModified(0, 65536);
+}
+
+void Memory::shareBetweenThreads(bool enable) {
+    bus.setLock(enable ? &shared_lock : nullptr);
+    scheduler.setLock(enable ? &shared_lock : nullptr);
+    interrupts.setLock(enable ? &shared_lock : nullptr);
+}
+
+void Memory::addWatcher(MemoryWatcher* watcher) {
+    watchers.push_back(watcher);
+}
+
+void Memory::removeWatcher(MemoryWatcher* watcher) {
+    watchers.erase(std::remove(watchers.begin(), watchers.end(), watcher), watchers.end());
+}
+
+void Memory::notifyCodeModified(uint16_t start, uint32_t count) {
+    for (size_t i = 0; i < watchers.size(); i++) {
+        watchers[i]->onCodeModified(start, count);
+    }
+}
@@ -4,46 +4,165 @@
 #include <cstdint>
 #include <vector>
 #include <iostream>
+#include <mutex>
+#include "bus.h"
+#include "console.h"
+#include "core_info.h"
+#include "dma.h"
+#include "interrupt_controller.h"
+#include "perf_counters.h"
+#include "scheduler.h"
+#include "snapshot.h"
+#include "timer.h"
+
+/**
+ * MemoryWatcher - Notified when bytes in a code page change
+ *
+ * Components that cache anything derived from instruction bytes
+ * (e.g. the CPU's decode cache) register as watchers so that
+ * self-modifying code stays correct.
+ */
+class MemoryWatcher {
+public:
+    virtual ~MemoryWatcher() {}
+    
+    // Bytes [start, start + count) of a code page were modified
+    virtual void onCodeModified(uint16_t start, uint32_t count) = 0;
+};
 
 /**
  * Memory class - Implements 64KB memory with memory-mapped I/O
  * 
  * Memory Map:
- * 0x0000 - 0x00FF: System area
+ * 0x0000 - 0x00FF: System area (interrupt vectors at 0x0000)
  * 0x0100 - 0xFEFF: General RAM
  * 0xFF00 - 0xFFFF: Memory-mapped I/O
+ * 
+ * Accesses are routed by the Bus page table. The interrupt controller,
+ * timer, console, performance counters, core registers and DMA
+ * controller are attached at construction; other devices are added
+ * with attachDevice(). Timed devices schedule events on the Scheduler
+ * instead of being clocked every instruction.
+ * 
+ * The bus tracks which 256-byte pages have been written since the last
+ * reset. reset() restores only those pages from the baseline image
+ * (all zeros until setBaseline() is called), so resetting between runs
+ * of the same program costs time proportional to what it touched.
+ * 
+ * restoreState() maps the RAM image of a snapshot copy-on-write where
+ * the host allows it, so restoring costs no copy; the mapping then
+ * backs the address space until the next restore.
+ * 
+ * Several CPUs on their own threads may share one Memory once
+ * shareBetweenThreads() is on (see multicore.h for the ordering model).
+ * Only slow-path accesses (devices, the first write to a clean page,
+ * writes to code pages) and device events take the shared lock.
+ * Watchers are then notified on the writing core's thread.
  */
 class Memory {
 private:
-    std::vector<uint8_t> ram;  // 64KB of memory
+    std::vector<uint8_t> storage;   // 64KB of memory
+    uint8_t* mapping;               // Mapped snapshot image, if any
+    uint8_t* ram;                   // Current backing: storage or mapping
+    std::vector<uint8_t> baseline;  // Pristine image for reset() (empty: zeros)
+    Bus bus;
+    
+    // Timed device events
+    Scheduler scheduler;
     
-    // Memory-mapped I/O registers
-    uint8_t timer_ctrl;        // 0xFF00
-    uint8_t console_out;       // 0xFF01
-    uint8_t console_in;        // 0xFF02
-    uint8_t timer_value;       // 0xFF03
+    // Built-in devices
+    InterruptController interrupts;
+    Timer timer;
+    Console console;
+    PerfCounters perf;
+    CoreInfo cores;
+    DmaController dma;
     
-    // Timer state
-    int timer_counter;
+    std::recursive_mutex shared_lock;  // Slow path and device events (shared mode)
+    std::vector<MemoryWatcher*> watchers;
+    
+    void notifyCodeModified(uint16_t start, uint32_t count);
+    void setBacking(uint8_t* image);
+    
+    Memory(const Memory&);
+    Memory& operator=(const Memory&);
     
 public:
     Memory();
+    ~Memory();
     
     // Read and write operations
-    uint8_t read(uint16_t address);
-    void write(uint16_t address, uint8_t value);
+    uint8_t read(uint16_t address) { return bus.read(address); }
+    void write(uint16_t address, uint8_t value) {
+        if (bus.write(address, value)) {
+            notifyCodeModified(address, 1);
+        }
+    }
+    
+    // Atomic compare-and-swap: store `desired` if the byte holds
+    // `expected`. Returns the old byte (== expected on success).
+    uint8_t compareExchange(uint16_t address, uint8_t expected, uint8_t desired) {
+        uint8_t value = expected;
+        if (bus.compareExchange(address, value, desired)) {
+            notifyCodeModified(address, 1);
+        }
+        return value;
+    }
+    
+    // Block transfers for DMA, within RAM below the I/O region
+    void copyBlock(uint16_t destination, uint16_t source, uint16_t count) {
+        if (bus.copyBlock(destination, source, count)) {
+            notifyCodeModified(destination, count);
+        }
+    }
+    void fillBlock(uint16_t destination, uint8_t value, uint16_t count) {
+        if (bus.fillBlock(destination, value, count)) {
+            notifyCodeModified(destination, count);
+        }
+    }
     
     // Memory operations
-    void loadProgram(const std::vector<uint8_t>& program, uint16_t start_address = 0x0100);
+    bool loadProgram(const std::vector<uint8_t>& program, uint16_t start_address = 0x0100);
     void dump(uint16_t start, uint16_t end);
-    void reset();
+    void reset();          // Restore the baseline and reset devices
+    void setBaseline();    // Make the current RAM contents the baseline
+    
+    // Snapshots: RAM image plus a section per stateful device
+    void saveState(SnapshotWriter& snapshot) const;
+    bool restoreState(SnapshotReader& snapshot);
+    bool restoreDevices(SnapshotReader& snapshot);
     
-    // Timer operations
-    void updateTimer();
+    // Time-travel checkpoints: pages written since the last checkpoint
+    void trackCheckpoints(bool enable) { bus.trackDirty(Bus::DIRTY_CHECKPOINT, enable); }
+    const std::vector<uint8_t>& getCheckpointPages() const {
+        return bus.getDirtyPages(Bus::DIRTY_CHECKPOINT);
+    }
+    void clearCheckpointPages() { bus.clearDirty(Bus::DIRTY_CHECKPOINT); }
+    void restorePage(uint8_t page, const uint8_t* contents);
+    
+    // Let devices finish buffered work (e.g. console output)
+    void sync() { bus.syncDevices(); }
+    
+    // Devices
+    void attachDevice(Device* device, uint16_t address);
+    bool isRamPage(uint8_t page) const { return bus.isRamPage(page); }
+    Scheduler& getScheduler() { return scheduler; }
+    void setInterceptor(IoInterceptor* hook) { bus.setInterceptor(hook); }
+    Console& getConsole() { return console; }
+    PerfCounters& getPerfCounters() { return perf; }
+    CoreInfo& getCoreInfo() { return cores; }
+    InterruptController& getInterrupts() { return interrupts; }
+    
+    // Let CPUs on several threads use this memory at once
+    void shareBetweenThreads(bool enable);
+    
+    // Code page tracking
+    void addWatcher(MemoryWatcher* watcher);
+    void removeWatcher(MemoryWatcher* watcher);
+    void markCodePage(uint16_t address) { bus.watchPage(address >> 8); }
     
     // Get pointer to raw memory (for debugging)
-    const uint8_t* getRawMemory() const { return ram.data(); }
+    const uint8_t* getRawMemory() const { return ram; }
 };
 
 #endif // MEMORY_H
-
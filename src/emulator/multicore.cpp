@@ -0,0 +1,93 @@
+#include "multicore.h"
+#include <algorithm>
+#include <iostream>
+#include <thread>
+
+Multicore::Multicore(CPU& cpu, Memory& mem, unsigned cores)
+    : primary(cpu), memory(mem), runaway(cores, 0), started(false) {
+    memory.shareBetweenThreads(true);
+    memory.getCoreInfo().setCoreCount(cores);
+    for (unsigned i = 1; i < cores; i++) {
+        others.push_back(std::unique_ptr<CPU>(new CPU(&memory, primary.getEngine(), i)));
+        others.back()->setCycleLimit(primary.getCycleLimit());
+    }
+    
+    // Split the stack page between the cores
+    for (unsigned i = 0; i < cores; i++) {
+        core(i).setRegister(7, 0xFF - i * (256 / cores));
+    }
+}
+
+Multicore::~Multicore() {
+    others.clear();
+    memory.getCoreInfo().setCoreCount(1);
+    memory.shareBetweenThreads(false);
+}
+
+bool Multicore::run() {
+    std::cout << "Starting " << size() << " cores at PC=0x" << std::hex << primary.getPC()
+              << std::dec << std::endl;
+    
+    // Each core's decode cache must know its thread before any core
+    // writes to memory
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < size(); i++) {
+        threads.push_back(std::thread(&Multicore::runCore, this, i));
+        core(i).bindToThread(threads.back().get_id());
+    }
+    primary.bindToThread(std::this_thread::get_id());
+    started.store(true, std::memory_order_release);
+    runCore(0);
+    for (size_t i = 0; i < threads.size(); i++) {
+        threads[i].join();
+    }
+    started.store(false, std::memory_order_relaxed);
+    
+    bool halted = true;
+    for (unsigned i = 0; i < size(); i++) {
+        if (runaway[i]) {
+            std::cerr << "Error: CPU runaway detected on core " << i << " (PC=0x" << std::hex
+                      << core(i).getPC() << ", cycles=" << std::dec << core(i).getCycleCount()
+                      << ")" << std::endl;
+            halted = false;
+        }
+    }
+    
+    // Buffered device output comes before the summary
+    memory.sync();
+    
+    uint64_t cycles = 0;
+    for (unsigned i = 0; i < size(); i++) {
+        cycles = std::max(cycles, core(i).getCycleCount());
+    }
+    std::cout << "\nCores halted after " << cycles << " cycles" << std::endl;
+    return halted;
+}
+
+void Multicore::runCore(unsigned index) {
+    CPU& cpu = core(index);
+    CoreInfo::setCurrentCore(index);
+    while (!started.load(std::memory_order_acquire)) {
+        std::this_thread::yield();
+    }
+    
+    // Run in slices, picking up other cores' code changes in between
+    uint64_t end = cpu.getCycleLimit();
+    while (!cpu.isHalted()) {
+        cpu.applyRemoteCodeChanges();
+        cpu.setCycleLimit(std::min(end, cpu.getCycleCount() + SLICE - 1));
+        if (!cpu.runUntilHalt() && (cpu.isHalted() || cpu.getCycleCount() > end)) {
+            runaway[index] = 1;
+            break;
+        }
+    }
+    cpu.setCycleLimit(end);
+    CoreInfo::setCurrentCore(0);
+}
+
+void Multicore::printState() {
+    for (unsigned i = 0; i < size(); i++) {
+        std::cout << "Core " << i << ": ";
+        core(i).printState();
+    }
+}
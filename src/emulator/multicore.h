@@ -0,0 +1,75 @@
+#ifndef MULTICORE_H
+#define MULTICORE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "cpu.h"
+
+/**
+ * Multicore class - Several SC8 cores sharing one Memory
+ *
+ * Core 0 is the CPU the caller already has; the others are created
+ * here with the same engine. Every core starts at 0x0100 with its own
+ * slice of the stack page (core k's R7 starts at 0xFF - k * 256 / N)
+ * and finds out who it is by reading CORE_ID (0xFF08) and CORE_COUNT
+ * (0xFF09). run() puts each core on its own host thread (core 0 on the
+ * caller's) until every core has halted or hit its cycle limit.
+ *
+ * Memory model:
+ *
+ * - Each core sees its own accesses in program order.
+ * - Plain byte accesses to RAM are atomic but unordered between cores:
+ *   a core may see another core's stores late and in any order.
+ * - CAS is a full fence: every access before it in program order is
+ *   visible to all cores before any access after it, and all CAS
+ *   operations happen in one total order.
+ * - Device registers (0xFF00-0xFFFF) are serialized: accesses to them
+ *   from all cores happen in one total order, each a full fence.
+ * - A DMA transfer writes its block as plain byte stores, in no
+ *   particular order, when it completes. Its completion (DMA_STATUS
+ *   or IRQ_DMA) is a device access, so a core that has seen it also
+ *   sees the whole block.
+ * - Code rewritten by one core is seen by another core's instruction
+ *   fetch at that core's next slice boundary (every SLICE cycles).
+ *   Publish new code with a CAS before other cores jump to it.
+ *
+ * On the host, direct RAM accesses and DMA block transfers are relaxed
+ * atomic byte loads and stores, and CAS is a host atomic; only slow-path
+ * bus accesses and device events take the memory's lock. Device time is
+ * core 0's cycle count, so the timer stops once core 0 halts.
+ */
+class Multicore {
+private:
+    CPU& primary;
+    Memory& memory;
+    std::vector<std::unique_ptr<CPU> > others;   // Cores 1..N-1
+    std::vector<char> runaway;                    // Per core
+    std::atomic<bool> started;                    // Every core is bound
+    
+    void runCore(unsigned index);
+    
+    Multicore(const Multicore&);
+    Multicore& operator=(const Multicore&);
+    
+public:
+    static const unsigned MAX_CORES = 8;
+    
+    // Cycles between a core's checks for code rewritten by other cores
+    static const uint64_t SLICE = 1024;
+    
+    // `cpu` becomes core 0 of `cores` (2..MAX_CORES) sharing `mem`
+    Multicore(CPU& cpu, Memory& mem, unsigned cores);
+    ~Multicore();
+    
+    unsigned size() const { return static_cast<unsigned>(others.size()) + 1; }
+    CPU& core(unsigned index) { return index == 0 ? primary : *others[index - 1]; }
+    
+    // Run every core to HALT; false (with a message) if any ran away
+    bool run();
+    
+    void printState();
+};
+
+#endif // MULTICORE_H
@@ -0,0 +1,132 @@
+#include "perf_counters.h"
+
+namespace {
+
+const char* const CLASS_NAMES[] = {
+    "arith", "logic", "compare", "data", "stack", "branch", "call", "system"
+};
+
+const char* const BRANCH_NAMES[] = { "jz", "jnz", "jc", "jnc" };
+
+} // namespace
+
+PerfCounters::PerfCounters(Scheduler& sched) : scheduler(sched) {
+    reset();
+}
+
+uint64_t PerfCounters::value(int counter) const {
+    return counter == PERF_CYCLES ? scheduler.now() : counts[counter];
+}
+
+uint64_t PerfCounters::guestValue(int counter) const {
+    if (counter == PERF_MAX_STACK_DEPTH) {
+        return window_depth;
+    }
+    return value(counter) - base[counter];
+}
+
+void PerfCounters::writeJson(std::ostream& out) const {
+    out << "{\"cycles\":" << value(PERF_CYCLES)
+        << ",\"instructions\":" << counts[PERF_INSTRUCTIONS]
+        << ",\"classes\":{";
+    for (int i = 0; i < PERF_CLASS_SYSTEM - PERF_CLASS_ARITH + 1; i++) {
+        out << (i ? "," : "") << "\"" << CLASS_NAMES[i] << "\":" << counts[PERF_CLASS_ARITH + i];
+    }
+    out << "},\"branches\":{";
+    for (int i = 0; i < 4; i++) {
+        out << (i ? "," : "") << "\"" << BRANCH_NAMES[i] << "\":{\"taken\":"
+            << counts[PERF_JZ_TAKEN + 2 * i] << ",\"not_taken\":"
+            << counts[PERF_JZ_NOT_TAKEN + 2 * i] << "}";
+    }
+    out << "},\"loads\":" << counts[PERF_LOADS]
+        << ",\"stores\":" << counts[PERF_STORES]
+        << ",\"mmio_reads\":" << counts[PERF_MMIO_READS]
+        << ",\"mmio_writes\":" << counts[PERF_MMIO_WRITES]
+        << ",\"pushes\":" << counts[PERF_PUSHES]
+        << ",\"pops\":" << counts[PERF_POPS]
+        << ",\"max_stack_depth\":" << counts[PERF_MAX_STACK_DEPTH] << "}\n";
+}
+
+uint8_t PerfCounters::read(uint16_t address) {
+    switch (address) {
+        case IO_PERF_SELECT:
+            return select;
+        case IO_PERF_CTRL:
+            return PERF_COUNT;
+        default:
+            if (address >= IO_PERF_DATA && address < IO_PERF_DATA + 4) {
+                return (latch >> (8 * (address - IO_PERF_DATA))) & 0xFF;
+            }
+            return 0;
+    }
+}
+
+void PerfCounters::write(uint16_t address, uint8_t value) {
+    if (address == IO_PERF_SELECT) {
+        select = value;
+    } else if (address == IO_PERF_CTRL) {
+        if (value & 0x02) {
+            for (int i = 0; i < PERF_COUNT; i++) {
+                base[i] = this->value(i);
+            }
+            window_depth = 0;
+        }
+        if (!(value & 0x01)) {
+            return;
+        }
+    } else {
+        return;  // PERF_DATA is read-only
+    }
+
+    // Unknown counters read as zero
+    latch = select < PERF_COUNT ? static_cast<uint32_t>(guestValue(select)) : 0;
+}
+
+void PerfCounters::reset() {
+    for (int i = 0; i < PERF_COUNT; i++) {
+        counts[i] = 0;
+        base[i] = 0;
+    }
+    window_depth = 0;
+    select = 0;
+    latch = 0;
+}
+
+void PerfCounters::save(SnapshotWriter& snapshot) const {
+    snapshot.beginSection("PERF");
+    snapshot.putU8(PERF_COUNT);
+    for (int i = 0; i < PERF_COUNT; i++) {
+        snapshot.putU64(counts[i]);
+        snapshot.putU64(base[i]);
+    }
+    snapshot.putU8(window_depth);
+    snapshot.putU8(select);
+    snapshot.putU32(latch);
+    snapshot.endSection();
+}
+
+bool PerfCounters::restore(SnapshotReader& snapshot) {
+    reset();
+    if (!snapshot.enterSection("PERF")) {
+        return true;
+    }
+
+    // Counters added later are absent from older snapshots and stay zero
+    int saved = snapshot.getU8();
+    for (int i = 0; i < saved; i++) {
+        uint64_t count = snapshot.getU64();
+        uint64_t guest_base = snapshot.getU64();
+        if (i < PERF_COUNT) {
+            counts[i] = count;
+            base[i] = guest_base;
+        }
+    }
+    window_depth = snapshot.getU8();
+    select = snapshot.getU8();
+    latch = snapshot.getU32();
+    if (!snapshot.good()) {
+        reset();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,107 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <cstdint>
+#include <ostream>
+#include "device.h"
+#include "scheduler.h"
+
+/**
+ * Performance counter numbers (PERF_SELECT values)
+ */
+enum PerfCounter : uint8_t {
+    PERF_CYCLES = 0,
+    PERF_INSTRUCTIONS,
+
+    // Instructions retired per class
+    PERF_CLASS_ARITH,          // ADD ... DEC, MULH, DIV, MOD
+    PERF_CLASS_LOGIC,          // AND ... SHR
+    PERF_CLASS_COMPARE,        // CMP, CMPI
+    PERF_CLASS_DATA,           // LOAD, STORE, LOADI, CAS
+    PERF_CLASS_STACK,          // PUSH, POP
+    PERF_CLASS_BRANCH,         // JMP, JZ, JNZ, JC, JNC
+    PERF_CLASS_CALL,           // CALL, RET, RETI
+    PERF_CLASS_SYSTEM,         // HALT, NOP, WAIT, invalid opcodes
+
+    // Conditional branches, taken / not taken
+    PERF_JZ_TAKEN,
+    PERF_JZ_NOT_TAKEN,
+    PERF_JNZ_TAKEN,
+    PERF_JNZ_NOT_TAKEN,
+    PERF_JC_TAKEN,
+    PERF_JC_NOT_TAKEN,
+    PERF_JNC_TAKEN,
+    PERF_JNC_NOT_TAKEN,
+
+    // Data accesses by LOAD/STORE/CAS, split at the I/O region
+    PERF_LOADS,
+    PERF_STORES,
+    PERF_MMIO_READS,
+    PERF_MMIO_WRITES,
+
+    // Stack bytes (CALL and RET move two, RETI three) and deepest
+    // stack in bytes
+    PERF_PUSHES,
+    PERF_POPS,
+    PERF_MAX_STACK_DEPTH,
+
+    PERF_COUNT
+};
+
+/**
+ * PerfCounters class - Hardware-style event counters
+ *
+ * The counters are filled in by StatsTrace, so apart from PERF_CYCLES
+ * (taken from the scheduler clock) they only count while the emulator
+ * runs with --stats. The guest reads them through four registers:
+ *
+ * 0xFF10 PERF_SELECT  Write: select a counter and latch its value
+ *                     Read: the selected counter number
+ * 0xFF11 PERF_CTRL    Write: bit 0 re-latches the selected counter,
+ *                     bit 1 zeroes the guest's view of all counters
+ *                     (applied first). Read: number of counters
+ * 0xFF12 PERF_DATA    Latched value, bits 0-7 (bits 8-31 in
+ *  -0xFF15            0xFF13-0xFF15)
+ *
+ * Zeroing from the guest only moves the guest's baseline; the host
+ * report always covers the whole run.
+ */
+class PerfCounters : public Device {
+private:
+    Scheduler& scheduler;
+    uint64_t counts[PERF_COUNT];
+    uint64_t base[PERF_COUNT];      // Guest baseline (see PERF_CTRL)
+    uint8_t window_depth;           // Deepest stack since the guest zeroed
+    uint8_t select;
+    uint32_t latch;
+
+    uint64_t value(int counter) const;
+    uint64_t guestValue(int counter) const;
+
+public:
+    PerfCounters(Scheduler& sched);
+
+    // Event counting (StatsTrace)
+    void count(PerfCounter counter) { counts[counter]++; }
+    void count(PerfCounter counter, uint64_t amount) { counts[counter] += amount; }
+    void noteStackDepth(uint8_t depth) {
+        if (depth > counts[PERF_MAX_STACK_DEPTH]) {
+            counts[PERF_MAX_STACK_DEPTH] = depth;
+        }
+        if (depth > window_depth) {
+            window_depth = depth;
+        }
+    }
+
+    // Host report: one JSON object with every counter
+    void writeJson(std::ostream& out) const;
+
+    // Device interface
+    uint8_t read(uint16_t address);
+    void write(uint16_t address, uint8_t value);
+    void reset();
+    void save(SnapshotWriter& snapshot) const;
+    bool restore(SnapshotReader& snapshot);
+};
+
+#endif // PERF_COUNTERS_H
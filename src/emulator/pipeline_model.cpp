@@ -0,0 +1,261 @@
+#include "pipeline_model.h"
+#include <algorithm>
+#include <iomanip>
+#include "cpu.h"
+
+namespace {
+
+const char* const STALL_NAMES[] = {
+    "Load-use", "Data (no forwarding)", "Taken-branch redirect", "Branch mispredict", "Return"
+};
+
+/**
+ * Register slots an instruction reads and writes (bit 8 is the flags)
+ */
+struct Operands {
+    uint16_t reads;
+    uint16_t writes;
+    uint16_t loads;     // Written slots whose value comes from memory
+};
+
+Operands operandsOf(const DecodedOp& op) {
+    const uint16_t FLAGS = 1 << 8;
+    const uint16_t SP = 1 << 7;
+    uint16_t rd = 1 << op.rd;
+    uint16_t rs1 = 1 << op.rs1;
+    uint16_t rs2 = 1 << op.rs2;
+
+    Operands operands = { 0, 0, 0 };
+    switch (op.handler) {
+        case 0x00: case 0x02: case 0x04: // ADD, SUB, MUL
+        case 0x07: case 0x09: case 0x0B: // AND, OR, XOR
+        case HANDLER_MULH: case HANDLER_DIV: case HANDLER_MOD:
+            operands.reads = rs1 | rs2;
+            operands.writes = rd | FLAGS;
+            break;
+        case 0x01: case 0x03: case 0x05: // ADDI, SUBI, INC
+        case 0x06: case 0x08: case 0x0A: // DEC, ANDI, ORI
+            operands.reads = rd;
+            operands.writes = rd | FLAGS;
+            break;
+        case 0x0C: // NOT Rd, Rs
+            operands.reads = rs1;
+            operands.writes = rd | FLAGS;
+            break;
+        case 0x0D: case 0x0E: // SHL, SHR Rd, Rs
+            operands.reads = rd | rs1;
+            operands.writes = rd | FLAGS;
+            break;
+        case 0x10: // LOAD
+            operands.writes = rd;
+            operands.loads = rd;
+            break;
+        case 0x11: // STORE
+            operands.reads = rd;
+            break;
+        case HANDLER_LOAD_INDIRECT: // Rd = [Rp:Rp+1 + offset], pair maybe incremented
+            operands.reads = rs1 | (rs1 << 1);
+            operands.writes = rd | (op.rs2 ? rs1 | (rs1 << 1) : 0);
+            operands.loads = rd;
+            break;
+        case HANDLER_STORE_INDIRECT:
+            operands.reads = rd | rs1 | (rs1 << 1);
+            operands.writes = op.rs2 ? rs1 | (rs1 << 1) : 0;
+            break;
+        case 0x12: // LOADI
+            operands.writes = rd;
+            break;
+        case 0x17: // CAS Rd, [addr]: compares with R0 and loads into it
+            operands.reads = rd | 1;
+            operands.writes = 1 | FLAGS;
+            operands.loads = 1 | FLAGS;
+            break;
+        case 0x13: // CMP Rs1, Rs2 (in the Rd and Rs1 fields)
+            operands.reads = rd | rs1;
+            operands.writes = FLAGS;
+            break;
+        case 0x14: // CMPI
+            operands.reads = rd;
+            operands.writes = FLAGS;
+            break;
+        case 0x15: // PUSH
+            operands.reads = rd | SP;
+            operands.writes = SP;
+            break;
+        case 0x16: // POP
+            operands.reads = SP;
+            operands.writes = rd | SP;
+            operands.loads = rd;
+            break;
+        case 0x19: case 0x1A: case 0x1B: case 0x1C: // Jcc
+            operands.reads = FLAGS;
+            break;
+        case 0x1D: case 0x1E: // CALL, RET
+            operands.reads = SP;
+            operands.writes = SP;
+            break;
+        case HANDLER_RETI: // Pops the flags
+            operands.reads = SP;
+            operands.writes = SP | FLAGS;
+            operands.loads = FLAGS;
+            break;
+    }
+    return operands;
+}
+
+// JMP, Jcc, CALL, RET and RETI
+bool isControl(const DecodedOp& op) {
+    return (op.handler >= 0x18 && op.handler <= 0x1E) || op.handler == HANDLER_RETI;
+}
+
+} // namespace
+
+PipelineModel::PipelineModel(std::unique_ptr<BranchPredictor> branch_predictor, bool forward)
+    : predictor(std::move(branch_predictor)), forwarding(forward), instructions(0),
+      last_ex(2), redirect(0), redirect_kind(0), redirect_pc(0), pc_stalls(65536, 0),
+      branches(0), mispredicts(0), fetch_pc(0) {
+    for (int i = 0; i < SLOTS; i++) {
+        ready[i] = 0;
+        loaded[i] = false;
+    }
+    for (int i = 0; i < STALL_KINDS; i++) {
+        stalls[i] = 0;
+    }
+    prediction.taken = false;
+    prediction.target_known = false;
+    prediction.target = 0;
+}
+
+void PipelineModel::fetch(const CPU& cpu, const DecodedOp& op) {
+    fetch_pc = cpu.getPC();
+    if (isControl(op)) {
+        prediction = predictor->predict(fetch_pc, op);
+    }
+}
+
+void PipelineModel::stall(int kind, uint16_t pc, uint64_t cycles) {
+    stalls[kind] += cycles;
+    pc_stalls[pc] += cycles;
+}
+
+void PipelineModel::retire(const CPU& cpu, const DecodedOp& op) {
+    // Issue one cycle after the previous instruction, or once fetch has
+    // been redirected past a control transfer
+    uint64_t ex = last_ex + 1;
+    if (redirect > ex) {
+        stall(redirect_kind, redirect_pc, redirect - ex);
+        ex = redirect;
+    }
+
+    // Wait for the operands
+    Operands operands = operandsOf(op);
+    uint64_t data = ex;
+    bool from_load = false;
+    for (int slot = 0; slot < SLOTS; slot++) {
+        if ((operands.reads & (1 << slot)) && ready[slot] > data) {
+            data = ready[slot];
+            from_load = loaded[slot];
+        }
+    }
+    if (data > ex) {
+        stall(forwarding && from_load ? STALL_LOAD_USE : STALL_DATA, fetch_pc, data - ex);
+        ex = data;
+    }
+
+    for (int slot = 0; slot < SLOTS; slot++) {
+        if (operands.writes & (1 << slot)) {
+            loaded[slot] = (operands.loads & (1 << slot)) != 0;
+            ready[slot] = ex + (!forwarding ? 3 : loaded[slot] ? 2 : 1);
+        }
+    }
+
+    // Control hazards delay the next instruction
+    redirect = 0;
+    if (isControl(op)) {
+        uint16_t next = cpu.getPC();
+        bool conditional = op.handler != 0x18 && op.handler < 0x1D;
+        bool taken = !conditional || next != static_cast<uint16_t>(fetch_pc + op.length);
+        bool target_hit = prediction.target_known && prediction.target == next;
+
+        int penalty = 0;
+        if (conditional) {
+            branches++;
+            if (prediction.taken != taken) {
+                mispredicts++;
+                penalty = 2;
+                redirect_kind = STALL_MISPREDICT;
+            } else if (taken && !target_hit) {
+                penalty = 1;
+                redirect_kind = STALL_REDIRECT;
+            }
+        } else if (op.handler == 0x1E || op.handler == HANDLER_RETI) {
+            if (!target_hit) {
+                penalty = 3;
+                redirect_kind = STALL_RETURN;
+            }
+        } else if (!target_hit) { // JMP, CALL
+            penalty = 1;
+            redirect_kind = STALL_REDIRECT;
+        }
+        predictor->update(fetch_pc, op, taken, next);
+
+        if (penalty > 0) {
+            redirect = ex + 1 + penalty;
+            redirect_pc = fetch_pc;
+        }
+    }
+
+    last_ex = ex;
+    instructions++;
+}
+
+void PipelineModel::report(std::ostream& stream, const SymbolMap& symbols, size_t top) const {
+    uint64_t cycles = getCycles();
+    std::ios::fmtflags saved = stream.flags();
+    stream << "\n=== Pipeline Model ===" << std::endl;
+    stream << "5-stage in-order, " << predictor->name() << " predictor, forwarding "
+           << (forwarding ? "on" : "off") << std::endl;
+    stream << "Instructions: " << instructions << std::endl;
+    stream << "Cycles:       " << cycles << std::endl;
+    if (instructions == 0) {
+        stream.flags(saved);
+        return;
+    }
+    stream << "CPI:          " << std::fixed << std::setprecision(3)
+           << static_cast<double>(cycles) / instructions << std::endl;
+
+    stream << std::setfill(' ') << "\n  Stall                      Cycles   Share" << std::endl;
+    stream << "  " << std::left << std::setw(24) << "Pipeline fill" << std::right
+           << std::setw(10) << 4 << std::setw(7) << std::setprecision(2)
+           << (100.0 * 4 / cycles) << "%" << std::endl;
+    for (int i = 0; i < STALL_KINDS; i++) {
+        stream << "  " << std::left << std::setw(24) << STALL_NAMES[i] << std::right
+               << std::setw(10) << stalls[i] << std::setw(7)
+               << (100.0 * stalls[i] / cycles) << "%" << std::endl;
+    }
+
+    if (branches > 0) {
+        stream << "\nConditional branches: " << branches << ", mispredicted " << mispredicts
+               << " (" << (100.0 * mispredicts / branches) << "%)" << std::endl;
+    }
+
+    // Where layout changes would pay off
+    std::vector<uint16_t> pcs;
+    for (int pc = 0; pc < 65536; pc++) {
+        if (pc_stalls[pc] > 0) {
+            pcs.push_back(pc);
+        }
+    }
+    std::stable_sort(pcs.begin(), pcs.end(), [this](uint16_t a, uint16_t b) {
+        return pc_stalls[a] > pc_stalls[b];
+    });
+    if (!pcs.empty()) {
+        stream << "\n  PC      Location              Stall cycles" << std::endl;
+    }
+    for (size_t i = 0; i < pcs.size() && i < top; i++) {
+        stream << "  0x" << std::hex << std::setw(4) << std::setfill('0') << pcs[i] << std::dec
+               << std::setfill(' ') << "  " << std::left << std::setw(20) << symbols.describe(pcs[i])
+               << std::right << std::setw(14) << pc_stalls[pcs[i]] << std::endl;
+    }
+    stream.flags(saved);
+}
@@ -0,0 +1,89 @@
+#ifndef PIPELINE_MODEL_H
+#define PIPELINE_MODEL_H
+
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <vector>
+#include "branch_predictor.h"
+#include "decode_cache.h"
+#include "symbol_map.h"
+
+class CPU;
+
+/**
+ * PipelineModel - Trace policy that times a 5-stage pipelined SC8
+ *
+ * Models a classic in-order IF/ID/EX/MEM/WB pipeline running the
+ * instruction stream the CPU retires, so its retirement order is the
+ * CPU's by construction and only the timing differs. Each instruction
+ * enters EX one cycle after the previous one unless it is held back:
+ *
+ * - Data hazards: a register or flags value can be used by EX one
+ *   cycle after the producer's EX with forwarding (two after a LOAD or
+ *   POP, the load-use stall), or three cycles after it without
+ * - Redirects: a taken JMP/CALL/Jcc whose target the predictor did not
+ *   supply at fetch costs one bubble (target known in ID)
+ * - Mispredicts: a conditional branch resolves in EX, so a wrong
+ *   direction costs two bubbles
+ * - Returns: a RET's or RETI's target is read in MEM, so an
+ *   unpredicted return costs three bubbles
+ *
+ * Cycles are counted to the last instruction's WB, so an empty
+ * pipeline adds four fill cycles. Stall cycles are charged to the
+ * stalled instruction for data hazards and to the branch for control
+ * hazards. Interrupt entry is not an instruction and is not modeled.
+ */
+class PipelineModel {
+private:
+    enum Stall {
+        STALL_LOAD_USE,
+        STALL_DATA,         // Any RAW stall when forwarding is off
+        STALL_REDIRECT,
+        STALL_MISPREDICT,
+        STALL_RETURN,
+        STALL_KINDS
+    };
+
+    // Register slots: R0-R7, then the flags
+    static const int SLOTS = 9;
+
+    std::unique_ptr<BranchPredictor> predictor;
+    bool forwarding;
+
+    uint64_t instructions;
+    uint64_t last_ex;               // EX cycle of the previous instruction
+    uint64_t ready[SLOTS];          // First cycle EX can use each value
+    bool loaded[SLOTS];             // Value comes from a LOAD or POP
+    uint64_t redirect;              // Earliest EX for the next instruction
+    int redirect_kind;
+    uint16_t redirect_pc;
+
+    uint64_t stalls[STALL_KINDS];
+    std::vector<uint64_t> pc_stalls;
+    uint64_t branches;              // Conditional branches
+    uint64_t mispredicts;
+
+    // The instruction in flight
+    uint16_t fetch_pc;
+    BranchPrediction prediction;
+
+    void stall(int kind, uint16_t pc, uint64_t cycles);
+
+public:
+    static const bool enabled = true;
+
+    PipelineModel(std::unique_ptr<BranchPredictor> branch_predictor, bool forward = true);
+
+    void fetch(const CPU& cpu, const DecodedOp& op);
+    void execute(const CPU&, const DecodedOp&) {}
+    void retire(const CPU& cpu, const DecodedOp& op);
+
+    uint64_t getInstructions() const { return instructions; }
+    uint64_t getCycles() const { return instructions ? last_ex + 2 : 0; }
+
+    // CPI, stall breakdown, prediction accuracy and the worst PCs
+    void report(std::ostream& stream, const SymbolMap& symbols, size_t top = 10) const;
+};
+
+#endif // PIPELINE_MODEL_H
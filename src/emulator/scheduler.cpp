@@ -0,0 +1,70 @@
+#include "scheduler.h"
+
+Scheduler::Scheduler() : next_deadline(NEVER), clock(nullptr), lock(nullptr) {
+}
+
+void Scheduler::schedule(EventHandler* handler, uint64_t deadline) {
+    for (size_t i = 0; i < events.size(); i++) {
+        if (events[i].handler == handler) {
+            events[i].deadline = deadline;
+            updateNextDeadline();
+            return;
+        }
+    }
+
+    Event event;
+    event.deadline = deadline;
+    event.handler = handler;
+    events.push_back(event);
+    updateNextDeadline();
+}
+
+void Scheduler::cancel(EventHandler* handler) {
+    for (size_t i = 0; i < events.size(); i++) {
+        if (events[i].handler == handler) {
+            events.erase(events.begin() + i);
+            break;
+        }
+    }
+    updateNextDeadline();
+}
+
+void Scheduler::clear() {
+    events.clear();
+    __atomic_store_n(&next_deadline, NEVER, __ATOMIC_RELAXED);
+}
+
+void Scheduler::runDue() {
+    std::unique_lock<std::recursive_mutex> guard;
+    if (lock) {
+        guard = std::unique_lock<std::recursive_mutex>(*lock);
+    }
+    uint64_t current = now();
+
+    while (next_deadline <= current) {
+        // Remove the earliest event before firing it, so the handler
+        // can schedule its next one
+        size_t earliest = 0;
+        for (size_t i = 1; i < events.size(); i++) {
+            if (events[i].deadline < events[earliest].deadline) {
+                earliest = i;
+            }
+        }
+        Event event = events[earliest];
+        events.erase(events.begin() + earliest);
+        updateNextDeadline();
+
+        event.handler->onEvent(event.deadline);
+    }
+}
+
+void Scheduler::updateNextDeadline() {
+    uint64_t earliest = NEVER;
+    for (size_t i = 0; i < events.size(); i++) {
+        if (events[i].deadline < earliest) {
+            earliest = events[i].deadline;
+        }
+    }
+    // Read by the CPU without the lock
+    __atomic_store_n(&next_deadline, earliest, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,78 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+/**
+ * EventHandler - Device callback for a scheduled event
+ */
+class EventHandler {
+public:
+    virtual ~EventHandler() {}
+
+    // The event scheduled for `deadline` is due
+    virtual void onEvent(uint64_t deadline) = 0;
+};
+
+/**
+ * Scheduler class - Cycle-deadline event queue for timed devices
+ *
+ * Devices schedule an event for the cycle at which something happens
+ * (e.g. the timer reaching zero) instead of being clocked after every
+ * instruction. The execution engines compare the cycle count against
+ * nextDeadline() and only call runDue() once it has been reached.
+ *
+ * Time is the CPU's cycle count, read through the clock pointer
+ * installed by the CPU (core 0 when several cores share the memory).
+ * Each handler has at most one pending event; scheduling it again
+ * replaces the old one.
+ *
+ * Bus accesses from other cores read the clock while core 0 advances
+ * it; they see some recent cycle.
+ *
+ * With a lock installed runDue() holds it while firing events. Devices
+ * call schedule() and cancel() from bus accesses, which the Bus already
+ * serializes under the same lock (see Memory::shareBetweenThreads).
+ * The lock is recursive, so a handler may itself access the bus.
+ */
+class Scheduler {
+public:
+    static const uint64_t NEVER = UINT64_MAX;
+
+private:
+    struct Event {
+        uint64_t deadline;
+        EventHandler* handler;
+    };
+
+    std::vector<Event> events;
+    uint64_t next_deadline;    // Earliest pending deadline, or NEVER
+    const uint64_t* clock;     // Current cycle (owned by the CPU)
+    std::recursive_mutex* lock; // Shared with the Bus, or nullptr
+
+    void updateNextDeadline();
+
+public:
+    Scheduler();
+
+    // Time source
+    void setClock(const uint64_t* cycle_counter) { clock = cycle_counter; }
+    uint64_t now() const { return clock ? __atomic_load_n(clock, __ATOMIC_RELAXED) : 0; }
+    void setLock(std::recursive_mutex* mutex) { lock = mutex; }
+
+    // Event management
+    void schedule(EventHandler* handler, uint64_t deadline);
+    void cancel(EventHandler* handler);
+    void clear();
+
+    // Earliest cycle at which runDue() has work to do
+    uint64_t nextDeadline() const { return __atomic_load_n(&next_deadline, __ATOMIC_RELAXED); }
+
+    // Fire every event whose deadline has been reached, in deadline order
+    void runDue();
+};
+
+#endif // SCHEDULER_H
@@ -0,0 +1,293 @@
+#include "snapshot.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const char SNAPSHOT_MAGIC[8] = { 'S', 'C', '8', 'S', 'N', 'A', 'P', '\0' };
+
+void storeU32(uint8_t* out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out[i] = (value >> (8 * i)) & 0xFF;
+    }
+}
+
+uint32_t loadU32(const uint8_t* in) {
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++) {
+        value |= static_cast<uint32_t>(in[i]) << (8 * i);
+    }
+    return value;
+}
+
+bool writeAll(int fd, const uint8_t* data, size_t size) {
+    while (size > 0) {
+        ssize_t count = ::write(fd, data, size);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            return false;
+        }
+        data += count;
+        size -= count;
+    }
+    return true;
+}
+
+bool readAll(int fd, uint8_t* data, size_t size, off_t offset) {
+    while (size > 0) {
+        ssize_t count = ::pread(fd, data, size, offset);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            return false;
+        }
+        data += count;
+        size -= count;
+        offset += count;
+    }
+    return true;
+}
+
+} // namespace
+
+// Writer
+
+SnapshotWriter::SnapshotWriter() : section_start(0) {
+}
+
+void SnapshotWriter::beginSection(const char tag[4]) {
+    sections.insert(sections.end(), tag, tag + 4);
+    section_start = sections.size();
+    putU32(0);  // Length, filled in by endSection()
+}
+
+void SnapshotWriter::endSection() {
+    storeU32(&sections[section_start], sections.size() - section_start - 4);
+}
+
+void SnapshotWriter::putU8(uint8_t value) {
+    sections.push_back(value);
+}
+
+void SnapshotWriter::putU16(uint16_t value) {
+    putU8(value & 0xFF);
+    putU8(value >> 8);
+}
+
+void SnapshotWriter::putU32(uint32_t value) {
+    putU16(value & 0xFFFF);
+    putU16(value >> 16);
+}
+
+void SnapshotWriter::putU64(uint64_t value) {
+    putU32(value & 0xFFFFFFFF);
+    putU32(value >> 32);
+}
+
+bool SnapshotWriter::writeFile(const std::string& path, const uint8_t* ram) const {
+    uint32_t ram_offset = SNAPSHOT_HEADER_SIZE + sections.size();
+    ram_offset = (ram_offset + SNAPSHOT_RAM_ALIGN - 1) / SNAPSHOT_RAM_ALIGN * SNAPSHOT_RAM_ALIGN;
+
+    // Header, sections and padding up to the RAM image
+    std::vector<uint8_t> head(ram_offset, 0);
+    std::memcpy(&head[0], SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    storeU32(&head[0x08], SNAPSHOT_VERSION);
+    storeU32(&head[0x0C], SNAPSHOT_HEADER_SIZE);
+    storeU32(&head[0x10], sections.size());
+    storeU32(&head[0x14], ram_offset);
+    storeU32(&head[0x18], SNAPSHOT_RAM_SIZE);
+    if (!sections.empty()) {
+        std::memcpy(&head[SNAPSHOT_HEADER_SIZE], sections.data(), sections.size());
+    }
+
+    // Write a temporary file and rename it over the target. After
+    // --load-state, `ram` may be a private mapping of `path` itself, so
+    // truncating the target in place would pull the image out from under
+    // it; the rename also leaves the old snapshot intact on failure.
+    std::string temp_path = path + ".tmp";
+    int fd = ::open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        std::cerr << "Error: Cannot create snapshot '" << path << "'" << std::endl;
+        return false;
+    }
+    bool written = writeAll(fd, head.data(), head.size()) &&
+                   writeAll(fd, ram, SNAPSHOT_RAM_SIZE) &&
+                   ::fsync(fd) == 0;
+    if (::close(fd) != 0) {
+        written = false;
+    }
+    if (written && ::rename(temp_path.c_str(), path.c_str()) != 0) {
+        written = false;
+    }
+    if (!written) {
+        ::unlink(temp_path.c_str());
+        std::cerr << "Error: Failed to write snapshot '" << path << "'" << std::endl;
+    }
+    return written;
+}
+
+// Reader
+
+SnapshotReader::SnapshotReader()
+    : fd(-1), version(0), ram_offset(0), cursor(0), section_end(0), ok(false) {
+}
+
+SnapshotReader::~SnapshotReader() {
+    close();
+}
+
+bool SnapshotReader::open(const std::string& file) {
+    close();
+    path = file;
+    fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Error: Cannot open snapshot '" << path << "'" << std::endl;
+        return false;
+    }
+
+    uint8_t header[SNAPSHOT_HEADER_SIZE];
+    if (!readAll(fd, header, sizeof(header), 0) ||
+        std::memcmp(header, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0) {
+        std::cerr << "Error: '" << path << "' is not an SC8 snapshot" << std::endl;
+        close();
+        return false;
+    }
+
+    version = loadU32(&header[0x08]);
+    if (version == 0 || version > SNAPSHOT_VERSION) {
+        std::cerr << "Error: Snapshot '" << path << "' has unsupported version "
+                  << version << std::endl;
+        close();
+        return false;
+    }
+
+    uint32_t sections_offset = loadU32(&header[0x0C]);
+    uint32_t sections_size = loadU32(&header[0x10]);
+    ram_offset = loadU32(&header[0x14]);
+    if (loadU32(&header[0x18]) != SNAPSHOT_RAM_SIZE) {
+        std::cerr << "Error: Snapshot '" << path << "' has a bad RAM image size" << std::endl;
+        close();
+        return false;
+    }
+
+    // The section table lies between the header and the RAM image, and
+    // the file must hold both; checked before sizing anything from them
+    struct stat info;
+    uint64_t sections_end = static_cast<uint64_t>(sections_offset) + sections_size;
+    if (::fstat(fd, &info) != 0 || sections_offset < SNAPSHOT_HEADER_SIZE ||
+        sections_end > ram_offset ||
+        static_cast<uint64_t>(info.st_size) < static_cast<uint64_t>(ram_offset) + SNAPSHOT_RAM_SIZE) {
+        std::cerr << "Error: Snapshot '" << path << "' is truncated" << std::endl;
+        close();
+        return false;
+    }
+
+    sections.resize(sections_size);
+    if (sections_size > 0 && !readAll(fd, sections.data(), sections_size, sections_offset)) {
+        std::cerr << "Error: Snapshot '" << path << "' is truncated" << std::endl;
+        close();
+        return false;
+    }
+    return true;
+}
+
+void SnapshotReader::openSections(const std::vector<uint8_t>& table) {
+    close();
+    sections = table;
+}
+
+void SnapshotReader::close() {
+    if (fd >= 0) {
+        ::close(fd);
+    }
+    fd = -1;
+    sections.clear();
+    cursor = 0;
+    section_end = 0;
+    ok = false;
+}
+
+uint8_t* SnapshotReader::mapRam() {
+    if (fd < 0 || ram_offset % sysconf(_SC_PAGESIZE) != 0) {
+        return nullptr;
+    }
+
+    // The file must really hold the whole image, or touching the tail
+    // of the mapping would fault
+    off_t size = ::lseek(fd, 0, SEEK_END);
+    if (size < static_cast<off_t>(ram_offset) + SNAPSHOT_RAM_SIZE) {
+        return nullptr;
+    }
+
+    void* image = ::mmap(nullptr, SNAPSHOT_RAM_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                         fd, ram_offset);
+    return image == MAP_FAILED ? nullptr : static_cast<uint8_t*>(image);
+}
+
+void SnapshotReader::unmapRam(uint8_t* image) {
+    if (image) {
+        ::munmap(image, SNAPSHOT_RAM_SIZE);
+    }
+}
+
+bool SnapshotReader::readRam(uint8_t* dest) {
+    if (fd < 0 || !readAll(fd, dest, SNAPSHOT_RAM_SIZE, ram_offset)) {
+        std::cerr << "Error: Cannot read RAM image from snapshot '" << path << "'" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool SnapshotReader::enterSection(const char tag[4]) {
+    size_t position = 0;
+    while (position + 8 <= sections.size()) {
+        uint32_t length = loadU32(&sections[position + 4]);
+        size_t payload = position + 8;
+        if (length > sections.size() - payload) {
+            break;  // Corrupt length
+        }
+        if (std::memcmp(&sections[position], tag, 4) == 0) {
+            cursor = payload;
+            section_end = payload + length;
+            ok = true;
+            return true;
+        }
+        position = payload + length;
+    }
+    cursor = 0;
+    section_end = 0;
+    ok = false;
+    return false;
+}
+
+uint8_t SnapshotReader::getU8() {
+    if (cursor >= section_end) {
+        ok = false;
+        return 0;
+    }
+    return sections[cursor++];
+}
+
+uint16_t SnapshotReader::getU16() {
+    uint16_t low = getU8();
+    return low | (getU8() << 8);
+}
+
+uint32_t SnapshotReader::getU32() {
+    uint32_t low = getU16();
+    return low | (static_cast<uint32_t>(getU16()) << 16);
+}
+
+uint64_t SnapshotReader::getU64() {
+    uint64_t low = getU32();
+    return low | (static_cast<uint64_t>(getU32()) << 32);
+}
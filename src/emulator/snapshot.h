@@ -0,0 +1,112 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Snapshot file format (version 1)
+ *
+ * All integers are little-endian.
+ *
+ *   Offset  Size  Field
+ *   0x00    8     Magic "SC8SNAP\0"
+ *   0x08    4     Format version
+ *   0x0C    4     Offset of the section table
+ *   0x10    4     Size of the section table
+ *   0x14    4     Offset of the RAM image
+ *   0x18    4     Size of the RAM image (65536)
+ *   0x1C    36    Reserved (zero)
+ *
+ * The section table is a sequence of sections, each a 4-character tag,
+ * a 4-byte payload length and the payload. The CPU writes "CPU " and
+ * each device with state writes its own section; readers skip tags
+ * they do not know, so sections can be added without a version bump.
+ * The version changes only when an existing layout changes.
+ *
+ * The RAM image starts on a 4KB boundary so it can be mapped straight
+ * from the file: restoring maps it copy-on-write instead of reading
+ * 64KB, and only the pages the resumed program touches are loaded.
+ */
+static const uint32_t SNAPSHOT_VERSION = 1;
+static const uint32_t SNAPSHOT_HEADER_SIZE = 64;
+static const uint32_t SNAPSHOT_RAM_ALIGN = 4096;
+static const uint32_t SNAPSHOT_RAM_SIZE = 65536;
+
+/**
+ * SnapshotWriter - Builds a snapshot file
+ */
+class SnapshotWriter {
+private:
+    std::vector<uint8_t> sections;
+    size_t section_start;   // Offset of the open section's length field
+
+public:
+    SnapshotWriter();
+
+    // Sections (one open at a time)
+    void beginSection(const char tag[4]);
+    void endSection();
+
+    // Payload of the open section
+    void putU8(uint8_t value);
+    void putU16(uint16_t value);
+    void putU32(uint32_t value);
+    void putU64(uint64_t value);
+
+    // Write the header, the sections and the 64KB RAM image, replacing
+    // `path` only once the new snapshot is complete
+    bool writeFile(const std::string& path, const uint8_t* ram) const;
+
+    // The section table alone (for in-memory checkpoints)
+    const std::vector<uint8_t>& getSections() const { return sections; }
+};
+
+/**
+ * SnapshotReader - Reads a snapshot file written by SnapshotWriter
+ *
+ * The section table is read into memory when the file is opened; the
+ * RAM image is left in the file until mapRam() or readRam() asks for it.
+ * Reads past the end of a section return 0 and clear good().
+ */
+class SnapshotReader {
+private:
+    int fd;
+    std::string path;
+    uint32_t version;
+    uint32_t ram_offset;
+    std::vector<uint8_t> sections;
+    size_t cursor;          // Next payload byte
+    size_t section_end;     // End of the entered section
+    bool ok;
+
+    SnapshotReader(const SnapshotReader&);
+    SnapshotReader& operator=(const SnapshotReader&);
+
+public:
+    SnapshotReader();
+    ~SnapshotReader();
+
+    bool open(const std::string& file);
+    void openSections(const std::vector<uint8_t>& table);   // No RAM image
+    void close();
+    uint32_t getVersion() const { return version; }
+
+    // RAM image: a private, writable, copy-on-write mapping of the file
+    // (release with unmapRam), or nullptr if the file cannot be mapped
+    uint8_t* mapRam();
+    static void unmapRam(uint8_t* image);
+    bool readRam(uint8_t* dest);
+
+    // Position at the payload of a section; false if it is absent
+    bool enterSection(const char tag[4]);
+
+    uint8_t getU8();
+    uint16_t getU16();
+    uint32_t getU32();
+    uint64_t getU64();
+    bool good() const { return ok; }
+};
+
+#endif // SNAPSHOT_H
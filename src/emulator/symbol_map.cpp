@@ -0,0 +1,62 @@
+#include "symbol_map.h"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+bool SymbolMap::load(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "Error: Cannot open symbol map '" << path << "'" << std::endl;
+        return false;
+    }
+
+    symbols.clear();
+    std::string line;
+    int number = 0;
+    while (std::getline(in, line)) {
+        number++;
+        std::istringstream fields(line);
+        unsigned address;
+        std::string name;
+        if (line.empty()) {
+            continue;
+        }
+        if (!(fields >> std::hex >> address >> name) || address > 0xFFFF) {
+            std::cerr << "Error: " << path << ":" << number << ": bad symbol line" << std::endl;
+            return false;
+        }
+        symbols.push_back(std::make_pair(static_cast<uint16_t>(address), name));
+    }
+    std::stable_sort(symbols.begin(), symbols.end(),
+                     [](const std::pair<uint16_t, std::string>& a,
+                        const std::pair<uint16_t, std::string>& b) {
+                         return a.first < b.first;
+                     });
+    return true;
+}
+
+std::string SymbolMap::describe(uint16_t address) const {
+    // Last symbol at or below the address (the first one listed wins
+    // when several labels share it)
+    auto it = std::upper_bound(symbols.begin(), symbols.end(), address,
+                               [](uint16_t value, const std::pair<uint16_t, std::string>& symbol) {
+                                   return value < symbol.first;
+                               });
+    std::ostringstream out;
+    if (it == symbols.begin()) {
+        out << "0x" << std::hex << std::setw(4) << std::setfill('0') << address;
+        return out.str();
+    }
+    --it;
+    uint16_t base = it->first;
+    while (it != symbols.begin() && (it - 1)->first == base) {
+        --it;
+    }
+    out << it->second;
+    if (address != base) {
+        out << "+0x" << std::hex << (address - base);
+    }
+    return out.str();
+}
@@ -0,0 +1,29 @@
+#ifndef SYMBOL_MAP_H
+#define SYMBOL_MAP_H
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * SymbolMap class - Guest labels loaded from an assembler .sym file
+ *
+ * The assembler writes one "<hex address> <name>" line per label next
+ * to each binary. Addresses are named after the closest label at or
+ * below them; without a map (or below the first label) they are shown
+ * in hex.
+ */
+class SymbolMap {
+private:
+    std::vector<std::pair<uint16_t, std::string>> symbols;   // By address
+
+public:
+    bool load(const std::string& path);
+    bool empty() const { return symbols.empty(); }
+
+    // "label" at a label, "label+0x3" past one, "0x0123" otherwise
+    std::string describe(uint16_t address) const;
+};
+
+#endif // SYMBOL_MAP_H
@@ -0,0 +1,308 @@
+#include "time_travel.h"
+#include <algorithm>
+
+TimeTravel::TimeTravel(CPU& processor, Memory& mem, uint64_t checkpoint_interval)
+    : cpu(processor), memory(mem), interval(std::max<uint64_t>(checkpoint_interval, 1)),
+      base(0), next_input(0), frontier(processor.getCycleCount()) {
+    memory.trackCheckpoints(true);
+    memory.setInterceptor(this);
+    takeCheckpoint();
+}
+
+TimeTravel::~TimeTravel() {
+    memory.setInterceptor(nullptr);
+    memory.trackCheckpoints(false);
+}
+
+// Forward
+
+void TimeTravel::step(uint64_t count) {
+    runChunk(getCycle() + count);
+}
+
+bool TimeTravel::continueForward(uint64_t limit) {
+    uint64_t end = getCycle() + limit;
+    if (breakpoints.empty()) {
+        runChunk(end);
+        return false;
+    }
+
+    // Leave the breakpoint we are sitting on before checking for one
+    stepOne();
+    while (!cpu.isHalted() && getCycle() < end) {
+        if (breakpoints.count(cpu.getPC())) {
+            return true;
+        }
+        stepOne();
+    }
+    return false;
+}
+
+// Backward
+
+void TimeTravel::stepBack(uint64_t count) {
+    uint64_t cycle = getCycle();
+    goTo(cycle > count ? cycle - count : 0);
+}
+
+void TimeTravel::goTo(uint64_t cycle) {
+    cycle = std::max(cycle, getFirstCycle());
+    if (cycle < getCycle()) {
+        restoreCheckpoint(checkpointBefore(cycle));
+    }
+    runChunk(cycle);
+}
+
+bool TimeTravel::reverseContinue() {
+    uint64_t end = getCycle();
+    if (end <= getFirstCycle()) {
+        return false;
+    }
+
+    // Scan back one checkpoint interval at a time for the latest hit
+    size_t index = checkpointBefore(end - 1);
+    for (;;) {
+        restoreCheckpoint(index);
+        bool found = false;
+        uint64_t hit = 0;
+        while (!cpu.isHalted() && getCycle() < end) {
+            if (breakpoints.count(cpu.getPC())) {
+                found = true;
+                hit = getCycle();
+            }
+            stepOne();
+        }
+
+        if (found) {
+            restoreCheckpoint(index);
+            runChunk(hit);
+            return true;
+        }
+        if (index == 0) {
+            restoreCheckpoint(0);
+            return false;
+        }
+        end = checkpoints[index].cycle;
+        index--;
+    }
+}
+
+TimeTravel::Change TimeTravel::lastChange(uint16_t address) {
+    Change change;
+    change.found = false;
+    change.cycle = 0;
+    change.pc = 0;
+    change.before = 0;
+    change.after = 0;
+
+    uint64_t origin = getCycle();
+    if (origin <= getFirstCycle()) {
+        return change;
+    }
+
+    uint8_t page = address >> 8;
+    uint64_t end = origin;
+    size_t index = checkpointBefore(end - 1);
+    for (;;) {
+        // Only re-execute intervals in which the page was written
+        bool written[256];
+        if (index + 1 < checkpoints.size()) {
+            std::fill(written, written + 256, false);
+            const std::vector<uint8_t>& pages = checkpoints[index + 1].pages;
+            for (size_t i = 0; i < pages.size(); i++) {
+                written[pages[i]] = true;
+            }
+        } else {
+            changedPages(index, written);
+        }
+
+        if (written[page]) {
+            restoreCheckpoint(index);
+            uint8_t value = memory.getRawMemory()[address];
+            while (!cpu.isHalted() && getCycle() < end) {
+                uint64_t cycle = getCycle();
+                uint16_t pc = cpu.getPC();
+                stepOne();
+                uint8_t now = memory.getRawMemory()[address];
+                if (now != value) {
+                    change.found = true;
+                    change.cycle = cycle;
+                    change.pc = pc;
+                    change.before = value;
+                    change.after = now;
+                }
+                value = now;
+            }
+        }
+
+        if (change.found || index == 0) {
+            break;
+        }
+        end = checkpoints[index].cycle;
+        index--;
+    }
+
+    goTo(origin);
+    return change;
+}
+
+// Checkpoints
+
+void TimeTravel::takeCheckpoint() {
+    size_t index = checkpoints.size();
+    checkpoints.push_back(Checkpoint());
+    Checkpoint& checkpoint = checkpoints.back();
+    checkpoint.cycle = getCycle();
+
+    SnapshotWriter state;
+    cpu.saveState(state);
+    memory.saveState(state);
+    checkpoint.state = state.getSections();
+
+    // The first checkpoint holds all of RAM, later ones what changed
+    bool changed[256];
+    if (index == 0) {
+        std::fill(changed, changed + 256, true);
+    } else {
+        changedPages(index - 1, changed);
+    }
+
+    const uint8_t* ram = memory.getRawMemory();
+    for (int page = 0; page < 256; page++) {
+        if (!changed[page]) {
+            continue;
+        }
+        PageVersion version;
+        version.checkpoint = index;
+        version.offset = page_pool.size();
+        versions[page].push_back(version);
+        page_pool.insert(page_pool.end(), ram + (page << 8), ram + (page << 8) + 256);
+        checkpoint.pages.push_back(page);
+    }
+
+    memory.clearCheckpointPages();
+    base = index;
+}
+
+void TimeTravel::restoreCheckpoint(size_t index) {
+    const Checkpoint& checkpoint = checkpoints[index];
+
+    bool changed[256];
+    changedPages(index, changed);
+    for (int page = 0; page < 256; page++) {
+        if (!changed[page]) {
+            continue;
+        }
+
+        // Latest copy of the page taken at or before the checkpoint
+        const std::vector<PageVersion>& list = versions[page];
+        size_t low = 0;
+        size_t high = list.size();
+        while (high - low > 1) {
+            size_t middle = (low + high) / 2;
+            if (list[middle].checkpoint <= index) {
+                low = middle;
+            } else {
+                high = middle;
+            }
+        }
+        memory.restorePage(page, &page_pool[list[low].offset]);
+    }
+
+    SnapshotReader state;
+    state.openSections(checkpoint.state);
+    cpu.restoreState(state);
+    memory.restoreDevices(state);
+
+    memory.clearCheckpointPages();
+    base = index;
+
+    // Replay input from this cycle on
+    next_input = 0;
+    while (next_input < inputs.size() && inputs[next_input].cycle < checkpoint.cycle) {
+        next_input++;
+    }
+}
+
+size_t TimeTravel::checkpointBefore(uint64_t cycle) const {
+    size_t low = 0;
+    size_t high = checkpoints.size();
+    while (high - low > 1) {
+        size_t middle = (low + high) / 2;
+        if (checkpoints[middle].cycle <= cycle) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+void TimeTravel::changedPages(size_t since, bool changed[256]) const {
+    // RAM matched checkpoint `base` when the dirty channel was cleared;
+    // it differs from checkpoint `since` at most in the pages stored by
+    // the checkpoints between the two
+    std::fill(changed, changed + 256, false);
+    const std::vector<uint8_t>& dirty = memory.getCheckpointPages();
+    for (size_t i = 0; i < dirty.size(); i++) {
+        changed[dirty[i]] = true;
+    }
+    for (size_t index = std::min(since, base) + 1; index < checkpoints.size(); index++) {
+        const std::vector<uint8_t>& pages = checkpoints[index].pages;
+        for (size_t i = 0; i < pages.size(); i++) {
+            changed[pages[i]] = true;
+        }
+    }
+}
+
+// Execution
+
+void TimeTravel::runChunk(uint64_t target) {
+    while (!cpu.isHalted() && getCycle() < target) {
+        // Stop at each checkpoint boundary past the last checkpoint
+        uint64_t next_checkpoint = checkpoints.back().cycle + interval;
+        uint64_t stop = std::min(target, next_checkpoint);
+
+        cpu.setCycleLimit(stop - 1);
+        cpu.runUntilHalt();
+        frontier = std::max(frontier, getCycle());
+
+        if (getCycle() == next_checkpoint && !cpu.isHalted()) {
+            takeCheckpoint();
+        }
+    }
+}
+
+void TimeTravel::stepOne() {
+    runChunk(getCycle() + 1);
+}
+
+// Host I/O
+
+uint8_t TimeTravel::read(Device* device, uint16_t address) {
+    uint64_t now = getCycle();
+    if (now < frontier) {
+        // Re-executing: the guest gets what it got the first time
+        while (next_input < inputs.size() && inputs[next_input].cycle < now) {
+            next_input++;
+        }
+        if (next_input < inputs.size() && inputs[next_input].cycle == now &&
+            inputs[next_input].address == address) {
+            return inputs[next_input++].value;
+        }
+        return device->read(address);
+    }
+
+    InputEvent event;
+    event.cycle = now;
+    event.address = address;
+    event.value = device->read(address);
+    inputs.push_back(event);
+    next_input = inputs.size();
+    return event.value;
+}
+
+bool TimeTravel::write(Device* device, uint16_t address, uint8_t) {
+    // Output below the frontier has already reached the host
+    return !device->isHostOutput(address) || getCycle() >= frontier;
+}
@@ -0,0 +1,116 @@
+#ifndef TIME_TRAVEL_H
+#define TIME_TRAVEL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <set>
+#include <vector>
+#include "cpu.h"
+#include "device.h"
+#include "memory.h"
+
+/**
+ * TimeTravel class - Reverse execution for the debugger
+ *
+ * While the program runs forward, a checkpoint is taken every
+ * `interval` cycles. A checkpoint holds the CPU and device state (as
+ * snapshot sections) and only the RAM pages written since the previous
+ * checkpoint; the first one holds all of RAM. Going back to cycle N
+ * restores the last checkpoint at or before N, rewriting only the pages
+ * that changed since, and runs forward to N - at most `interval` cycles
+ * of re-execution however far back N is.
+ *
+ * Re-execution must see the same input as the original run, so
+ * TimeTravel installs itself as the Bus IoInterceptor. Host input read
+ * for the first time is logged with its cycle; below the furthest cycle
+ * reached (the frontier) reads are served from that log and console
+ * output is dropped, since the host has already seen it.
+ *
+ * Positions are cycle counts: "cycle N" is the state after N
+ * instructions have retired.
+ */
+class TimeTravel : public IoInterceptor {
+public:
+    // Last write that changed a byte (see lastChange)
+    struct Change {
+        bool found;
+        uint64_t cycle;     // Cycle of the instruction that wrote it
+        uint16_t pc;
+        uint8_t before;
+        uint8_t after;
+    };
+
+private:
+    struct Checkpoint {
+        uint64_t cycle;
+        std::vector<uint8_t> state;     // CPU and device sections
+        std::vector<uint8_t> pages;     // Pages stored with this checkpoint
+    };
+
+    struct PageVersion {
+        size_t checkpoint;
+        size_t offset;                  // Into page_pool
+    };
+
+    struct InputEvent {
+        uint64_t cycle;
+        uint16_t address;
+        uint8_t value;
+    };
+
+    CPU& cpu;
+    Memory& memory;
+    uint64_t interval;
+
+    std::vector<Checkpoint> checkpoints;
+    std::vector<PageVersion> versions[256];   // Per page, in checkpoint order
+    std::vector<uint8_t> page_pool;
+    size_t base;            // Checkpoint the dirty-page channel was cleared at
+
+    std::vector<InputEvent> inputs;
+    size_t next_input;      // Replay position in inputs
+    uint64_t frontier;      // First cycle not yet executed live
+
+    std::set<uint16_t> breakpoints;
+
+    void takeCheckpoint();
+    void restoreCheckpoint(size_t index);
+    size_t checkpointBefore(uint64_t cycle) const;
+    void changedPages(size_t since, bool changed[256]) const;
+    void runChunk(uint64_t target);
+    void stepOne();
+
+    TimeTravel(const TimeTravel&);
+    TimeTravel& operator=(const TimeTravel&);
+
+public:
+    // Starts recording from the machine's current state
+    TimeTravel(CPU& processor, Memory& mem, uint64_t checkpoint_interval = 10000);
+    ~TimeTravel();
+
+    // Forward
+    void step(uint64_t count = 1);
+    bool continueForward(uint64_t limit);    // Stops at a breakpoint, HALT or limit
+
+    // Backward
+    void stepBack(uint64_t count = 1);
+    bool reverseContinue();                  // False: ran back to the first checkpoint
+    void goTo(uint64_t cycle);
+    Change lastChange(uint16_t address);     // Last change before the current cycle
+
+    // Breakpoints (PC values)
+    void addBreakpoint(uint16_t address) { breakpoints.insert(address); }
+    void removeBreakpoint(uint16_t address) { breakpoints.erase(address); }
+    const std::set<uint16_t>& getBreakpoints() const { return breakpoints; }
+
+    uint64_t getCycle() const { return cpu.getCycleCount(); }
+    uint64_t getFirstCycle() const { return checkpoints.front().cycle; }
+    size_t getCheckpointCount() const { return checkpoints.size(); }
+    size_t getStoredBytes() const { return page_pool.size(); }
+
+    // IoInterceptor interface
+    uint8_t read(Device* device, uint16_t address);
+    bool write(Device* device, uint16_t address, uint8_t value);
+};
+
+#endif // TIME_TRAVEL_H
@@ -0,0 +1,76 @@
+#include "timer.h"
+
+Timer::Timer(Scheduler& sched, InterruptController& irq)
+    : scheduler(sched), interrupts(irq), timer_ctrl(0), armed(false), start(0) {
+}
+
+uint8_t Timer::read(uint16_t address) {
+    switch (address) {
+        case IO_TIMER_CTRL:
+            return timer_ctrl;
+        case IO_TIMER_VALUE: {
+            if (!armed) {
+                return 0;
+            }
+            uint64_t elapsed = scheduler.now() - start;
+            return elapsed >= timer_ctrl ? 0 : timer_ctrl - elapsed;
+        }
+        default:
+            return 0;
+    }
+}
+
+void Timer::write(uint16_t address, uint8_t value) {
+    if (address != IO_TIMER_CTRL) {
+        return;  // TIMER_VALUE is read-only
+    }
+    
+    timer_ctrl = value;
+    start = scheduler.now();
+    armed = value > 0;
+    if (armed) {
+        scheduler.schedule(this, start + value);
+    } else {
+        scheduler.cancel(this);
+    }
+}
+
+void Timer::reset() {
+    timer_ctrl = 0;
+    armed = false;
+    start = 0;
+    scheduler.cancel(this);
+}
+
+void Timer::save(SnapshotWriter& snapshot) const {
+    snapshot.beginSection("TIMR");
+    snapshot.putU8(timer_ctrl);
+    snapshot.putU8(armed);
+    snapshot.putU64(start);
+    snapshot.endSection();
+}
+
+bool Timer::restore(SnapshotReader& snapshot) {
+    reset();
+    if (!snapshot.enterSection("TIMR")) {
+        return true;
+    }
+    timer_ctrl = snapshot.getU8();
+    armed = snapshot.getU8() != 0;
+    start = snapshot.getU64();
+    if (!snapshot.good()) {
+        reset();
+        return false;
+    }
+    
+    // start is absolute, so the countdown resumes where it was saved
+    if (armed) {
+        scheduler.schedule(this, start + timer_ctrl);
+    }
+    return true;
+}
+
+void Timer::onEvent(uint64_t) {
+    armed = false;
+    interrupts.raise(IRQ_TIMER);
+}
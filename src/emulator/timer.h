@@ -0,0 +1,40 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <cstdint>
+#include "device.h"
+#include "interrupt_controller.h"
+#include "scheduler.h"
+
+/**
+ * Timer class - Countdown timer (TIMER_CTRL 0xFF00, TIMER_VALUE 0xFF03)
+ * 
+ * Writing TIMER_CTRL loads the countdown and schedules its expiry.
+ * TIMER_VALUE decreases by one per cycle and stops at zero; it is
+ * computed from the current cycle when read, so the timer costs
+ * nothing while the CPU runs. Expiry raises IRQ_TIMER.
+ */
+class Timer : public Device, public EventHandler {
+private:
+    Scheduler& scheduler;
+    InterruptController& interrupts;
+    uint8_t timer_ctrl;
+    bool armed;
+    uint64_t start;      // Cycle at which TIMER_CTRL was written
+    
+public:
+    Timer(Scheduler& sched, InterruptController& irq);
+    
+    // Device interface
+    uint8_t read(uint16_t address);
+    void write(uint16_t address, uint8_t value);
+    void reset();
+    bool isLoggedWrite(uint16_t address) const { return address == IO_TIMER_CTRL; }
+    void save(SnapshotWriter& snapshot) const;
+    bool restore(SnapshotReader& snapshot);
+    
+    // EventHandler interface (countdown reached zero)
+    void onEvent(uint64_t deadline);
+};
+
+#endif // TIMER_H
@@ -0,0 +1,102 @@
+#include "timing_model.h"
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include "cpu.h"
+
+TimingModel::TimingModel() : memory_cycles(1), mmio_wait(2), branch_taken(1) {
+    // One cycle per instruction byte fetched; MUL and MULH run a
+    // shift-add loop, DIV and MOD a shift-subtract loop
+    for (int handler = 0; handler < HANDLER_COUNT; handler++) {
+        base[handler] = handler < 0x20 ? DecodeCache::lengthOf(handler) : 1;
+    }
+    base[HANDLER_LOAD_INDIRECT] = DecodeCache::lengthOf(0x0F);
+    base[HANDLER_STORE_INDIRECT] = DecodeCache::lengthOf(0x0F);
+    base[HANDLER_DIV] = DecodeCache::lengthOf(0x04) + 8;
+    base[HANDLER_MOD] = base[HANDLER_DIV];
+    base[0x04] += 6;
+    base[HANDLER_MULH] = base[0x04];
+    update();
+}
+
+int TimingModel::memoryAccesses(uint8_t handler) {
+    switch (handler) {
+        case 0x10: // LOAD
+        case 0x11: // STORE
+        case HANDLER_LOAD_INDIRECT:
+        case HANDLER_STORE_INDIRECT:
+        case 0x15: // PUSH
+        case 0x16: // POP
+            return 1;
+        case 0x17: // CAS (read, then write)
+        case 0x1D: // CALL
+        case 0x1E: // RET
+            return 2;
+        case HANDLER_RETI: // Flags and return address
+            return 3;
+        default:
+            return 0;
+    }
+}
+
+void TimingModel::update() {
+    for (int handler = 0; handler < HANDLER_COUNT; handler++) {
+        fixed[handler] = base[handler] + memoryAccesses(handler) * memory_cycles;
+    }
+}
+
+bool TimingModel::load(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "Error: Cannot open timing table '" << path << "'" << std::endl;
+        return false;
+    }
+
+    std::string line;
+    int number = 0;
+    while (std::getline(in, line)) {
+        number++;
+        std::istringstream fields(line.substr(0, line.find('#')));
+        std::string name;
+        if (!(fields >> name)) {
+            continue;
+        }
+        long cycles;
+        if (!(fields >> cycles) || cycles < 0 || cycles > 0xFFFF) {
+            std::cerr << "Error: " << path << ":" << number << ": bad cycle count for '"
+                      << name << "'" << std::endl;
+            return false;
+        }
+
+        if (name == "memory") {
+            memory_cycles = cycles;
+        } else if (name == "mmio") {
+            mmio_wait = cycles;
+        } else if (name == "taken") {
+            branch_taken = cycles;
+        } else {
+            // Every instruction takes at least a cycle, so the runaway
+            // guard still fires on a loop. "???" names every unassigned
+            // opcode.
+            if (cycles == 0) {
+                std::cerr << "Error: " << path << ":" << number << ": '" << name
+                          << "' must take at least one cycle" << std::endl;
+                return false;
+            }
+            bool known = false;
+            for (int handler = 0; handler < HANDLER_COUNT; handler++) {
+                if (name == CPU::mnemonic(handler)) {
+                    base[handler] = cycles;
+                    known = true;
+                }
+            }
+            if (!known) {
+                std::cerr << "Error: " << path << ":" << number << ": unknown instruction '"
+                          << name << "'" << std::endl;
+                return false;
+            }
+        }
+    }
+    update();
+    return true;
+}
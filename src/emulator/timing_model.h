@@ -0,0 +1,79 @@
+#ifndef TIMING_MODEL_H
+#define TIMING_MODEL_H
+
+#include <cstdint>
+#include <string>
+#include "decode_cache.h"
+
+/**
+ * TimingModel class - Cycle costs per instruction
+ *
+ * Without a model the CPU charges one cycle per instruction. With one
+ * installed (CPU::setTimingModel) each instruction costs its opcode's
+ * base cycles, plus a charge per data memory access, plus wait states
+ * for accesses to the I/O region and a penalty for taken conditional
+ * branches:
+ *
+ *   LOAD/STORE  1 access (+ wait states when the address is >= 0xFF00),
+ *               direct or register-indirect
+ *   PUSH/POP    1 access
+ *   CAS         2 accesses (+ wait states as for LOAD/STORE)
+ *   CALL/RET    2 accesses
+ *   JZ ... JNC  + taken penalty when the branch is taken
+ *
+ * The defaults charge one cycle per instruction byte fetched, one per
+ * data access and two wait states per I/O access. A table file
+ * overrides any of them, one "name cycles" pair per line:
+ *
+ *   # SC8 timing table
+ *   MUL      8
+ *   memory   1       Cycles per data memory access
+ *   mmio     2       Wait states per I/O register access
+ *   taken    1       Extra cycles for a taken JZ/JNZ/JC/JNC
+ *
+ * Names are the mnemonics CPU::mnemonic() prints ("???" is any
+ * unassigned opcode). Text after the number is ignored, as is
+ * everything after a '#'.
+ */
+class TimingModel {
+private:
+    uint32_t base[HANDLER_COUNT];    // Base cycles per handler
+    uint32_t fixed[HANDLER_COUNT];   // Base plus memory accesses
+    uint32_t memory_cycles;
+    uint32_t mmio_wait;
+    uint32_t branch_taken;
+
+    void update();
+
+public:
+    TimingModel();
+
+    // Read overrides from a table file; false (with a message) on error
+    bool load(const std::string& path);
+
+    // Cycles for an instruction that has just executed; `branched` is
+    // true when it left the PC somewhere other than the next instruction
+    // and `address` is its data address (see CPU::dataAddress)
+    uint32_t cost(const DecodedOp& op, bool branched, uint16_t address) const {
+        uint32_t cycles = fixed[op.handler];
+        switch (op.handler) {
+            case 0x10: case 0x11: case 0x17: // LOAD, STORE, CAS
+            case HANDLER_LOAD_INDIRECT: case HANDLER_STORE_INDIRECT:
+                if (address >= 0xFF00) {
+                    cycles += mmio_wait;
+                }
+                break;
+            case 0x19: case 0x1A: case 0x1B: case 0x1C: // Jcc
+                if (branched) {
+                    cycles += branch_taken;
+                }
+                break;
+        }
+        return cycles;
+    }
+
+    // Data memory accesses an instruction makes
+    static int memoryAccesses(uint8_t handler);
+};
+
+#endif // TIMING_MODEL_H
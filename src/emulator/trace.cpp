@@ -0,0 +1,332 @@
+#include "trace.h"
+#include "cpu.h"
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+// TextTrace
+
+void TextTrace::fetch(const CPU& cpu, const DecodedOp& op) {
+    std::cout << "\n[FETCH] PC=0x" << std::hex << std::setw(4)
+              << std::setfill('0') << cpu.getPC() << " IR[0]=0x"
+              << std::setw(2) << static_cast<int>(op.raw) << std::dec << std::endl;
+}
+
+void TextTrace::execute(const CPU& cpu, const DecodedOp& op) {
+    std::cout << "[EXECUTE] Opcode=0x" << std::hex << static_cast<int>(op.opcode)
+              << std::dec << " ";
+
+    if (op.handler == HANDLER_INVALID) {
+        return;  // The core reports the error
+    }
+
+    std::cout << CPU::disassemble(op);
+
+    // Conditional branches also show whether they will be taken
+    uint8_t flags = cpu.getFlags();
+    switch (op.handler) {
+        case 0x19: // JZ
+            std::cout << ((flags & ALU::FLAG_Z) ? " (taken)" : " (not taken)");
+            break;
+        case 0x1A: // JNZ
+            std::cout << (!(flags & ALU::FLAG_Z) ? " (taken)" : " (not taken)");
+            break;
+        case 0x1B: // JC
+            std::cout << ((flags & ALU::FLAG_C) ? " (taken)" : " (not taken)");
+            break;
+        case 0x1C: // JNC
+            std::cout << (!(flags & ALU::FLAG_C) ? " (taken)" : " (not taken)");
+            break;
+    }
+    std::cout << std::endl;
+}
+
+void TextTrace::retire(const CPU& cpu, const DecodedOp&) {
+    cpu.printState();
+}
+
+// StructuredTrace
+
+void StructuredTrace::fetch(const CPU& cpu, const DecodedOp&) {
+    pc = cpu.getPC();
+}
+
+void StructuredTrace::retire(const CPU& cpu, const DecodedOp& op) {
+    out << "{\"cycle\":" << cpu.getCycleCount()
+        << ",\"pc\":" << pc
+        << ",\"op\":\"" << CPU::disassemble(op) << "\""
+        << ",\"regs\":[";
+    for (int i = 0; i < 8; i++) {
+        out << (i ? "," : "") << static_cast<int>(cpu.getRegister(i));
+    }
+    out << "],\"flags\":" << static_cast<int>(cpu.getFlags())
+        << ",\"next\":" << cpu.getPC() << "}\n";
+}
+
+// StatsTrace
+
+void StatsTrace::execute(const CPU& cpu, const DecodedOp& op) {
+    address = cpu.dataAddress(op);
+}
+
+void StatsTrace::retire(const CPU& cpu, const DecodedOp& op) {
+    perf.count(PERF_INSTRUCTIONS);
+
+    switch (op.handler) {
+        case 0x00: case 0x01: case 0x02: case 0x03: // ADD ... DEC
+        case 0x04: case 0x05: case 0x06:
+        case HANDLER_MULH: case HANDLER_DIV: case HANDLER_MOD:
+            perf.count(PERF_CLASS_ARITH);
+            break;
+        case 0x07: case 0x08: case 0x09: case 0x0A: // AND ... SHR
+        case 0x0B: case 0x0C: case 0x0D: case 0x0E:
+            perf.count(PERF_CLASS_LOGIC);
+            break;
+        case 0x13: case 0x14: // CMP, CMPI
+            perf.count(PERF_CLASS_COMPARE);
+            break;
+        case 0x10: // LOAD
+        case HANDLER_LOAD_INDIRECT:
+            perf.count(PERF_CLASS_DATA);
+            perf.count(address >= 0xFF00 ? PERF_MMIO_READS : PERF_LOADS);
+            break;
+        case 0x11: // STORE
+        case HANDLER_STORE_INDIRECT:
+            perf.count(PERF_CLASS_DATA);
+            perf.count(address >= 0xFF00 ? PERF_MMIO_WRITES : PERF_STORES);
+            break;
+        case 0x12: // LOADI
+            perf.count(PERF_CLASS_DATA);
+            break;
+        case 0x17: // CAS
+            perf.count(PERF_CLASS_DATA);
+            perf.count(op.target >= 0xFF00 ? PERF_MMIO_READS : PERF_LOADS);
+            if (cpu.getFlags() & ALU::FLAG_Z) {
+                perf.count(op.target >= 0xFF00 ? PERF_MMIO_WRITES : PERF_STORES);
+            }
+            break;
+        case 0x15: // PUSH
+            perf.count(PERF_CLASS_STACK);
+            perf.count(PERF_PUSHES);
+            perf.noteStackDepth(0xFF - cpu.getRegister(7));
+            break;
+        case 0x16: // POP
+            perf.count(PERF_CLASS_STACK);
+            perf.count(PERF_POPS);
+            break;
+        case 0x18: // JMP
+            perf.count(PERF_CLASS_BRANCH);
+            break;
+        case 0x19: case 0x1A: case 0x1B: case 0x1C: { // JZ, JNZ, JC, JNC
+            // Jumps leave the flags alone, so they show the outcome
+            uint8_t flags = cpu.getFlags();
+            bool taken;
+            switch (op.handler) {
+                case 0x19: taken = (flags & ALU::FLAG_Z) != 0; break;
+                case 0x1A: taken = (flags & ALU::FLAG_Z) == 0; break;
+                case 0x1B: taken = (flags & ALU::FLAG_C) != 0; break;
+                default:   taken = (flags & ALU::FLAG_C) == 0; break;
+            }
+            perf.count(PERF_CLASS_BRANCH);
+            perf.count(static_cast<PerfCounter>(PERF_JZ_TAKEN + 2 * (op.handler - 0x19) + !taken));
+            break;
+        }
+        case 0x1D: // CALL
+            perf.count(PERF_CLASS_CALL);
+            perf.count(PERF_PUSHES, 2);
+            perf.noteStackDepth(0xFF - cpu.getRegister(7));
+            break;
+        case 0x1E: // RET
+            perf.count(PERF_CLASS_CALL);
+            perf.count(PERF_POPS, 2);
+            break;
+        case HANDLER_RETI:
+            perf.count(PERF_CLASS_CALL);
+            perf.count(PERF_POPS, 3);
+            break;
+        default: // HALT, NOP, WAIT, invalid
+            perf.count(PERF_CLASS_SYSTEM);
+            break;
+    }
+}
+
+// BinaryTrace
+
+BinaryTrace::BinaryTrace() : pc(0), cycle(0) {
+    std::memset(before, 0, sizeof(before));
+    std::memset(last, 0, sizeof(last));
+}
+
+bool BinaryTrace::open(const std::string& path, const CPU& cpu) {
+    TraceFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, "SC8TRACE", sizeof(header.magic));
+    header.version = TRACE_VERSION;
+    header.order = 0x0102;
+    header.record_size = sizeof(TraceRecord);
+    header.start_cycle = cpu.getCycleCount();
+    header.start_pc = cpu.getPC();
+    for (int i = 0; i < 8; i++) {
+        header.registers[i] = cpu.getRegister(i);
+    }
+    std::memcpy(last, header.registers, sizeof(last));
+    header.flags = cpu.getFlags();
+    return buffer.open(path, header);
+}
+
+void BinaryTrace::fetch(const CPU& cpu, const DecodedOp&) {
+    pc = cpu.getPC();
+    cycle = cpu.getCycleCount();
+    std::memcpy(before, cpu.getRegisters(), sizeof(before));
+}
+
+void BinaryTrace::retire(const CPU& cpu, const DecodedOp& op) {
+    // Built in place in the ring; every field is written
+    TraceRecord& record = buffer.next();
+    record.pc = pc;
+    record.bytes[0] = op.raw;
+    record.bytes[1] = op.imm;
+    record.bytes[2] = op.target >> 8;
+    record.flags = cpu.getFlags();
+
+    // Register delta: compare the register files as one word and visit
+    // only the bytes that differ (one or none for most instructions).
+    // Byte i of the word is Ri on the little-endian hosts the JIT needs.
+    // The delta is against the previous record, so it also covers
+    // interrupt entry in between.
+    const uint8_t* after = cpu.getRegisters();
+    uint64_t old_word;
+    uint64_t new_word;
+    std::memcpy(&old_word, last, sizeof(old_word));
+    std::memcpy(&new_word, after, sizeof(new_word));
+    uint64_t diff = old_word ^ new_word;
+    uint8_t mask = 0;
+    int slot = 0;
+    std::memset(record.reg_values, 0, sizeof(record.reg_values));
+    while (diff) {
+        int reg = __builtin_ctzll(diff) >> 3;
+        mask |= 1 << reg;
+        if (slot < 4) {
+            record.reg_values[slot++] = after[reg];
+        }
+        diff &= ~(0xFFULL << (reg * 8));
+    }
+    record.reg_mask = mask;
+    std::memcpy(last, after, sizeof(last));
+
+    // Memory effect
+    uint16_t next = cpu.getPC();
+    record.mem_address2 = 0;
+    switch (op.handler) {
+        case 0x10: // LOAD
+            record.mem = TRACE_MEM_READ;
+            record.mem_address = op.target;
+            record.mem_value = cpu.getRegister(op.rd);
+            break;
+        case 0x11: // STORE
+            record.mem = TRACE_MEM_WRITE;
+            record.mem_address = op.target;
+            record.mem_value = before[op.rd];
+            break;
+        case HANDLER_LOAD_INDIRECT:
+            record.mem = TRACE_MEM_READ;
+            record.mem_address = CPU::indirectAddress(op, before);
+            record.mem_value = cpu.getRegister(op.rd);
+            break;
+        case HANDLER_STORE_INDIRECT:
+            record.mem = TRACE_MEM_WRITE;
+            record.mem_address = CPU::indirectAddress(op, before);
+            record.mem_value = before[op.rd];
+            break;
+        case 0x17: // CAS: the write when it succeeded, else the read
+            record.mem_address = op.target;
+            if (cpu.getFlags() & ALU::FLAG_Z) {
+                record.mem = TRACE_MEM_WRITE;
+                record.mem_value = before[op.rd];
+            } else {
+                record.mem = TRACE_MEM_READ;
+                record.mem_value = cpu.getRegister(0);
+            }
+            break;
+        case 0x15: // PUSH
+            record.mem = TRACE_MEM_WRITE;
+            record.mem_address = CPU::pushAddress(before[7]);
+            record.mem_value = before[op.rd];
+            break;
+        case 0x16: // POP
+            record.mem = TRACE_MEM_READ;
+            record.mem_address = CPU::popAddress(before[7]);
+            record.mem_value = cpu.getRegister(op.rd);
+            break;
+        case 0x1D: { // CALL: return address, low byte first
+            uint16_t ret = pc + op.length;
+            record.mem = TRACE_MEM_WRITE | TRACE_MEM_WIDE;
+            record.mem_address = CPU::pushAddress(before[7]);
+            record.mem_address2 = CPU::pushAddress(CPU::afterPush(before[7]));
+            record.mem_value = ret;
+            break;
+        }
+        case 0x1E: // RET: return address, high byte first
+            record.mem = TRACE_MEM_READ | TRACE_MEM_WIDE;
+            record.mem_address = CPU::popAddress(before[7]);
+            record.mem_address2 = CPU::popAddress(CPU::afterPop(before[7]));
+            record.mem_value = (next >> 8) | ((next & 0xFF) << 8);
+            break;
+        case HANDLER_WAIT: {
+            // Cycles skipped while asleep (the count moves on at retire)
+            uint64_t idle = cpu.getCycleCount() - cycle;
+            if (idle > 0) {
+                record.mem = TRACE_IDLE;
+                record.mem_address = idle & 0xFFFF;
+                record.mem_value = (idle >> 16) & 0xFFFF;
+                record.mem_address2 = (idle >> 32) & 0xFFFF;
+                break;
+            }
+            record.mem = TRACE_MEM_NONE;
+            record.mem_address = 0;
+            record.mem_value = 0;
+            break;
+        }
+        default:
+            record.mem = TRACE_MEM_NONE;
+            record.mem_address = 0;
+            record.mem_value = 0;
+            break;
+    }
+
+    buffer.commit();
+}
+
+// ProfileTrace
+
+ProfileTrace::ProfileTrace() : total(0) {
+    for (int i = 0; i < HANDLER_COUNT; i++) {
+        counts[i] = 0;
+    }
+}
+
+void ProfileTrace::report(std::ostream& stream) const {
+    std::vector<int> order;
+    for (int i = 0; i < HANDLER_COUNT; i++) {
+        if (counts[i] > 0) {
+            order.push_back(i);
+        }
+    }
+    std::stable_sort(order.begin(), order.end(), [this](int a, int b) {
+        return counts[a] > counts[b];
+    });
+
+    std::ios::fmtflags saved = stream.flags();
+    stream << "\n=== Opcode Profile ===" << std::endl;
+    stream << "Instructions: " << total << std::endl;
+    for (size_t i = 0; i < order.size(); i++) {
+        uint64_t count = counts[order[i]];
+        stream << "  " << std::left << std::setw(8) << std::setfill(' ')
+               << CPU::mnemonic(order[i]) << std::right << std::setw(10) << count
+               << std::setw(8) << std::fixed << std::setprecision(2)
+               << (100.0 * count / total) << "%" << std::endl;
+    }
+    stream.flags(saved);
+}
@@ -0,0 +1,145 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include "decode_cache.h"
+#include "perf_counters.h"
+#include "trace_buffer.h"
+
+class CPU;
+
+/**
+ * Trace policies
+ *
+ * CPU::step() and CPU::run() are templates over one of the policy types
+ * below. Every policy has the same three hooks, called by the switch
+ * engine at fixed points of the instruction cycle:
+ *
+ *   fetch(cpu, op)    - after the instruction at cpu.getPC() is fetched
+ *   execute(cpu, op)  - before the instruction takes effect
+ *   retire(cpu, op)   - after it has executed, before the cycle count
+ *                       and timer advance
+ *
+ * The NoTrace hooks are empty inline functions, so that instantiation
+ * compiles to the bare interpreter with no instrumentation left in it.
+ * `enabled` tells the core whether it may hand control to the threaded
+ * or JIT engines, which have no hooks.
+ */
+struct NoTrace {
+    static const bool enabled = false;
+
+    void fetch(const CPU&, const DecodedOp&) {}
+    void execute(const CPU&, const DecodedOp&) {}
+    void retire(const CPU&, const DecodedOp&) {}
+};
+
+/**
+ * TextTrace - Human-readable trace printed to stdout (debug mode)
+ */
+struct TextTrace {
+    static const bool enabled = true;
+
+    void fetch(const CPU& cpu, const DecodedOp& op);
+    void execute(const CPU& cpu, const DecodedOp& op);
+    void retire(const CPU& cpu, const DecodedOp& op);
+};
+
+/**
+ * StructuredTrace - One JSON object per retired instruction
+ *
+ * Example line:
+ *   {"cycle":3,"pc":256,"op":"LOADI R0, 72","regs":[72,0,0,0,0,0,0,255],"flags":0,"next":258}
+ */
+class StructuredTrace {
+private:
+    std::ostream& out;
+    uint16_t pc;          // Address of the instruction being executed
+
+public:
+    static const bool enabled = true;
+
+    explicit StructuredTrace(std::ostream& stream) : out(stream), pc(0) {}
+
+    void fetch(const CPU& cpu, const DecodedOp& op);
+    void execute(const CPU&, const DecodedOp&) {}
+    void retire(const CPU& cpu, const DecodedOp& op);
+};
+
+/**
+ * ProfileTrace - Counts retired instructions per opcode
+ */
+class ProfileTrace {
+private:
+    uint64_t counts[HANDLER_COUNT];
+    uint64_t total;
+
+public:
+    static const bool enabled = true;
+
+    ProfileTrace();
+
+    void fetch(const CPU&, const DecodedOp&) {}
+    void execute(const CPU&, const DecodedOp&) {}
+    void retire(const CPU&, const DecodedOp& op) {
+        counts[op.handler]++;
+        total++;
+    }
+
+    // Print the opcode histogram, most frequent first
+    void report(std::ostream& stream) const;
+};
+
+/**
+ * StatsTrace - Feeds the PerfCounters device
+ *
+ * Classifies each retired instruction and counts branch outcomes,
+ * data and MMIO accesses and stack traffic. R7 is taken to be the
+ * stack pointer for the stack depth.
+ */
+class StatsTrace {
+private:
+    PerfCounters& perf;
+    uint16_t address;     // Data address of the instruction executing
+
+public:
+    static const bool enabled = true;
+
+    explicit StatsTrace(PerfCounters& counters) : perf(counters), address(0) {}
+
+    void fetch(const CPU&, const DecodedOp&) {}
+    void execute(const CPU& cpu, const DecodedOp& op);
+    void retire(const CPU& cpu, const DecodedOp& op);
+};
+
+/**
+ * BinaryTrace - Fixed-size binary record per retired instruction
+ *
+ * Records (see trace_buffer.h) go through a TraceBuffer, whose writer
+ * thread does the file I/O, so the hooks only copy a few bytes. Decode
+ * the file with the trace_decode tool.
+ */
+class BinaryTrace {
+private:
+    TraceBuffer buffer;
+    uint16_t pc;          // Instruction address
+    uint64_t cycle;       // Cycle count at fetch
+    uint8_t before[8];    // Registers at fetch
+    uint8_t last[8];      // Registers after the previous record
+
+public:
+    static const bool enabled = true;
+
+    BinaryTrace();
+
+    // Start a trace file at the CPU's current state
+    bool open(const std::string& path, const CPU& cpu);
+    bool close() { return buffer.close(); }
+
+    void fetch(const CPU& cpu, const DecodedOp& op);
+    void execute(const CPU&, const DecodedOp&) {}
+    void retire(const CPU& cpu, const DecodedOp& op);
+};
+
+#endif // TRACE_H
@@ -0,0 +1,91 @@
+#include "trace_buffer.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+TraceBuffer::TraceBuffer()
+    : ring(RING_RECORDS), head(0), tail(0), tail_cache(0), stopping(false),
+      file(nullptr), failed(false) {
+}
+
+TraceBuffer::~TraceBuffer() {
+    close();
+}
+
+bool TraceBuffer::open(const std::string& path, const TraceFileHeader& header) {
+    close();
+
+    file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        std::cerr << "Error: Cannot create trace file '" << path << "'" << std::endl;
+        return false;
+    }
+    failed = std::fwrite(&header, sizeof(header), 1, file) != 1;
+
+    head.store(0);
+    tail.store(0);
+    tail_cache = 0;
+    stopping.store(false);
+    writer = std::thread(&TraceBuffer::writerLoop, this);
+    return true;
+}
+
+bool TraceBuffer::close() {
+    if (!file) {
+        return true;
+    }
+
+    stopping.store(true, std::memory_order_release);
+    writer.join();
+    if (std::fclose(file) != 0) {
+        failed = true;
+    }
+    file = nullptr;
+
+    if (failed) {
+        std::cerr << "Error: Failed to write trace file" << std::endl;
+    }
+    return !failed;
+}
+
+void TraceBuffer::waitForSpace() {
+    // Ring is full: let the writer catch up
+    for (;;) {
+        tail_cache = tail.load(std::memory_order_acquire);
+        if (head.load(std::memory_order_relaxed) - tail_cache < RING_RECORDS) {
+            return;
+        }
+        std::this_thread::yield();
+    }
+}
+
+void TraceBuffer::writerLoop() {
+    for (;;) {
+        // Read the flag first so records published before it are drained
+        bool stop = stopping.load(std::memory_order_acquire);
+        if (drain() == 0) {
+            if (stop) {
+                return;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+    }
+}
+
+size_t TraceBuffer::drain() {
+    size_t t = tail.load(std::memory_order_relaxed);
+    size_t h = head.load(std::memory_order_acquire);
+    size_t count = h - t;
+
+    // Write the pending records in at most two contiguous blocks
+    while (t != h) {
+        size_t offset = t & (RING_RECORDS - 1);
+        size_t chunk = std::min(h - t, RING_RECORDS - offset);
+        if (std::fwrite(&ring[offset], sizeof(TraceRecord), chunk, file) != chunk) {
+            failed = true;
+        }
+        t += chunk;
+        tail.store(t, std::memory_order_release);
+    }
+    return count;
+}
@@ -0,0 +1,130 @@
+#ifndef TRACE_BUFFER_H
+#define TRACE_BUFFER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Binary trace file format (version 3)
+ *
+ * A TraceFileHeader followed by one TraceRecord per retired
+ * instruction. Traces are only written by untimed runs (-T is rejected
+ * with --timing and --cache), where every instruction takes one cycle,
+ * so cycles are not stored: record i describes cycle start_cycle + i,
+ * plus the cycles slept by the TRACE_IDLE records (WAITs) up to and
+ * including it. Both structures are written in host byte order;
+ * `order` in the header reads 0x0102 on a host with the same byte
+ * order.
+ *
+ * Registers are stored as a delta against the previous record:
+ * reg_mask has a bit per register whose value changed and reg_values
+ * holds their new values (at most four change: a post-incrementing
+ * LOAD writes Rd and both pair registers, and entering an interrupt
+ * just before adds R7). The full register file can be rebuilt from
+ * the header by applying the deltas in order. Entering an interrupt
+ * is not an instruction; its change to R7 shows up in the delta of the
+ * handler's first record.
+ */
+static const uint32_t TRACE_VERSION = 3;
+
+struct TraceFileHeader {
+    char magic[8];              // "SC8TRACE"
+    uint32_t version;
+    uint16_t order;             // 0x0102
+    uint16_t record_size;       // sizeof(TraceRecord)
+    uint64_t start_cycle;
+    uint16_t start_pc;
+    uint8_t registers[8];       // Register file before the first record
+    uint8_t flags;
+    uint8_t reserved[29];
+};
+
+// Memory effect kinds (TraceRecord::mem, bits 0-1)
+enum : uint8_t {
+    TRACE_MEM_NONE = 0,
+    TRACE_MEM_READ = 1,
+    TRACE_MEM_WRITE = 2,
+    TRACE_MEM_WIDE = 4,         // Two bytes (CALL/RET stack accesses)
+    TRACE_IDLE = 8              // No access: a WAIT that slept (see traceIdleCycles)
+};
+
+struct TraceRecord {
+    uint16_t pc;
+    uint16_t mem_address;       // Byte accessed (the first, if TRACE_MEM_WIDE)
+    uint16_t mem_value;         // Bytes in access order, first in the low byte
+    uint8_t bytes[3];           // Instruction bytes (length implied by the opcode)
+    uint8_t flags;              // Flags after the instruction
+    uint8_t reg_mask;           // Registers the instruction changed
+    uint8_t reg_values[4];      // New values, lowest register first
+    uint8_t mem;                // TRACE_MEM_* kind
+    uint16_t mem_address2;      // Second byte of a TRACE_MEM_WIDE access
+};
+
+// Cycles a TRACE_IDLE record slept, split low 16 bits first over
+// mem_address, mem_value and mem_address2
+inline uint64_t traceIdleCycles(const TraceRecord& record) {
+    return record.mem_address | (static_cast<uint64_t>(record.mem_value) << 16) |
+           (static_cast<uint64_t>(record.mem_address2) << 32);
+}
+
+/**
+ * TraceBuffer class - Streams TraceRecords to a file
+ *
+ * The emulator thread appends records to a single-producer/single-
+ * consumer ring without locking; a background writer thread drains it
+ * to the file in large blocks. The producer publishes its position
+ * with one release store per record and only waits when the ring is
+ * full; the writer sleeps briefly when the ring is empty, so neither
+ * side pays for a wake-up per record.
+ */
+class TraceBuffer {
+private:
+    static const size_t RING_RECORDS = 1 << 16;   // Power of two (1MB)
+
+    std::vector<TraceRecord> ring;
+    std::atomic<size_t> head;        // Producer position
+    std::atomic<size_t> tail;        // Writer position
+    size_t tail_cache;               // Producer's last view of tail
+    std::atomic<bool> stopping;
+    std::thread writer;
+    FILE* file;
+    bool failed;                     // A write to the file failed (writer only)
+
+    void writerLoop();
+    size_t drain();
+    void waitForSpace();
+
+    TraceBuffer(const TraceBuffer&);
+    TraceBuffer& operator=(const TraceBuffer&);
+
+public:
+    TraceBuffer();
+    ~TraceBuffer();
+
+    // Create the file, write the header and start the writer thread
+    bool open(const std::string& path, const TraceFileHeader& header);
+
+    // Flush everything and stop the writer; false if any write failed
+    bool close();
+
+    // The slot for the next record, filled in place and published by
+    // commit(); no other call may come in between
+    TraceRecord& next() {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h - tail_cache == RING_RECORDS) {
+            waitForSpace();
+        }
+        return ring[h & (RING_RECORDS - 1)];
+    }
+
+    void commit() {
+        head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+};
+
+#endif // TRACE_BUFFER_H
@@ -0,0 +1,238 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include "alu.h"
+#include "cpu.h"
+#include "decode_cache.h"
+#include "trace_buffer.h"
+
+namespace {
+
+struct Filter {
+    uint64_t from;
+    uint64_t to;
+    uint16_t pc_low;
+    uint16_t pc_high;
+    std::string op;           // Mnemonic, upper case; empty: any
+    bool mem_set;
+    uint16_t mem;
+    bool full_registers;
+
+    Filter() : from(0), to(UINT64_MAX), pc_low(0), pc_high(0xFFFF),
+               mem_set(false), mem(0), full_registers(false) {}
+};
+
+void printUsage(const char* program) {
+    std::cout << "SC8 Binary Trace Decoder" << std::endl;
+    std::cout << "Usage: " << program << " [options] <trace_file>" << std::endl;
+    std::cout << "\nOptions:" << std::endl;
+    std::cout << "  --from CYCLE      First cycle to print" << std::endl;
+    std::cout << "  --to CYCLE        Last cycle to print" << std::endl;
+    std::cout << "  --pc ADDR[-ADDR]  Only instructions at ADDR (or in the range)" << std::endl;
+    std::cout << "  --op MNEMONIC     Only instructions with this mnemonic (e.g. CALL)" << std::endl;
+    std::cout << "  --mem ADDR        Only instructions that read or write ADDR" << std::endl;
+    std::cout << "  --regs            Print the whole register file, not just changes" << std::endl;
+    std::cout << "  -h, --help        Show this help message" << std::endl;
+    std::cout << "\nExample:" << std::endl;
+    std::cout << "  " << program << " --op CALL run.trace" << std::endl;
+    std::cout << "  " << program << " --mem 0x1000 --from 5000 run.trace" << std::endl;
+}
+
+bool parseNumber(const std::string& text, uint64_t& value) {
+    if (text.empty()) {
+        return false;
+    }
+    char* end = nullptr;
+    value = std::strtoull(text.c_str(), &end, 0);
+    return *end == '\0';
+}
+
+bool parseAddress(const std::string& text, uint16_t& address) {
+    uint64_t value;
+    if (!parseNumber(text, value) || value > 0xFFFF) {
+        return false;
+    }
+    address = static_cast<uint16_t>(value);
+    return true;
+}
+
+std::string hex(unsigned value, int width) {
+    std::ostringstream out;
+    out << "0x" << std::hex << std::uppercase << std::setw(width) << std::setfill('0') << value;
+    return out.str();
+}
+
+std::string flagString(uint8_t flags) {
+    std::string text = "----";
+    if (flags & ALU::FLAG_N) text[0] = 'N';
+    if (flags & ALU::FLAG_Z) text[1] = 'Z';
+    if (flags & ALU::FLAG_C) text[2] = 'C';
+    if (flags & ALU::FLAG_V) text[3] = 'V';
+    return text;
+}
+
+bool touches(const TraceRecord& record, uint16_t address) {
+    if (record.mem == TRACE_MEM_NONE || record.mem == TRACE_IDLE) {
+        return false;
+    }
+    return record.mem_address == address ||
+           ((record.mem & TRACE_MEM_WIDE) && record.mem_address2 == address);
+}
+
+std::string memoryEffect(const TraceRecord& record) {
+    if (record.mem == TRACE_MEM_NONE) {
+        return "";
+    }
+    if (record.mem == TRACE_IDLE) {
+        std::ostringstream text;
+        text << "(idle " << traceIdleCycles(record) << " cycles)";
+        return text.str();
+    }
+    bool write = (record.mem & TRACE_MEM_WRITE) != 0;
+    const char* arrow = write ? " <- " : " -> ";
+    std::string text = "[" + hex(record.mem_address, 4) + "]" + arrow + hex(record.mem_value & 0xFF, 2);
+    if (record.mem & TRACE_MEM_WIDE) {
+        text += " [" + hex(record.mem_address2, 4) + "]" + arrow + hex(record.mem_value >> 8, 2);
+    }
+    return text;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Filter filter;
+    std::string trace_file;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+
+        if (arg == "-h" || arg == "--help") {
+            printUsage(argv[0]);
+            return 0;
+        } else if (arg == "--regs") {
+            filter.full_registers = true;
+        } else if (arg == "--from" || arg == "--to") {
+            uint64_t value;
+            if (!has_value || !parseNumber(argv[++i], value)) {
+                std::cerr << "Error: " << arg << " needs a cycle number" << std::endl;
+                return 1;
+            }
+            (arg == "--from" ? filter.from : filter.to) = value;
+        } else if (arg == "--pc") {
+            std::string range = has_value ? argv[++i] : "";
+            size_t dash = range.find('-');
+            std::string low = range.substr(0, dash);
+            std::string high = dash == std::string::npos ? low : range.substr(dash + 1);
+            if (!parseAddress(low, filter.pc_low) || !parseAddress(high, filter.pc_high)) {
+                std::cerr << "Error: --pc needs an address or ADDR-ADDR range" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--op") {
+            if (!has_value) {
+                std::cerr << "Error: --op needs a mnemonic" << std::endl;
+                return 1;
+            }
+            filter.op = argv[++i];
+            std::transform(filter.op.begin(), filter.op.end(), filter.op.begin(), ::toupper);
+        } else if (arg == "--mem") {
+            if (!has_value || !parseAddress(argv[++i], filter.mem)) {
+                std::cerr << "Error: --mem needs an address" << std::endl;
+                return 1;
+            }
+            filter.mem_set = true;
+        } else if (arg[0] == '-') {
+            std::cerr << "Error: Unknown option '" << arg << "'" << std::endl;
+            printUsage(argv[0]);
+            return 1;
+        } else {
+            trace_file = arg;
+        }
+    }
+
+    if (trace_file.empty()) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    FILE* file = std::fopen(trace_file.c_str(), "rb");
+    if (!file) {
+        std::cerr << "Error: Cannot open trace file '" << trace_file << "'" << std::endl;
+        return 1;
+    }
+
+    TraceFileHeader header;
+    if (std::fread(&header, sizeof(header), 1, file) != 1 ||
+        std::memcmp(header.magic, "SC8TRACE", sizeof(header.magic)) != 0) {
+        std::cerr << "Error: '" << trace_file << "' is not an SC8 trace" << std::endl;
+        std::fclose(file);
+        return 1;
+    }
+    if (header.order != 0x0102 || header.version != TRACE_VERSION ||
+        header.record_size != sizeof(TraceRecord)) {
+        std::cerr << "Error: Trace '" << trace_file << "' was written by an incompatible "
+                  << "emulator build (version, byte order or record size differs)" << std::endl;
+        std::fclose(file);
+        return 1;
+    }
+
+    uint8_t registers[8];
+    std::memcpy(registers, header.registers, sizeof(registers));
+    uint64_t cycle = header.start_cycle;
+
+    static TraceRecord block[4096];
+    size_t count;
+    while ((count = std::fread(block, sizeof(TraceRecord), 4096, file)) > 0) {
+        for (size_t n = 0; n < count; n++, cycle++) {
+            const TraceRecord& record = block[n];
+            if (record.mem == TRACE_IDLE) {
+                cycle += traceIdleCycles(record);  // Asleep until the WAIT retired
+            }
+
+            // Rebuild the register file before filtering, so every line
+            // sees the true values
+            int slot = 0;
+            for (int i = 0; i < 8; i++) {
+                if ((record.reg_mask & (1 << i)) && slot < 4) {
+                    registers[i] = record.reg_values[slot++];
+                }
+            }
+
+            if (cycle < filter.from || cycle > filter.to ||
+                record.pc < filter.pc_low || record.pc > filter.pc_high ||
+                (filter.mem_set && !touches(record, filter.mem))) {
+                continue;
+            }
+            DecodedOp op = DecodeCache::decode(record.bytes[0], record.bytes[1], record.bytes[2]);
+            if (!filter.op.empty() && filter.op != CPU::mnemonic(op.handler)) {
+                continue;
+            }
+
+            std::cout << std::setw(10) << cycle << "  " << hex(record.pc, 4) << "  "
+                      << std::left << std::setw(20) << CPU::disassemble(op) << std::right
+                      << " " << flagString(record.flags);
+            for (int i = 0; i < 8; i++) {
+                if (filter.full_registers || (record.reg_mask & (1 << i))) {
+                    std::cout << " R" << i << "=" << hex(registers[i], 2);
+                }
+            }
+            std::string effect = memoryEffect(record);
+            if (!effect.empty()) {
+                std::cout << "  " << effect;
+            }
+            std::cout << "\n";
+        }
+        if (cycle > filter.to) {
+            break;
+        }
+    }
+
+    std::fclose(file);
+    return 0;
+}